@@ -0,0 +1,271 @@
+/**
+ * Copyright (C) 2008 by The Regents of the University of California
+ * Redistribution of this file is permitted under the terms of the GNU
+ * Public License (GPL).
+ */
+
+#include "Bruinbase.h"
+#include "AsyncIO.h"
+#include <cerrno>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <sched.h>
+#include <unistd.h>
+#include <linux/io_uring.h>
+
+using std::mutex;
+using std::unique_lock;
+
+// # threads in the fallback pool
+static const int WORKER_COUNT = 8;
+
+//
+// io_uring is driven through raw system calls, so that no library is needed
+//
+static int uringSetup(unsigned entries, struct io_uring_params* p)
+{
+#ifdef __NR_io_uring_setup
+  return (int) syscall(__NR_io_uring_setup, entries, p);
+#else
+  errno = ENOSYS;
+  return -1;
+#endif
+}
+
+static int uringEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags)
+{
+#ifdef __NR_io_uring_enter
+  return (int) syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, NULL, 0);
+#else
+  errno = ENOSYS;
+  return -1;
+#endif
+}
+
+AsyncIO& AsyncIO::engine()
+{
+  static AsyncIO instance;
+  return instance;
+}
+
+AsyncIO::AsyncIO()
+{
+  ringFd = -1;
+  sqRing = cqRing = sqes = cqes = NULL;
+  sqRingSize = cqRingSize = sqesSize = 0;
+  pending = 0;
+  stopping = false;
+
+  // without io_uring, start the thread pool
+  if (!setupRing()) {
+    for (int i = 0; i < WORKER_COUNT; i++) {
+      workers.push_back(std::thread(&AsyncIO::worker, this));
+    }
+  }
+}
+
+AsyncIO::~AsyncIO()
+{
+  if (ringFd >= 0) {
+    ::munmap(sqes, sqesSize);
+    if (cqRing != sqRing) ::munmap(cqRing, cqRingSize);
+    ::munmap(sqRing, sqRingSize);
+    ::close(ringFd);
+  }
+
+  {
+    unique_lock<mutex> guard(lock);
+    stopping = true;
+  }
+  work.notify_all();
+  for (unsigned i = 0; i < workers.size(); i++) workers[i].join();
+}
+
+bool AsyncIO::setupRing()
+{
+  struct io_uring_params p;
+  char* sq;
+  char* cq;
+
+  memset(&p, 0, sizeof(p));
+  if ((ringFd = uringSetup(QUEUE_DEPTH, &p)) < 0) {
+    ringFd = -1;
+    return false;
+  }
+
+  // map the submission and completion rings. newer kernels map both
+  // with one call
+  sqRingSize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+  cqRingSize = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+  if (p.features & IORING_FEAT_SINGLE_MMAP) {
+    if (cqRingSize > sqRingSize) sqRingSize = cqRingSize;
+    cqRingSize = sqRingSize;
+  }
+  sqRing = ::mmap(NULL, sqRingSize, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE,
+                  ringFd, IORING_OFF_SQ_RING);
+  if (sqRing == MAP_FAILED) goto fail_sq;
+  if (p.features & IORING_FEAT_SINGLE_MMAP) {
+    cqRing = sqRing;
+  } else {
+    cqRing = ::mmap(NULL, cqRingSize, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE,
+                    ringFd, IORING_OFF_CQ_RING);
+    if (cqRing == MAP_FAILED) goto fail_cq;
+  }
+  sqesSize = p.sq_entries * sizeof(struct io_uring_sqe);
+  sqes = ::mmap(NULL, sqesSize, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE,
+                ringFd, IORING_OFF_SQES);
+  if (sqes == MAP_FAILED) goto fail_sqes;
+
+  sq = (char*) sqRing;
+  cq = (char*) cqRing;
+  sqHead  = (unsigned*)(sq + p.sq_off.head);
+  sqTail  = (unsigned*)(sq + p.sq_off.tail);
+  sqMask  = (unsigned*)(sq + p.sq_off.ring_mask);
+  sqArray = (unsigned*)(sq + p.sq_off.array);
+  cqHead  = (unsigned*)(cq + p.cq_off.head);
+  cqTail  = (unsigned*)(cq + p.cq_off.tail);
+  cqMask  = (unsigned*)(cq + p.cq_off.ring_mask);
+  cqes    = cq + p.cq_off.cqes;
+  sqEntries = p.sq_entries;
+  return true;
+
+ fail_sqes:
+  if (cqRing != sqRing) ::munmap(cqRing, cqRingSize);
+ fail_cq:
+  ::munmap(sqRing, sqRingSize);
+ fail_sq:
+  ::close(ringFd);
+  ringFd = -1;
+  return false;
+}
+
+RC AsyncIO::readBatch(IORequest* reqs, int count)
+{
+  unique_lock<mutex> guard(batchLock);
+
+  if (count <= 0) return 0;
+  return (ringFd >= 0) ? ringBatch(reqs, count) : poolBatch(reqs, count);
+}
+
+RC AsyncIO::ringBatch(IORequest* reqs, int count)
+{
+  std::vector<struct iovec> iov(count);
+  struct io_uring_sqe* sqeArray = (struct io_uring_sqe*) sqes;
+  int submitted = 0;
+  int completed = 0;
+
+  for (int i = 0; i < count; i++) reqs[i].result = -ECANCELED;
+
+  while (completed < count) {
+    // fill the submission ring as far as the queue depth allows
+    unsigned tail = __atomic_load_n(sqTail, __ATOMIC_RELAXED);
+    while (submitted < count && (int)(submitted - completed) < (int)sqEntries) {
+      unsigned idx = tail & *sqMask;
+      struct io_uring_sqe* sqe = &sqeArray[idx];
+      iov[submitted].iov_base = reqs[submitted].buffer;
+      iov[submitted].iov_len = reqs[submitted].length;
+      memset(sqe, 0, sizeof(*sqe));
+      sqe->opcode = IORING_OP_READV;
+      sqe->fd = reqs[submitted].fd;
+      sqe->addr = (unsigned long) &iov[submitted];
+      sqe->len = 1;
+      sqe->off = reqs[submitted].offset;
+      sqe->user_data = submitted;
+      sqArray[idx] = idx;
+      tail++;
+      submitted++;
+    }
+    __atomic_store_n(sqTail, tail, __ATOMIC_RELEASE);
+
+    // hand the entries the kernel has not taken yet to it, and wait for
+    // at least one completion
+    unsigned toSubmit = tail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+    int n;
+    do {
+      n = uringEnter(ringFd, toSubmit, 1, IORING_ENTER_GETEVENTS);
+    } while (n < 0 && errno == EINTR);
+
+    if (n < 0) {
+      // take back the entries the kernel did not take. the reads it took
+      // still write to iov and to the buffers of the requests, so wait
+      // for every one of them before returning
+      unsigned taken = __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+      submitted -= (int)(tail - taken);
+      __atomic_store_n(sqTail, taken, __ATOMIC_RELEASE);
+      while (completed < submitted) {
+        int got = reap(reqs);
+        completed += got;
+        if (got > 0) continue;
+        if (uringEnter(ringFd, 0, 1, IORING_ENTER_GETEVENTS) < 0) sched_yield();
+      }
+      return RC_FILE_READ_FAILED;
+    }
+
+    completed += reap(reqs);
+  }
+
+  return 0;
+}
+
+int AsyncIO::reap(IORequest* reqs)
+{
+  struct io_uring_cqe* cqeArray = (struct io_uring_cqe*) cqes;
+  int n = 0;
+
+  // every completion available
+  unsigned head = __atomic_load_n(cqHead, __ATOMIC_RELAXED);
+  while (head != __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) {
+    struct io_uring_cqe* cqe = &cqeArray[head & *cqMask];
+    reqs[cqe->user_data].result = cqe->res;
+    head++;
+    n++;
+  }
+  __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+  return n;
+}
+
+RC AsyncIO::poolBatch(IORequest* reqs, int count)
+{
+  unique_lock<mutex> guard(lock);
+
+  // once the workers are stopping, a batch would wait for them forever
+  if (stopping) {
+    for (int i = 0; i < count; i++) reqs[i].result = -ECANCELED;
+    return 0;
+  }
+
+  pending = count;
+  for (int i = 0; i < count; i++) queue.push_back(&reqs[i]);
+  work.notify_all();
+
+  while (pending > 0) done.wait(guard);
+  return 0;
+}
+
+void AsyncIO::worker()
+{
+  unique_lock<mutex> guard(lock);
+
+  for (;;) {
+    while (queue.empty() && !stopping) work.wait(guard);
+    // the reads queued before the stop are still done, so that the batch
+    // waiting for them returns
+    if (queue.empty()) return;
+
+    IORequest* req = queue.front();
+    queue.pop_front();
+
+    // issue the read without holding the lock
+    guard.unlock();
+    ssize_t n;
+    do {
+      n = ::pread(req->fd, req->buffer, req->length, req->offset);
+    } while (n < 0 && errno == EINTR);
+    req->result = (n < 0) ? -errno : n;
+    guard.lock();
+
+    if (--pending == 0) done.notify_all();
+  }
+}
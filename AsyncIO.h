@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2008 by The Regents of the University of California
+ * Redistribution of this file is permitted under the terms of the GNU
+ * Public License (GPL).
+ */
+
+#ifndef ASYNCIO_H
+#define ASYNCIO_H
+
+#include <sys/types.h>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "Bruinbase.h"
+
+/**
+ * One positional read in a batch submitted to AsyncIO.
+ */
+struct IORequest {
+  int     fd;      // the file to read from
+  void*   buffer;  // where the data goes
+  size_t  length;  // # bytes to read
+  off_t   offset;  // file offset to read from
+  ssize_t result;  // OUT: # bytes read, or -errno on failure
+};
+
+/**
+ * The engine that keeps many page reads in flight at once.
+ * It submits through io_uring when the kernel supports it, and falls
+ * back to a small pool of threads issuing pread() otherwise.
+ */
+class AsyncIO {
+ public:
+  // # reads the engine keeps in flight at most
+  static const int QUEUE_DEPTH = 64;
+
+  /**
+   * @return the engine shared by the whole process
+   */
+  static AsyncIO& engine();
+
+  /**
+   * submit every read of the batch and wait until all of them complete.
+   * the result of each read is stored in its result field.
+   * @param reqs[IN/OUT] the reads to perform
+   * @param count[IN] # reads in reqs
+   * @return error code. 0 if every read was submitted. on an error, the
+   *         reads already submitted have completed, and the others have
+   *         a negative result
+   */
+  RC readBatch(IORequest* reqs, int count);
+
+  /**
+   * @return true if reads go through io_uring, false for the thread pool
+   */
+  bool usingUring() const { return ringFd >= 0; }
+
+ private:
+  AsyncIO();
+  ~AsyncIO();
+  AsyncIO(const AsyncIO&);
+  AsyncIO& operator=(const AsyncIO&);
+
+  bool setupRing();
+  RC   ringBatch(IORequest* reqs, int count);
+  int  reap(IORequest* reqs);
+  RC   poolBatch(IORequest* reqs, int count);
+  void worker();
+
+  std::mutex batchLock; // lets one batch at a time use the engine
+  std::mutex lock;      // guards the thread pool queue
+
+  //
+  // io_uring state. ringFd is -1 when the ring is not available
+  //
+  int       ringFd;
+  void*     sqRing;     // the mapped submission ring
+  size_t    sqRingSize;
+  void*     cqRing;     // the mapped completion ring (may equal sqRing)
+  size_t    cqRingSize;
+  void*     sqes;       // the mapped submission queue entries
+  size_t    sqesSize;
+  unsigned* sqHead;
+  unsigned* sqTail;
+  unsigned* sqMask;
+  unsigned* sqArray;
+  unsigned* cqHead;
+  unsigned* cqTail;
+  unsigned* cqMask;
+  void*     cqes;
+  unsigned  sqEntries;
+
+  //
+  // thread pool state, used when io_uring is not available
+  //
+  std::vector<std::thread>  workers;
+  std::deque<IORequest*>    queue;     // reads waiting for a worker
+  std::condition_variable   work;      // signaled when a read is queued
+  std::condition_variable   done;      // signaled when a read completes
+  int                       pending;   // # reads of the batch not completed
+  bool                      stopping;  // true when the workers should exit
+};
+
+#endif // ASYNCIO_H
@@ -9,6 +9,8 @@
  
 #include "BTreeIndex.h"
 #include "BTreeNode.h"
+#include <cstdlib>
+#include <algorithm>
 
 
 
@@ -17,9 +19,11 @@ using namespace std;
 /*
  * BTreeIndex constructor
  */
-BTreeIndex::BTreeIndex()
+template<typename Key>
+BasicBTreeIndex<Key>::BasicBTreeIndex()
 {
     rootPid = -1;
+    packLeaves = false;
     // pid0存储当前root的pid设为1， pid1的前四位初始化为0
 }
 
@@ -27,41 +31,114 @@ BTreeIndex::BTreeIndex()
 
 
 /*
- * Open the index file in read or write mode.
- * Under 'w' mode, the index file should be created if it does not exist.
+ * Tell the role of an index page for the i/o statistics: page 0 holds
+ * the root pid and the tree height, and every other page is a node with
+ * its leaf/non-leaf flag right before the next node pointer.
+ */
+static PageRole classifyPage(PageId pid, const char* page, int size)
+{
+    if (pid == 0)
+        return ROLE_HEADER;
+    return BTLeafNode::isLeaf(page, size) ? ROLE_LEAF : ROLE_INTERIOR;
+}
+
+/*
+ * Page 0 holds the root pid, the tree height and the pid of the last
+ * leaf, then a magic number, the index flags and the key type. Files
+ * written before the flags do not have the magic number, and have int
+ * keys.
+ */
+static const int INDEX_MAGIC = 0x58495242;
+static const int INDEX_PACKED_LEAVES = 1;
+static const int MAGIC_OFFSET = 2*sizeof(PageId)+sizeof(int);
+static const int FLAGS_OFFSET = MAGIC_OFFSET+sizeof(int);
+static const int KEY_TYPE_OFFSET = FLAGS_OFFSET+sizeof(int);
+
+// true if new indexes pack their leaves unless the caller says otherwise
+static bool packByDefault()
+{
+    const char* env = getenv("BRUINBASE_PACK_INDEX");
+    return env != NULL && atoi(env) != 0;
+}
+
+/*
+ * Open the index file in read, write, memory-mapped or direct mode.
+ * Under 'w', 'm' or 'd' mode, the index file should be created if it does not exist.
  * @param indexname[IN] the name of the index file
- * @param mode[IN] 'r' for read, 'w' for write
- * @return error code. 0 if no error
+ * @param mode[IN] 'r' for read, 'w' for write, 'm' for memory-mapped,
+ *                 'd' for direct
+ * @param pageSize[IN] the page size of a new index file. 0 for the default
+ * @param packLeaves[IN] true to pack the leaves of a new index file
+ * @return error code. 0 if no error. RC_INVALID_FILE_FORMAT if the
+ *         index file has another key type
  */
-RC BTreeIndex::open(const string& indexname, char mode)
+template<typename Key>
+RC BasicBTreeIndex<Key>::open(const string& indexname, char mode, int pageSize, bool packLeaves)
 {
     RC rc;
-    if((rc=pf.open(indexname, 'r'))<0 && (mode == 'w'))
+    pf.setClassifier(classifyPage);
+    if((rc=pf.open(indexname, 'r'))<0 && (mode == 'w' || mode == 'm' || mode == 'd'))
     {
         close();
-        pf.open(indexname, 'w');
-        char rootbuffer[PageFile::PAGE_SIZE];
+        if((rc=pf.open(indexname, mode, pageSize))<0) return rc;
+        // splits change several pages at once. they are held in the cache,
+        // and the log keeps the tree whole across a crash
+        if (mode != 'm' && ((rc=pf.setWriteBack(true))<0 || (rc=pf.setLogging(true))<0))
+        {
+            close();
+            return rc;
+        }
+        char rootbuffer[PageFile::MAX_PAGE_SIZE];
         rootPid = 1;
         treeHeight = 1;
+        this->packLeaves = packLeaves || packByDefault();
+        int magic = INDEX_MAGIC;
+        int flags = this->packLeaves ? INDEX_PACKED_LEAVES : 0;
+        int keyType = KeyTraits<Key>::TYPE;
         // pid0存储当前root的pid设为1， treeheight设为1，pid1的前四位初始化为0
+        memset(rootbuffer, 0, sizeof(rootbuffer));
         memcpy(rootbuffer, &rootPid, sizeof(PageId));
         memcpy(rootbuffer+sizeof(PageId), &treeHeight, sizeof(int));
-        pf.write(0, rootbuffer);
-        char firstnode[PageFile::PAGE_SIZE];
-        int keycount = 0;
-        memcpy(firstnode, &keycount, sizeof(int));
-        pf.write(1, firstnode);
+        memcpy(rootbuffer+MAGIC_OFFSET, &magic, sizeof(int));
+        memcpy(rootbuffer+FLAGS_OFFSET, &flags, sizeof(int));
+        memcpy(rootbuffer+KEY_TYPE_OFFSET, &keyType, sizeof(int));
+        BasicBTLeafNode<Key> firstnode(pf.getPageSize());
+        if((rc=pf.write(0, rootbuffer))<0 || (rc=firstnode.write(1, pf))<0 || (rc=pf.commit())<0)
+        {
+            close();
+            return rc;
+        }
     }
     else
     {
         close();
         if((rc=pf.open(indexname,mode))<0) return rc;
         pf.open(indexname, mode);
-        char rootpidbuffer[PageFile::PAGE_SIZE];
+        if ((mode == 'w' || mode == 'd') && ((rc=pf.setWriteBack(true))<0 || (rc=pf.setLogging(true))<0))
+        {
+            close();
+            return rc;
+        }
+        char rootpidbuffer[PageFile::MAX_PAGE_SIZE];
         pf.read(0, rootpidbuffer);
         memcpy(&rootPid, rootpidbuffer, sizeof(PageId));
         memcpy(&treeHeight, rootpidbuffer+sizeof(PageId), sizeof(int));
+        int magic, flags, keyType = 0;
+        memcpy(&magic, rootpidbuffer+MAGIC_OFFSET, sizeof(int));
+        memcpy(&flags, rootpidbuffer+FLAGS_OFFSET, sizeof(int));
+        if (magic == INDEX_MAGIC)
+            memcpy(&keyType, rootpidbuffer+KEY_TYPE_OFFSET, sizeof(int));
+        else
+            flags = 0;
+        if (keyType != KeyTraits<Key>::TYPE)
+        {
+            close();
+            return RC_INVALID_FILE_FORMAT;
+        }
+        this->packLeaves = (flags & INDEX_PACKED_LEAVES);
     }
+    // lookups probe the index pages in no particular order
+    pf.advise(PageFile::ACCESS_RANDOM);
     return 0;
 }
 
@@ -69,10 +146,23 @@ RC BTreeIndex::open(const string& indexname, char mode)
  * Close the index file.
  * @return error code. 0 if no error
  */
-RC BTreeIndex::close()
+template<typename Key>
+RC BasicBTreeIndex<Key>::close()
 {
+    // the inserts since the last commit are committed first
+    RC rc = pf.commit();
     pf.close();
-    return 0;
+    return rc;
+}
+
+/*
+ * Commit the inserts since the last commit as one transaction.
+ * @return error code. 0 if no error
+ */
+template<typename Key>
+RC BasicBTreeIndex<Key>::commit()
+{
+    return pf.commit();
 }
 
 /*
@@ -81,19 +171,20 @@ RC BTreeIndex::close()
  * @param rid[IN] the RecordId for the record being inserted into the index
  * @return error code. 0 if no error
  */
-RC BTreeIndex::insert(int key, const RecordId& rid)
+template<typename Key>
+RC BasicBTreeIndex<Key>::insert(const Key& key, const RecordId& rid)
 {
-    char buffer[PageFile::PAGE_SIZE];
+    char buffer[PageFile::MAX_PAGE_SIZE];
     pf.read(0, buffer);
     PageId LfEpid = 1;
     if(rootPid == 1)
     {
-        BTLeafNode leaf;
+        BasicBTLeafNode<Key> leaf(pf.getPageSize());
         leaf.read(rootPid, pf);
-        int num = leaf.getKeyCount();
-        if(num < leaf.leaftotal)
+        leaf.setPacking(packLeaves);
+        // the node tells when it is full: a packed leaf fills up by size
+        if(leaf.insert(key, rid) == 0)
         {
-            leaf.insert(key, rid);
             leaf.write(rootPid, pf);
             
             memcpy(buffer+sizeof(PageId)+sizeof(int),&LfEpid, sizeof(PageId));
@@ -101,26 +192,34 @@ RC BTreeIndex::insert(int key, const RecordId& rid)
         }
         else
         {
-            BTLeafNode sibling;
-            int siblingkey;
+            BasicBTLeafNode<Key> sibling(pf.getPageSize());
+            Key siblingkey;
+            std::vector<PageIO> batch;
+            sibling.setPacking(packLeaves);
             leaf.insertAndSplit(key, rid, sibling, siblingkey);
-            PageId next_pid = rootPid+1;
+            // the sibling leaf goes right after the leaf if it can
+            PageId next_pid;
+            pf.allocate(next_pid, rootPid);
             leaf.setNextNodePtr(next_pid);
-            leaf.write(rootPid, pf);
-            sibling.write(next_pid, pf);
+            leaf.write(rootPid, pf, batch);
+            sibling.write(next_pid, pf, batch);
             
             LfEpid = 2;
             memcpy(buffer+sizeof(PageId)+sizeof(int),&LfEpid, sizeof(PageId));
             
-            BTNonLeafNode newroot;
+            BasicBTNonLeafNode<Key> newroot(pf.getPageSize());
             newroot.initializeRoot(rootPid, siblingkey, next_pid);
-            rootPid = pf.endPid();
-            newroot.write(rootPid, pf);
+            pf.allocate(rootPid);
+            newroot.write(rootPid, pf, batch);
             
             memcpy(buffer, &rootPid, sizeof(PageId));
             treeHeight = 2;
             memcpy(buffer+sizeof(PageId), &treeHeight, sizeof(int));
-            pf.write(0, buffer);
+            PageIO header = { 0, buffer };
+            batch.push_back(header);
+            
+            // the split pages go out together
+            pf.writev(&batch[0], batch.size());
         }
     }
     else
@@ -129,22 +228,24 @@ RC BTreeIndex::insert(int key, const RecordId& rid)
         IndexCursor cursor;
         cursor = recursor(rootPid, key, traverse, 0);
 
-        BTLeafNode leaf;
+        BasicBTLeafNode<Key> leaf(pf.getPageSize());
         leaf.read(cursor.pid, pf);
-        int keycount = leaf.getKeyCount();
-        if(keycount < leaf.leaftotal)
+        leaf.setPacking(packLeaves);
+        if(leaf.insert(key, rid) == 0)
         {
-            leaf.insert(key, rid);
             leaf.write(cursor.pid, pf);
         }
         else
         {
-            BTLeafNode sibling;
-            int siblingkey;
+            BasicBTLeafNode<Key> sibling(pf.getPageSize());
+            sibling.setPacking(packLeaves);
+            Key siblingkey;
             PageId next_pid;
+            std::vector<PageIO> batch;
             next_pid = leaf.getNextNodePtr();
             leaf.insertAndSplit(key, rid, sibling, siblingkey);
-            PageId siblingpid = pf.endPid();
+            PageId siblingpid;
+            pf.allocate(siblingpid, cursor.pid);
             leaf.setNextNodePtr(siblingpid);
             sibling.setNextNodePtr(next_pid);
             
@@ -152,11 +253,13 @@ RC BTreeIndex::insert(int key, const RecordId& rid)
             {
                 LfEpid = siblingpid;
                 memcpy(buffer+sizeof(PageId)+sizeof(int),&LfEpid, sizeof(PageId));
-                pf.write(0, buffer);
+                PageIO header = { 0, buffer };
+                batch.push_back(header);
             }
             
-            leaf.write(cursor.pid, pf);
-            sibling.write(siblingpid, pf);
+            leaf.write(cursor.pid, pf, batch);
+            sibling.write(siblingpid, pf, batch);
+            pf.writev(&batch[0], batch.size());
             
             int level = treeHeight-1;
             Treerecursor(traverse, level,siblingkey, siblingpid);
@@ -165,11 +268,249 @@ RC BTreeIndex::insert(int key, const RecordId& rid)
     return 0;
 }
 
-RC BTreeIndex::Treerecursor(PageId traverse[],int level, int siblingkey, PageId siblingpid)
+/*
+ * The pairs of a vector, as a stream for bulkLoad().
+ */
+template<typename Key>
+struct VectorEntryStream : public IndexEntryStream<Key> {
+    const vector<Key>& keys;
+    const vector<RecordId>& rids;
+    unsigned i;
+
+    VectorEntryStream(const vector<Key>& keys, const vector<RecordId>& rids)
+        : keys(keys), rids(rids), i(0) {}
+
+    RC next(Key& key, RecordId& rid)
+    {
+        if(i == keys.size())
+            return RC_END_OF_TREE;
+        key = keys[i];
+        rid = rids[i++];
+        return 0;
+    }
+};
+
+/*
+ * The pairs bulkLoad() has read from its stream and not put in a leaf yet.
+ */
+template<typename Key>
+struct LoadBuffer {
+    IndexEntryStream<Key>& stream;
+    vector<Key> keys;
+    vector<RecordId> rids;
+    // the stream has no more pairs
+    bool ended;
+    // the last key read, to check the order of the stream
+    Key last;
+    bool started;
+
+    LoadBuffer(IndexEntryStream<Key>& stream)
+        : stream(stream), ended(false), started(false) {}
+
+    // read pairs until count of them are buffered or the stream ends
+    RC fill(unsigned count)
+    {
+        RC rc;
+        Key key;
+        RecordId rid;
+        while(!ended && keys.size() < count)
+        {
+            if((rc = stream.next(key, rid)) == RC_END_OF_TREE)
+            {
+                ended = true;
+                break;
+            }
+            if(rc < 0)
+                return rc;
+            if(started && KeyTraits<Key>::compare(last, key) > 0)
+                return RC_INVALID_ATTRIBUTE;
+            last = key;
+            started = true;
+            keys.push_back(key);
+            rids.push_back(rid);
+        }
+        return 0;
+    }
+
+    // drop the first count pairs, once they are in a leaf
+    void drop(unsigned count)
+    {
+        keys.erase(keys.begin(), keys.begin() + count);
+        rids.erase(rids.begin(), rids.begin() + count);
+    }
+};
+
+/*
+ * Build the index from (key, RecordId) pairs sorted by key, bottom up.
+ * @param keys[IN] the keys, in ascending order
+ * @param rids[IN] the RecordIds of the keys
+ * @param fillPercent[IN] how full to make a node, in % of its capacity
+ * @return error code. 0 if no error
+ */
+template<typename Key>
+RC BasicBTreeIndex<Key>::bulkLoad(const vector<Key>& keys, const vector<RecordId>& rids, int fillPercent)
+{
+    if(keys.size() != rids.size())
+        return RC_INVALID_ATTRIBUTE;
+    for(unsigned i = 1; i < keys.size(); i++)
+    {
+        if(KeyTraits<Key>::compare(keys[i-1], keys[i]) > 0)
+            return RC_INVALID_ATTRIBUTE;
+    }
+    VectorEntryStream<Key> stream(keys, rids);
+    return bulkLoad(stream, fillPercent);
+}
+
+/*
+ * Build the index from a stream of (key, RecordId) pairs sorted by key,
+ * bottom up.
+ * @param stream[IN] the pairs, in ascending order of keys
+ * @param fillPercent[IN] how full to make a node, in % of its capacity
+ * @return error code. 0 if no error
+ */
+template<typename Key>
+RC BasicBTreeIndex<Key>::bulkLoad(IndexEntryStream<Key>& stream, int fillPercent)
+{
+    RC rc;
+    LoadBuffer<Key> pending(stream);
+    if((rc = pending.fill(1)) < 0)
+        return rc;
+    if(pending.keys.empty())
+        return 0;
+    // a tree with entries takes them one at a time
+    if(treeHeight != 1 || GetKeycount(rootPid) != 0)
+    {
+        while(!pending.keys.empty())
+        {
+            if((rc = insert(pending.keys[0], pending.rids[0])) < 0)
+                return rc;
+            pending.drop(1);
+            if((rc = pending.fill(1)) < 0)
+                return rc;
+        }
+        // the pairs are one transaction
+        return pf.commit();
+    }
+    fillPercent = max(1, min(fillPercent, 100));
+
+    // the pages are new: nothing to recover them to if the load fails
+    bool logging = pf.isLogging();
+    if((rc = pf.setLogging(false)) < 0)
+        return rc;
+
+    // the first key and the pid of each node of the level being built
+    vector<Key> firstkeys;
+    vector<PageId> pids;
+    // the root, the height and the last leaf of the new tree, for the
+    // header once the tree is written
+    PageId root;
+    int height = 1;
+    PageId LfEpid;
+    char buffer[PageFile::MAX_PAGE_SIZE];
+
+    // the leaves, left to right. the first one is the empty root leaf
+    PageId pid = rootPid;
+    while(!pending.keys.empty())
+    {
+        BasicBTLeafNode<Key> leaf(pf.getPageSize());
+        leaf.setPacking(packLeaves);
+        unsigned end = max(1, leaf.leaftotal * fillPercent / 100);
+        // one pair past the leaf tells whether a run of equal keys goes on
+        if((rc = pending.fill(end + 1)) < 0)
+            goto exit_load;
+        const vector<Key>& keys = pending.keys;
+        end = min(end, (unsigned) keys.size());
+        // a run of equal keys that fits in the next leaf is not split, so
+        // that the first keys of the leaves differ
+        unsigned run = end;
+        while(run > 0 && run < keys.size() && KeyTraits<Key>::compare(keys[run-1], keys[run]) == 0)
+            run--;
+        if(run > 0)
+            end = run;
+        firstkeys.push_back(keys[0]);
+        pids.push_back(pid);
+        // a packed leaf may fill up by size before end
+        unsigned i = 0;
+        while(i < end && leaf.insert(keys[i], pending.rids[i]) == 0)
+            i++;
+        pending.drop(i);
+        if((rc = pending.fill(1)) < 0)
+            goto exit_load;
+        PageId next_pid = 0;
+        if(!pending.keys.empty() && (rc = pf.allocate(next_pid, pid)) < 0)
+            goto exit_load;
+        leaf.setNextNodePtr(next_pid);
+        if((rc = leaf.write(pid, pf)) < 0)
+            goto exit_load;
+        pid = next_pid;
+    }
+    LfEpid = pids.back();
+
+    // the non-leaf levels, until one node covers the level below
+    while(pids.size() > 1)
+    {
+        BasicBTNonLeafNode<Key> probe(pf.getPageSize());
+        unsigned fanout = max(3, probe.nonleaftotal * fillPercent / 100 + 1);
+        // the children are shared evenly, so that no node gets only one
+        unsigned nodes = (pids.size() + fanout - 1) / fanout;
+        vector<Key> upperkeys;
+        vector<PageId> upperpids;
+        unsigned child = 0;
+        for(unsigned n = 0; n < nodes; n++)
+        {
+            unsigned end = child + (pids.size() - child) / (nodes - n);
+            BasicBTNonLeafNode<Key> node(pf.getPageSize());
+            node.initializeRoot(pids[child], firstkeys[child+1], pids[child+1]);
+            for(unsigned c = child + 2; c < end; c++)
+                node.insert(firstkeys[c], pids[c]);
+            if((rc = pf.allocate(pid, upperpids.empty() ? LfEpid : upperpids.back())) < 0)
+                goto exit_load;
+            if((rc = node.write(pid, pf)) < 0)
+                goto exit_load;
+            upperkeys.push_back(firstkeys[child]);
+            upperpids.push_back(pid);
+            child = end;
+        }
+        firstkeys.swap(upperkeys);
+        pids.swap(upperpids);
+        height++;
+    }
+    root = pids[0];
+
+    // the header last, once the tree it points to is written
+    if((rc = pf.read(0, buffer)) < 0)
+        goto exit_load;
+    memcpy(buffer, &root, sizeof(PageId));
+    memcpy(buffer+sizeof(PageId), &height, sizeof(int));
+    memcpy(buffer+sizeof(PageId)+sizeof(int), &LfEpid, sizeof(PageId));
+    if((rc = pf.write(0, buffer)) < 0 || (rc = pf.flush()) < 0)
+        goto exit_load;
+    rootPid = root;
+    treeHeight = height;
+
+    exit_load:
+    if(rc < 0 && !pids.empty())
+    {
+        // the header still points to the root leaf: empty it again, so
+        // that a failed load leaves an empty index
+        BasicBTLeafNode<Key> empty(pf.getPageSize());
+        if(empty.write(rootPid, pf) == 0)
+            pf.flush();
+    }
+    RC logrc = logging ? pf.setLogging(true) : 0;
+    if(rc < 0)
+        return rc;
+    if(logrc < 0)
+        return logrc;
+    return pf.commit();
+}
+
+template<typename Key>
+RC BasicBTreeIndex<Key>::Treerecursor(PageId traverse[],int level, const Key& siblingkey, PageId siblingpid)
 {
     if(level == 1)
     {
-        BTNonLeafNode nonleaf;
+        BasicBTNonLeafNode<Key> nonleaf(pf.getPageSize());
         nonleaf.read(traverse[0], pf);
         int countkey = nonleaf.getKeyCount();
         if(countkey < nonleaf.nonleaftotal)
@@ -179,26 +520,32 @@ RC BTreeIndex::Treerecursor(PageId traverse[],int level, int siblingkey, PageId
         }
         else
         {
-            int midkey;
-            BTNonLeafNode middle;
+            Key midkey;
+            BasicBTNonLeafNode<Key> middle(pf.getPageSize());
+            std::vector<PageIO> batch;
             nonleaf.insertAndSplit(siblingkey, siblingpid, middle, midkey);
-            nonleaf.write(traverse[0], pf);
-            PageId next_pid = pf.endPid();
-            middle.write(next_pid, pf);
-            BTNonLeafNode newroot;
+            nonleaf.write(traverse[0], pf, batch);
+            PageId next_pid;
+            pf.allocate(next_pid, traverse[0]);
+            middle.write(next_pid, pf, batch);
+            BasicBTNonLeafNode<Key> newroot(pf.getPageSize());
             newroot.initializeRoot(traverse[0], midkey, next_pid);
-            rootPid = next_pid+1;
-            newroot.write(rootPid, pf);
-            char buffer[PageFile::PAGE_SIZE];
+            pf.allocate(rootPid);
+            newroot.write(rootPid, pf, batch);
+            // keep the rest of the header: the last leaf and the flags
+            char buffer[PageFile::MAX_PAGE_SIZE];
+            pf.read(0, buffer);
             memcpy(buffer,&rootPid, sizeof(PageId));
             treeHeight++;
             memcpy(buffer+sizeof(PageId), &treeHeight, sizeof(int));
-            pf.write(0, buffer);
+            PageIO header = { 0, buffer };
+            batch.push_back(header);
+            pf.writev(&batch[0], batch.size());
         }
     }
     else
     {
-        BTNonLeafNode nonleaf;
+        BasicBTNonLeafNode<Key> nonleaf(pf.getPageSize());
         nonleaf.read(traverse[level-1],pf);
         int countkey = nonleaf.getKeyCount();
         if(countkey<nonleaf.nonleaftotal)
@@ -208,12 +555,15 @@ RC BTreeIndex::Treerecursor(PageId traverse[],int level, int siblingkey, PageId
         }
         else
         {
-            BTNonLeafNode middle;
-            int midkey;
+            BasicBTNonLeafNode<Key> middle(pf.getPageSize());
+            Key midkey;
+            std::vector<PageIO> batch;
             nonleaf.insertAndSplit(siblingkey, siblingpid, middle, midkey);
-            nonleaf.write(traverse[level-1], pf);
-            PageId midpid = pf.endPid();
-            middle.write(midpid,pf);
+            nonleaf.write(traverse[level-1], pf, batch);
+            PageId midpid;
+            pf.allocate(midpid, traverse[level-1]);
+            middle.write(midpid, pf, batch);
+            pf.writev(&batch[0], batch.size());
             level--;
             return Treerecursor(traverse, level, midkey, midpid);
         }
@@ -238,50 +588,69 @@ RC BTreeIndex::Treerecursor(PageId traverse[],int level, int siblingkey, PageId
  *                    smaller than searchKey.
  * @return 0 if searchKey is found. Othewise an error code
  */
-RC BTreeIndex::locate(int searchKey, IndexCursor& cursor)
+template<typename Key>
+RC BasicBTreeIndex<Key>::locate(const Key& searchKey, IndexCursor& cursor)
 {
     //得到树的高度
-    char buffer[PageFile::PAGE_SIZE];
-    pf.read(0, buffer);
-    memcpy(&treeHeight, buffer+sizeof(PageId), sizeof(int));
+    const char* header;
+    if (pf.pin(0, header) == 0)
+    {
+        memcpy(&treeHeight, header+sizeof(PageId), sizeof(int));
+        pf.unpin(0);
+    }
     //建立一个pageid的数组
     PageId traverse[treeHeight];
     int num = 0;
-    cursor = recursor(rootPid, searchKey,traverse,num);
-    int key;
+    // the keys equal to searchKey may start in a leaf left of the one an
+    // insert goes to
+    cursor = recursor(rootPid, searchKey,traverse,num,true);
+    // a cursor past the last entry of a leaf points to the first entry
+    // of the next one. past the last leaf, it points to page 0
+    if(cursor.eid > GetKeycount(cursor.pid))
+    {
+        cursor.eid = 1;
+        cursor.pid = GetNextpid(cursor.pid);
+        if(cursor.pid == 0)
+            return RC_NO_SUCH_RECORD;
+    }
+    Key key;
     RecordId rid;
     IndexCursor tempcursor = cursor;
-    readForward(tempcursor, key, rid);
-    if(key != searchKey)
+    if(readForward(tempcursor, key, rid) < 0 || KeyTraits<Key>::compare(key, searchKey) != 0)
         return RC_NO_SUCH_RECORD;
     return 0;
 }
 
-IndexCursor BTreeIndex::recursor(PageId pid,int searchkey,PageId traverse[],int num)
+template<typename Key>
+IndexCursor BasicBTreeIndex<Key>::recursor(PageId pid,const Key& searchkey,PageId traverse[],int num,bool first)
 {
-    char buffer[PageFile::PAGE_SIZE];
+    // work on the cached page directly instead of copying it
+    const char* buffer;
     IndexCursor cursor;
-    pf.read(pid, buffer);
-    int flag;
-    memcpy(&flag, buffer+1016, 4);
-    if(flag == 0)
+    if (pf.pin(pid, buffer) < 0)
+    {
+        cursor.pid = pid;
+        cursor.eid = 1;
+        return cursor;
+    }
+    if(BasicBTLeafNode<Key>::isLeaf(buffer, pf.getPageSize()))
     {
-        BTLeafNode leaf;
-        leaf.read(pid, pf);
+        BasicBTLeafNode<Key> leaf(buffer, pf.getPageSize());
         int eid;
         leaf.locate(searchkey, eid);
+        pf.unpin(pid);
         cursor.eid = eid;
         cursor.pid = pid;
         return cursor;
     }
     else
     {
-        BTNonLeafNode nonleaf;
-        nonleaf.read(pid,pf);
+        BasicBTNonLeafNode<Key> nonleaf(buffer, pf.getPageSize());
         traverse[num] = pid;// 记录当前traverse的nonleaf的pid
         PageId childpid;
-        nonleaf.locateChildPtr(searchkey, childpid);
-        return recursor(childpid,searchkey,traverse,++num);
+        nonleaf.locateChildPtr(searchkey, childpid, first);
+        pf.unpin(pid);
+        return recursor(childpid,searchkey,traverse,++num,first);
     }
 }
 
@@ -293,68 +662,127 @@ IndexCursor BTreeIndex::recursor(PageId pid,int searchkey,PageId traverse[],int
  * @param rid[OUT] the RecordId stored at the index cursor location.
  * @return error code. 0 if no error
  */
-RC BTreeIndex::readForward(IndexCursor& cursor, int& key, RecordId& rid)
+template<typename Key>
+RC BasicBTreeIndex<Key>::readForward(IndexCursor& cursor, Key& key, RecordId& rid)
 {
-    BTLeafNode leaf;
-    leaf.read(cursor.pid, pf);
-    leaf.readEntry(cursor.eid,key,rid);
+    RC rc;
+    const char* page;
+    if ((rc = pf.pin(cursor.pid, page)) < 0)
+        return rc;
+    BasicBTLeafNode<Key> leaf(page, pf.getPageSize());
+    rc = leaf.readEntry(cursor.eid,key,rid);
+    pf.unpin(cursor.pid);
+    if (rc < 0)
+        return rc;
     cursor.eid++;
     return 0;
 }
 
-RC BTreeIndex::BTLprint(PageId pid){
-    BTLeafNode bl;
+template<typename Key>
+RC BasicBTreeIndex<Key>::readForwardBatch(IndexCursor& cursor, const IndexCursor& end, int max,
+                                vector<Key>& keys, vector<RecordId>& rids)
+{
+    RC rc;
+    Key key;
+    RecordId rid;
+    
+    keys.clear();
+    rids.clear();
+    // the last leaf points to page 0, the index header
+    while ((int) rids.size() < max && cursor.pid != 0 &&
+           (cursor.pid != end.pid || cursor.eid != end.eid))
+    {
+        if ((rc = readForward(cursor, key, rid)) < 0)
+            return rc;
+        keys.push_back(key);
+        rids.push_back(rid);
+        
+        // move on to the next leaf at the end of this one
+        if (cursor.eid > GetKeycount(cursor.pid))
+        {
+            cursor.eid = 1;
+            cursor.pid = GetNextpid(cursor.pid);
+        }
+    }
+    return 0;
+}
+
+// print a key for BTLprint() and BTNLprint()
+static void printKey(int key) { printf("%d", key); }
+static void printKey(int64_t key) { printf("%lld", (long long) key); }
+template<int N>
+static void printKey(const StringKey<N>& key) { printf("'%.*s'", (int) key.view().size(), key.view().data()); }
+
+template<typename Key>
+RC BasicBTreeIndex<Key>::BTLprint(PageId pid){
+    BasicBTLeafNode<Key> bl(pf.getPageSize());
     bl.read(pid, pf);
-    int key;
+    Key key;
     RecordId rid;
     printf("pid:%d, size:%d\n", pid, bl.getKeyCount());
     for (int i=1; i<=bl.getKeyCount(); ++i) {
         bl.readEntry(i, key, rid);
-        printf("%d,%d %d\t", key, rid.pid, rid.sid);
+        printKey(key);
+        printf(",%d %d\t", rid.pid, rid.sid);
     }
     printf("\n");
     return 0;
 }
 
-RC BTreeIndex::BTNLprint(PageId pid){
-    BTNonLeafNode bn;
+template<typename Key>
+RC BasicBTreeIndex<Key>::BTNLprint(PageId pid){
+    BasicBTNonLeafNode<Key> bn(pf.getPageSize());
     bn.read(pid, pf);
-    int key;
+    Key key;
     PageId rid;
     printf("pid:%d, size:%d\n", pid, bn.getKeyCount());
     for (int i=1; i<=bn.getKeyCount(); ++i) {
         bn.readentry(i, key, rid);
-        printf("%d,%d\t", key, rid);
+        printKey(key);
+        printf(",%d\t", rid);
     }
     printf("\n");
     return 0;
 }
 
 
-PageId BTreeIndex::GetNextpid(PageId pid)
+template<typename Key>
+PageId BasicBTreeIndex<Key>::GetNextpid(PageId pid)
 {
-    BTLeafNode leafnode;
-    leafnode.read(pid, pf);
+    const char* page;
+    if (pf.pin(pid, page) < 0)
+        return 0;
+    BasicBTLeafNode<Key> leafnode(page, pf.getPageSize());
     PageId next_pid;
     next_pid = leafnode.getNextNodePtr();
+    pf.unpin(pid);
     return next_pid;
 }
 
-int BTreeIndex::GetKeycount(PageId pid)
+template<typename Key>
+int BasicBTreeIndex<Key>::GetKeycount(PageId pid)
 {
-    BTLeafNode leafnode;
-    leafnode.read(pid, pf);
+    const char* page;
+    if (pf.pin(pid, page) < 0)
+        return 0;
+    BasicBTLeafNode<Key> leafnode(page, pf.getPageSize());
     int keycount;
     keycount = leafnode.getKeyCount();
+    pf.unpin(pid);
     return keycount;
 }
 
-PageId  BTreeIndex::GetLfEpid()
+template<typename Key>
+PageId BasicBTreeIndex<Key>::GetLfEpid()
 {
     PageId epid;
-    char buffer[1024];
+    char buffer[PageFile::MAX_PAGE_SIZE];
     pf.read(0,buffer);
     memcpy(&epid, buffer+sizeof(PageId)+sizeof(int), sizeof(PageId));
     return epid;
 }
 
+// the key types of the indexes (see BTreeKey.h)
+template class BasicBTreeIndex<int>;
+template class BasicBTreeIndex<int64_t>;
+template class BasicBTreeIndex<ValueKey>;
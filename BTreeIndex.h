@@ -13,6 +13,8 @@
 #include "Bruinbase.h"
 #include "PageFile.h"
 #include "RecordFile.h"
+#include "BTreeKey.h"
+#include <vector>
 
              
 /**
@@ -29,36 +31,112 @@ typedef struct {
 } IndexCursor;
 
 /**
- * Implements a B-Tree index for bruinbase.
+ * A stream of (key, RecordId) pairs sorted by key, which
+ * BasicBTreeIndex::bulkLoad() reads one pair at a time. The pairs of a
+ * stream need not fit in memory.
+ */
+template<typename Key>
+class IndexEntryStream {
+ public:
+  virtual ~IndexEntryStream() {}
+
+  /**
+   * Read the next pair of the stream.
+   * @param key[OUT] the key of the pair
+   * @param rid[OUT] the RecordId of the pair
+   * @return 0 if a pair is read. RC_END_OF_TREE past the last pair.
+   *         Otherwise, an error code
+   */
+  virtual RC next(Key& key, RecordId& rid) = 0;
+};
+
+/**
+ * Implements a B-Tree index for bruinbase, with keys of type Key (see
+ * KeyTraits in BTreeKey.h). The header page records the key type, and
+ * an index file is only opened with the type it was created with.
  * 
  */
-class BTreeIndex {
+template<typename Key>
+class BasicBTreeIndex {
  public:
-  BTreeIndex();
+  BasicBTreeIndex();
    // BTreeIndex(const std::string& indexname, char mode);
 
   /**
-   * Open the index file in read or write mode.
-   * Under 'w' mode, the index file should be created if it does not exist.
+   * Open the index file in read, write, memory-mapped or direct mode.
+   * Under 'w', 'm' or 'd' mode, the index file should be created if it does not exist.
    * @param indexname[IN] the name of the index file
-   * @param mode[IN] 'r' for read, 'w' for write
+   * @param mode[IN] 'r' for read, 'w' for write, 'm' for memory-mapped,
+   *                 'd' for direct
+   * @param pageSize[IN] the page size of a new index file. 0 for the default
+   *                 (see PageFile::open())
+   * @param packLeaves[IN] true to pack the leaves of a new index file (see
+   *                 BTLeafNode::setPacking()). They are also packed when
+   *                 BRUINBASE_PACK_INDEX is set to a non-zero number
    * @return error code. 0 if no error
    */
-  RC open(const std::string& indexname, char mode);
+  RC open(const std::string& indexname, char mode, int pageSize = 0, bool packLeaves = false);
 
   /**
-   * Close the index file.
+   * Close the index file. The inserts since the last commit() are
+   * committed first.
    * @return error code. 0 if no error
    */
   RC close();
     
   /**
    * Insert (key, RecordId) pair to the index.
+   * The insert reaches the disk with the next commit().
    * @param key[IN] the key for the value inserted into the index
    * @param rid[IN] the RecordId for the record being inserted into the index
    * @return error code. 0 if no error
    */
-  RC insert(int key, const RecordId& rid);
+  RC insert(const Key& key, const RecordId& rid);
+
+  /**
+   * Commit the inserts since the last commit as one transaction: a crash
+   * keeps all of them or none. Committing a batch of inserts at once
+   * spares a log sync per insert.
+   * @return error code. 0 if no error
+   */
+  RC commit();
+
+  /**
+   * Build the index from (key, RecordId) pairs sorted by key, bottom up:
+   * the leaves are filled left to right to fillPercent % of their
+   * capacity, then each level of non-leaf nodes is built over the one
+   * below it, up to the root. Every page is written once, in pid order,
+   * and the header page last. The pages bypass the write-ahead log, so a
+   * crash during the load leaves an index to be loaded again.
+   * If the index is not empty, the pairs are inserted one by one, and
+   * committed at once.
+   * Only a leaf's worth of pairs is read ahead of the leaf being built,
+   * so the pairs may come from a stream larger than memory.
+   * @param stream[IN] the pairs, in ascending order of keys
+   * @param fillPercent[IN] how full to make a node, in % of its capacity
+   * @return error code. 0 if no error. RC_INVALID_ATTRIBUTE if the keys
+   *         are not sorted
+   */
+  RC bulkLoad(IndexEntryStream<Key>& stream,
+              int fillPercent = DEFAULT_FILL_PERCENT);
+
+  /**
+   * Build the index from the pairs of two vectors, as above. The keys
+   * are checked to be sorted before any of them is loaded.
+   * @param keys[IN] the keys, in ascending order
+   * @param rids[IN] the RecordIds of the keys
+   * @param fillPercent[IN] how full to make a node, in % of its capacity
+   * @return error code. 0 if no error. RC_INVALID_ATTRIBUTE if the keys
+   *         are not sorted, or there is not one RecordId per key
+   */
+  RC bulkLoad(const std::vector<Key>& keys, const std::vector<RecordId>& rids,
+              int fillPercent = DEFAULT_FILL_PERCENT);
+
+  /**
+   * How full bulkLoad() makes a node by default, in %. The room left
+   * takes later inserts without splitting every node.
+   */
+  static const int DEFAULT_FILL_PERCENT = 90;
 
   /**
    * Run the standard B+Tree key search algorithm and identify the
@@ -78,12 +156,12 @@ class BTreeIndex {
    *                    smaller than searchKey.
    * @return 0 if searchKey is found. Othewise, an error code
    */
-  RC locate(int searchKey, IndexCursor& cursor);
+  RC locate(const Key& searchKey, IndexCursor& cursor);
 
     
-  IndexCursor recursor(PageId pid,int searchkey,PageId traverse[],int num);
+  IndexCursor recursor(PageId pid,const Key& searchkey,PageId traverse[],int num,bool first = false);
     
-   RC Treerecursor(PageId traverse[],int level, int siblingkey, PageId siblingpid);
+   RC Treerecursor(PageId traverse[],int level, const Key& siblingkey, PageId siblingpid);
 
   /**
    * Read the (key, rid) pair at the location specified by the index cursor,
@@ -93,7 +171,21 @@ class BTreeIndex {
    * @param rid[OUT] the RecordId stored at the index cursor location
    * @return error code. 0 if no error
    */
-  RC readForward(IndexCursor& cursor, int& key, RecordId& rid);
+  RC readForward(IndexCursor& cursor, Key& key, RecordId& rid);
+
+  /**
+   * Read up to max (key, rid) pairs starting at the cursor, following the
+   * leaf chain, and stop when the cursor reaches end or the last leaf.
+   * The cursor is left on the entry after the last one read.
+   * @param cursor[IN/OUT] the cursor pointing to the first entry to read
+   * @param end[IN] the cursor pointing past the last entry to read
+   * @param max[IN] the maximum # entries to read
+   * @param keys[OUT] the keys read
+   * @param rids[OUT] the RecordIds read
+   * @return error code. 0 if no error
+   */
+  RC readForwardBatch(IndexCursor& cursor, const IndexCursor& end, int max,
+                      std::vector<Key>& keys, std::vector<RecordId>& rids);
     PageId   rootPid;
     int      treeHeight;
     
@@ -107,6 +199,8 @@ class BTreeIndex {
     
   
  private:
+  bool     packLeaves;  /// true if the leaves are packed (see BTLeafNode)
+
   //PageFile pf;         /// the PageFile used to store the actual b+tree in disk
 
 //  PageId   rootPid;    /// the PageId of the root node
@@ -117,4 +211,11 @@ class BTreeIndex {
   /// is opened again later.
 };
 
+/**
+ * The index on the key column, and the indexes of the other key types.
+ */
+typedef BasicBTreeIndex<int> BTreeIndex;
+typedef BasicBTreeIndex<int64_t> BTreeIndex64;
+typedef BasicBTreeIndex<ValueKey> ValueIndex;
+
 #endif /* BTREEINDEX_H */
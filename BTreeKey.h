@@ -0,0 +1,167 @@
+/*
+ * Copyright (C) 2008 by The Regents of the University of California
+ * Redistribution of this file is permitted under the terms of the GNU
+ * Public License (GPL).
+ */
+
+#ifndef BTREEKEY_H
+#define BTREEKEY_H
+
+#include "KeySearch.h"
+#include <cstring>
+#include <stdint.h>
+#include <string_view>
+
+/**
+ * A string key of a B+tree: the first N bytes of a string, padded with
+ * zero bytes. Longer strings are cut to their prefix, so several strings
+ * may share a key; an index on them finds all the strings with the prefix,
+ * and the caller checks the strings themselves.
+ * The keys are in the order of the strings (strcmp()), except that strings
+ * with the same prefix are equal.
+ * A key is a fixed-width slot, not a variable-length string: a node has
+ * no layout for keys of different lengths. The padding is zero bytes,
+ * so view() cannot tell an embedded 0 byte from the padding, and returns
+ * the string up to its first 0 byte only.
+ */
+template<int N>
+struct StringKey {
+  char bytes[N];
+
+  StringKey() { memset(bytes, 0, N); }
+
+  /**
+   * @param s[IN] the string, cut to N bytes
+   */
+  explicit StringKey(std::string_view s) {
+    size_t n = (s.size() < (size_t) N) ? s.size() : N;
+    memcpy(bytes, s.data(), n);
+    memset(bytes + n, 0, N - n);
+  }
+
+  /**
+   * @return the string of the key, without the padding
+   */
+  std::string_view view() const { return std::string_view(bytes, strnlen(bytes, N)); }
+
+  /**
+   * @param s[IN] a string
+   * @return true if the key of s is s itself, not a prefix of it
+   */
+  static bool exact(std::string_view s) { return s.size() < (size_t) N; }
+};
+
+/**
+ * The string key of the value column: long enough for the short values
+ * of a table, and small enough to keep the fanout of a node high.
+ */
+typedef StringKey<16> ValueKey;
+
+/**
+ * How a B+tree node stores and orders its keys. A node keeps its keys
+ * in an array of WIDTH-byte slots, in ascending order (see BTreeNode.h).
+ *   TYPE     the key type recorded in the header of an index file
+ *   WIDTH    # bytes of a key in a node
+ *   PACKABLE true if a leaf may pack its keys (see BTLeafNode::setPacking())
+ *   compare(a, b)  negative, 0 or positive as a is below, equal to or
+ *                  above b
+ *   read(p), write(p, key)  the key in the slot at p
+ *   lowerBound(keys, count, key)  # keys below key
+ *   upperBound(keys, count, key)  # keys below or equal to key
+ *   lowest(), highest()  the smallest and the largest key
+ */
+template<typename Key>
+struct KeyTraits;
+
+/**
+ * The slot operations of a key type that is stored as it is in memory.
+ */
+template<typename Key>
+struct PlainKeyTraits {
+  static const int WIDTH = sizeof(Key);
+
+  static Key read(const char* p) { Key key; memcpy(&key, p, WIDTH); return key; }
+  static void write(char* p, const Key& key) { memcpy(p, &key, WIDTH); }
+};
+
+template<>
+struct KeyTraits<int> : PlainKeyTraits<int> {
+  static const int TYPE = 0;
+  static const bool PACKABLE = true;
+
+  static int compare(int a, int b) { return (a > b) - (a < b); }
+  static int lowerBound(const char* keys, int count, int key) {
+    return KeySearch::lowerBound((const int*) keys, count, key);
+  }
+  static int upperBound(const char* keys, int count, int key) {
+    return KeySearch::upperBound((const int*) keys, count, key);
+  }
+  static int lowest() { return INT32_MIN; }
+  static int highest() { return INT32_MAX; }
+};
+
+/**
+ * Binary search over the slots of a node, for the key types without a
+ * SIMD search. upper is false for lowerBound(), true for upperBound().
+ */
+template<typename Key>
+int searchSlots(const char* keys, int count, const Key& key, bool upper)
+{
+  typedef KeyTraits<Key> Traits;
+  int low = 0;
+  int high = count;
+
+  while (low < high) {
+    int mid = (low + high) / 2;
+    int c = Traits::compare(Traits::read(keys + Traits::WIDTH * mid), key);
+    if (c < 0 || (upper && c == 0))
+      low = mid + 1;
+    else
+      high = mid;
+  }
+  return low;
+}
+
+/**
+ * int64_t keys are stored as they are, and searched by searchSlots(). They
+ * have no SIMD search, and are not packed.
+ */
+template<>
+struct KeyTraits<int64_t> : PlainKeyTraits<int64_t> {
+  static const int TYPE = 1;
+  static const bool PACKABLE = false;
+
+  static int compare(int64_t a, int64_t b) { return (a > b) - (a < b); }
+  static int lowerBound(const char* keys, int count, int64_t key) {
+    return searchSlots<int64_t>(keys, count, key, false);
+  }
+  static int upperBound(const char* keys, int count, int64_t key) {
+    return searchSlots<int64_t>(keys, count, key, true);
+  }
+  static int64_t lowest() { return INT64_MIN; }
+  static int64_t highest() { return INT64_MAX; }
+};
+
+template<int N>
+struct KeyTraits<StringKey<N> > : PlainKeyTraits<StringKey<N> > {
+  static const int TYPE = 0x100 + N;
+  static const bool PACKABLE = false;
+
+  static int compare(const StringKey<N>& a, const StringKey<N>& b) {
+    return memcmp(a.bytes, b.bytes, N);
+  }
+  static int lowerBound(const char* keys, int count, const StringKey<N>& key) {
+    return searchSlots<StringKey<N> >(keys, count, key, false);
+  }
+  static int upperBound(const char* keys, int count, const StringKey<N>& key) {
+    return searchSlots<StringKey<N> >(keys, count, key, true);
+  }
+  static StringKey<N> lowest() { return StringKey<N>(); }
+  static StringKey<N> highest() {
+    StringKey<N> key;
+    memset(key.bytes, 0xff, N);
+    return key;
+  }
+};
+
+#endif /* BTREEKEY_H */
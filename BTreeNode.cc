@@ -1,50 +1,510 @@
 #include "BTreeNode.h"
+#include <climits>
+#include <new>
 
 
 using namespace std;
 
+/*
+ * The key count, the node flag and the next node pointer at the end of
+ * a node page, in this order.
+ */
+static int countOffset(int size)
+{
+    return size-sizeof(PageId)-2*sizeof(int);
+}
+
+static int flagOffset(int size)
+{
+    return size-sizeof(PageId)-sizeof(int);
+}
+
+static int readFlag(const char* page, int size)
+{
+    int flag;
+    memcpy(&flag, page+flagOffset(size), sizeof(int));
+    return flag;
+}
+
+static void writeFlag(char* page, int size, int flag)
+{
+    memcpy(page+flagOffset(size), &flag, sizeof(int));
+}
+
+/*
+ * The # entries of an unpacked leaf of the given size, with keys of
+ * width bytes: the keys, the RecordIds, then the count, the flag and the
+ * next pointer.
+ */
+// allocate a node buffer aligned like a cache frame
+static char* allocNodeBuffer(int size)
+{
+    void* p;
+    if (posix_memalign(&p, 64, size) != 0)
+        throw std::bad_alloc();
+    return (char*) p;
+}
+
+static int leafCapacity(int size, int width)
+{
+    return (size-2*sizeof(int)-sizeof(PageId))/(width+sizeof(RecordId));
+}
+
+/*
+ * The header of a packed leaf. The bit-packed keys, pids and sids follow
+ * it, each array starting on a byte.
+ */
+struct PackedHeader {
+    int    keyBase;   // the smallest key
+    PageId pidBase;   // the smallest pid
+    int    sidBase;   // the smallest sid
+    unsigned char keyBits;  // # bits of a key - keyBase
+    unsigned char pidBits;  // # bits of a pid - pidBase
+    unsigned char sidBits;  // # bits of a sid - sidBase
+    unsigned char unused;
+};
+
+// the largest # entries of a packed leaf, of any page size
+static const int MAX_PACKED_ENTRIES = 2*PageFile::MAX_PAGE_SIZE/(sizeof(int)+sizeof(RecordId));
+
+static int bitsFor(unsigned range)
+{
+    return range ? 32-__builtin_clz(range) : 0;
+}
+
+static int packedBytes(int count, int bits)
+{
+    return (count*bits+7)/8;
+}
+
+/*
+ * Add the value at the bit offset of a zeroed bit array. Like getBits(),
+ * this touches the 8 bytes from the byte of the offset on.
+ */
+static void putBits(char* out, int bit, unsigned value)
+{
+    unsigned long long word;
+    memcpy(&word, out+(bit>>3), sizeof(word));
+    word |= (unsigned long long) value << (bit&7);
+    memcpy(out+(bit>>3), &word, sizeof(word));
+}
+
+static unsigned getBits(const char* in, int bit, int bits)
+{
+    unsigned long long word;
+    memcpy(&word, in+(bit>>3), sizeof(word));
+    return (unsigned) ((word >> (bit&7)) & ((1ULL << bits)-1));
+}
+
+/*
+ * Unpack count values of a bit array at once, adding base to each.
+ */
+static void unpackBits(const char* in, int bits, int count, unsigned base, int* out)
+{
+    if (bits == 0)
+    {
+        for (int i = 0; i < count; i++)
+            out[i] = (int) base;
+        return;
+    }
+    unsigned long long mask = (1ULL << bits)-1;
+    for (int i = 0, bit = 0; i < count; i++, bit += bits)
+    {
+        unsigned long long word;
+        memcpy(&word, in+(bit>>3), sizeof(word));
+        out[i] = (int) (base + (unsigned) ((word >> (bit&7)) & mask));
+    }
+}
+
+/*
+ * Tell whether a node page holds a leaf node, in either layout.
+ * @param page[IN] the node page
+ * @param size[IN] the page size of the index file
+ * @return true if the page is a leaf node
+ */
+template<typename Key>
+bool BasicBTLeafNode<Key>::isLeaf(const char* page, int size)
+{
+    int flag = readFlag(page, size);
+    return flag == LEAF_FLAG || flag == PACKED_LEAF_FLAG || flag == LEGACY_LEAF_FLAG;
+}
+
+template<typename Key>
+void BasicBTLeafNode<Key>::setPageSize(int size)
+{
+    pageSize = size;
+    nodeSize = size;
+    leaftotal = leafCapacity(size, Traits::WIDTH);
+}
+
+template<typename Key>
+void BasicBTLeafNode<Key>::setPacking(bool on)
+{
+    if (!on || !Traits::PACKABLE || nodeSize != pageSize || buffer != page.get())
+        return;
+    convert();
+    // move the entries to the larger layout
+    std::vector<char> old(buffer, buffer+pageSize);
+    int num = getKeyCount();
+    PageId next = getNextNodePtr();
+    nodeSize = 2*pageSize;
+    leaftotal = 2*leafCapacity(pageSize, Traits::WIDTH)-2;
+    clear();
+    memcpy(buffer,&old[0],Traits::WIDTH*num);
+    memcpy(ridPtr(0),&old[Traits::WIDTH*leafCapacity(pageSize, Traits::WIDTH)],sizeof(RecordId)*num);
+    setKeyCount(num);
+    setNextNodePtr(next);
+}
+
+template<typename Key>
+void BasicBTLeafNode<Key>::clear()
+{
+    memset(buffer,0,nodeSize);
+    writeFlag(buffer, nodeSize, LEAF_FLAG);
+}
+
+template<typename Key>
+bool BasicBTLeafNode<Key>::isLegacy() const
+{
+    int flag = readFlag(buffer, nodeSize);
+    return flag != LEAF_FLAG && flag != PACKED_LEAF_FLAG;
+}
+
+template<typename Key>
+bool BasicBTLeafNode<Key>::isPacked() const
+{
+    return readFlag(buffer, nodeSize) == PACKED_LEAF_FLAG;
+}
+
+template<typename Key>
+void BasicBTLeafNode<Key>::setKeyCount(int count)
+{
+    memcpy(buffer+countOffset(nodeSize),&count,sizeof(int));
+}
+
+template<typename Key>
+void BasicBTLeafNode<Key>::convert()
+{
+    if (!isLegacy())
+        return;
+    // the old node is a count followed by (RecordId, key) pairs
+    char old[PageFile::MAX_PAGE_SIZE];
+    memcpy(old,buffer,pageSize);
+    int num;
+    memcpy(&num,old,sizeof(int));
+    if (num < 0 || num > leaftotal)
+        num = 0;
+    PageId next = getNextNodePtr();
+    clear();
+    for (int i = 0; i < num; i++)
+    {
+        const char* entry = old+sizeof(int)+(sizeof(RecordId)+Traits::WIDTH)*i;
+        memcpy(buffer+Traits::WIDTH*i,entry+sizeof(RecordId),Traits::WIDTH);
+        memcpy(ridPtr(i),entry,sizeof(RecordId));
+    }
+    setKeyCount(num);
+    setNextNodePtr(next);
+}
+
+/*
+ * Only int keys are packed (see setPacking()). The packed paths below are
+ * defined for them alone, and the callers reach them under
+ * if constexpr (Traits::PACKABLE), so that a node of other keys has none.
+ */
+
+// the smallest and the largest pid and sid of the entries
+static void ridRange(const char* rids, int num, RecordId& low, RecordId& high)
+{
+    RecordId rid;
+    memcpy(&low,rids,sizeof(RecordId));
+    high = low;
+    for (int i = 1; i < num; i++)
+    {
+        memcpy(&rid,rids+sizeof(RecordId)*i,sizeof(RecordId));
+        low.pid = min(low.pid, rid.pid);
+        high.pid = max(high.pid, rid.pid);
+        low.sid = min(low.sid, rid.sid);
+        high.sid = max(high.sid, rid.sid);
+    }
+}
+
+template<>
+int BasicBTLeafNode<int>::packedSize() const
+{
+    int num;
+    memcpy(&num,buffer+countOffset(nodeSize),sizeof(int));
+    if (num == 0)
+        return sizeof(PackedHeader);
+    // the keys are sorted. the RecordIds are not
+    const int* key = (const int*) keys();
+    RecordId low, high;
+    ridRange(ridPtr(0), num, low, high);
+    int keyBits = bitsFor((unsigned) key[num-1] - (unsigned) key[0]);
+    int pidBits = bitsFor((unsigned) high.pid - (unsigned) low.pid);
+    int sidBits = bitsFor((unsigned) high.sid - (unsigned) low.sid);
+    return sizeof(PackedHeader)+packedBytes(num,keyBits)+packedBytes(num,pidBits)+packedBytes(num,sidBits);
+}
+
+template<>
+void BasicBTLeafNode<int>::packEntries()
+{
+    int num = getKeyCount();
+    const int* key = (const int*) keys();
+    PackedHeader header;
+    RecordId rid;
+    memset(&header,0,sizeof(header));
+    if (num > 0)
+    {
+        RecordId low, high;
+        ridRange(ridPtr(0), num, low, high);
+        header.keyBase = key[0];
+        header.pidBase = low.pid;
+        header.sidBase = low.sid;
+        header.keyBits = bitsFor((unsigned) key[num-1] - (unsigned) key[0]);
+        header.pidBits = bitsFor((unsigned) high.pid - (unsigned) low.pid);
+        header.sidBits = bitsFor((unsigned) high.sid - (unsigned) low.sid);
+    }
+    char* packed = packImage();
+    memcpy(packed,&header,sizeof(header));
+
+    char* keyBits = packed+sizeof(header);
+    char* pidBits = keyBits+packedBytes(num,header.keyBits);
+    char* sidBits = pidBits+packedBytes(num,header.pidBits);
+    for (int i = 0; i < num; i++)
+    {
+        memcpy(&rid,ridPtr(i),sizeof(RecordId));
+        if (header.keyBits > 0)
+            putBits(keyBits, i*header.keyBits, (unsigned) key[i]-(unsigned) header.keyBase);
+        if (header.pidBits > 0)
+            putBits(pidBits, i*header.pidBits, (unsigned) rid.pid-(unsigned) header.pidBase);
+        if (header.sidBits > 0)
+            putBits(sidBits, i*header.sidBits, (unsigned) rid.sid-(unsigned) header.sidBase);
+    }
+}
+
+template<>
+void BasicBTLeafNode<int>::pack()
+{
+    int num = getKeyCount();
+    PageId next = getNextNodePtr();
+    char* packed = packImage();
+    memset(packed,0,pageSize);
+
+    // a node that does not fit packed has few enough entries to fit
+    // unpacked
+    if (packedSize() > countOffset(pageSize))
+    {
+        memcpy(packed,buffer,Traits::WIDTH*num);
+        memcpy(packed+Traits::WIDTH*leafCapacity(pageSize, Traits::WIDTH),ridPtr(0),sizeof(RecordId)*num);
+        memcpy(packed+countOffset(pageSize),&num,sizeof(int));
+        writeFlag(packed, pageSize, LEAF_FLAG);
+        memcpy(packed+pageSize-sizeof(PageId),&next,sizeof(PageId));
+        return;
+    }
+    packEntries();
+    memcpy(packed+countOffset(pageSize),&num,sizeof(int));
+    writeFlag(packed, pageSize, PACKED_LEAF_FLAG);
+    memcpy(packed+pageSize-sizeof(PageId),&next,sizeof(PageId));
+}
+
+template<>
+RC BasicBTLeafNode<int>::unpack()
+{
+    PackedHeader header;
+    int num;
+    PageId next;
+    const char* packed = packImage();
+    memcpy(&header,packed,sizeof(header));
+    memcpy(&num,packed+countOffset(pageSize),sizeof(int));
+    memcpy(&next,packed+pageSize-sizeof(PageId),sizeof(PageId));
+    if (num < 0 || num > leaftotal || header.keyBits > 32 || header.pidBits > 32 || header.sidBits > 32 ||
+        (int) sizeof(header)+packedBytes(num,header.keyBits)+packedBytes(num,header.pidBits)
+        +packedBytes(num,header.sidBits) > countOffset(pageSize))
+        return RC_INVALID_FILE_FORMAT;
+
+    // the keys go straight to the key array. the pids and sids are
+    // unpacked apart, then paired up
+    int pids[MAX_PACKED_ENTRIES];
+    int sids[MAX_PACKED_ENTRIES];
+    const char* keyBits = packed+sizeof(header);
+    const char* pidBits = keyBits+packedBytes(num,header.keyBits);
+    const char* sidBits = pidBits+packedBytes(num,header.pidBits);
+    clear();
+    unpackBits(keyBits, header.keyBits, num, header.keyBase, (int*) buffer);
+    unpackBits(pidBits, header.pidBits, num, header.pidBase, pids);
+    unpackBits(sidBits, header.sidBits, num, header.sidBase, sids);
+    for (int i = 0; i < num; i++)
+    {
+        RecordId rid = { pids[i], sids[i] };
+        memcpy(ridPtr(i),&rid,sizeof(RecordId));
+    }
+    setKeyCount(num);
+    setNextNodePtr(next);
+    return 0;
+}
+
+template<>
+RC BasicBTLeafNode<int>::locatePacked(const int& searchKey, int& eid)
+{
+    // the keys are unpacked together, then searched
+    int num = getKeyCount();
+    int unpacked[MAX_PACKED_ENTRIES];
+    PackedHeader header;
+    memcpy(&header,buffer,sizeof(header));
+    if (num < 0 || num > MAX_PACKED_ENTRIES)
+        num = 0;
+    unpackBits(buffer+sizeof(header), header.keyBits, num, header.keyBase, unpacked);
+    int i = KeySearch::lowerBound(unpacked, num, searchKey);
+    eid = i+1;
+    if (i < num && unpacked[i] != searchKey)
+        return RC_NO_SUCH_RECORD;
+    return 0;
+}
+
+template<>
+RC BasicBTLeafNode<int>::readPacked(int eid, int& key, RecordId& rid)
+{
+    // an entry is unpacked alone
+    int num = getKeyCount();
+    PackedHeader header;
+    memcpy(&header,buffer,sizeof(header));
+    if (num > MAX_PACKED_ENTRIES)
+        return RC_INVALID_FILE_FORMAT;
+    const char* keyBits = buffer+sizeof(header);
+    const char* pidBits = keyBits+packedBytes(num,header.keyBits);
+    const char* sidBits = pidBits+packedBytes(num,header.pidBits);
+    int n = eid-1;
+    key = header.keyBase+getBits(keyBits, n*header.keyBits, header.keyBits);
+    rid.pid = header.pidBase+getBits(pidBits, n*header.pidBits, header.pidBits);
+    rid.sid = header.sidBase+getBits(sidBits, n*header.sidBits, header.sidBits);
+    return 0;
+}
+
+template<typename Key>
+char* BasicBTLeafNode<Key>::output()
+{
+    if constexpr (Traits::PACKABLE)
+    {
+        if (nodeSize != pageSize)
+        {
+            pack();
+            return packImage();
+        }
+    }
+    return buffer;
+}
+
+template<typename Key>
+char* BasicBTLeafNode<Key>::ownPage()
+{
+    // room for a packed node, which holds up to twice a page. a read
+    // from a file with larger pages needs a larger buffer
+    if (!page || pageBytes < 2*pageSize)
+    {
+        page.reset(allocNodeBuffer(2*pageSize));
+        pageBytes = 2*pageSize;
+    }
+    return page.get();
+}
+
+template<typename Key>
+char* BasicBTLeafNode<Key>::packImage()
+{
+    if (!image || imageBytes < pageSize)
+    {
+        image.reset(new char[pageSize]);
+        imageBytes = pageSize;
+    }
+    return image.get();
+}
+
 /*
  * Read the content of the node from the page pid in the PageFile pf.
  * @param pid[IN] the PageId to read
  * @param pf[IN] PageFile to read from
  * @return 0 if successful. Return an error code if there is an error.
  */
-RC BTLeafNode::read(PageId pid, const PageFile& pf)
+template<typename Key>
+RC BasicBTLeafNode<Key>::read(PageId pid, const PageFile& pf)
 {
     RC rc;
     if (pid < 0 || pid >= pf.endPid())
         return RC_INVALID_PID;
+    setPageSize(pf.getPageSize());
+    buffer = ownPage();
     if ((rc = pf.read(pid, buffer)) < 0)
         return rc;
+    // a packed node is unpacked, so that it may be updated
+    if (isPacked())
+    {
+        if constexpr (Traits::PACKABLE)
+        {
+            memcpy(packImage(),buffer,pageSize);
+            nodeSize = 2*pageSize;
+            leaftotal = 2*leafCapacity(pageSize, Traits::WIDTH)-2;
+            return unpack();
+        }
+        else
+            return RC_INVALID_FILE_FORMAT;
+    }
+    // a node read into its own buffer may be updated
+    convert();
     return 0;
 }
-    
+
 /*
  * Write the content of the node to the page pid in the PageFile pf.
  * @param pid[IN] the PageId to write to
  * @param pf[IN] PageFile to write to
  * @return 0 if successful. Return an error code if there is an error.
  */
-RC BTLeafNode::write(PageId pid, PageFile& pf)
+template<typename Key>
+RC BasicBTLeafNode<Key>::write(PageId pid, PageFile& pf)
 {
     RC rc;
     if (pid < 0)
         return RC_INVALID_PID;
-    int flag = 0;
-    memcpy(buffer+1016,&flag,4);
-    if((rc=pf.write(pid, buffer))<0)
+    if (pageSize != pf.getPageSize())
+        return RC_INVALID_PAGE_SIZE;
+    // the node is always written in the current layout
+    convert();
+    if((rc=pf.write(pid, output()))<0)
         return rc;
     return 0;
 }
 
+/*
+ * Prepare the content of the node for the page pid in the PageFile pf
+ * and add it to batch, to be written by PageFile::writev().
+ * @param pid[IN] the PageId to write to
+ * @param pf[IN] PageFile to write to
+ * @param batch[IN/OUT] the pages to write together
+ * @return 0 if successful. Return an error code if there is an error.
+ */
+template<typename Key>
+RC BasicBTLeafNode<Key>::write(PageId pid, PageFile& pf, std::vector<PageIO>& batch)
+{
+    if (pid < 0)
+        return RC_INVALID_PID;
+    if (pageSize != pf.getPageSize())
+        return RC_INVALID_PAGE_SIZE;
+    convert();
+    PageIO io;
+    io.pid = pid;
+    io.buffer = output();
+    batch.push_back(io);
+    return 0;
+}
+
 /*
  * Return the number of keys stored in the node.
  * @return the number of keys in the node
  */
-int BTLeafNode::getKeyCount()
+template<typename Key>
+int BasicBTLeafNode<Key>::getKeyCount()
 {
     int count;
-    memcpy(&count, buffer, sizeof(int));
+    memcpy(&count, isLegacy() ? buffer : buffer+countOffset(nodeSize), sizeof(int));
     return count;
 }
 
@@ -54,28 +514,33 @@ int BTLeafNode::getKeyCount()
  * @param rid[IN] the RecordId to insert
  * @return 0 if successful. Return an error code if the node is full.
  */
-RC BTLeafNode::insert(int key, const RecordId& rid)
+template<typename Key>
+RC BasicBTLeafNode<Key>::insert(const Key& key, const RecordId& rid)
 {
+    convert();
     int num;
     num = getKeyCount();
-    RC rc = -1;
     if(num >= leaftotal)
-        return rc;
-    int i;
-    for(i = 0; i < num; i++)
+        return RC_NODE_FULL;
+    // the new key goes after the keys equal to it
+    int i = Traits::upperBound(keys(), num, key);
+    memmove(buffer+Traits::WIDTH*(i+1),buffer+Traits::WIDTH*i,Traits::WIDTH*(num-i));
+    memmove(ridPtr(i+1),ridPtr(i),sizeof(RecordId)*(num-i));
+    Traits::write(buffer+Traits::WIDTH*i,key);
+    memcpy(ridPtr(i),&rid,sizeof(RecordId));
+    setKeyCount(num+1);
+
+    // a packed node must still fit in the page, packed or not
+    if constexpr (Traits::PACKABLE)
     {
-        int cur_key;
-        memcpy(&cur_key,buffer+sizeof(int)+sizeof(RecordId)+(sizeof(key)+sizeof(RecordId))*i,sizeof(int));
-        if(cur_key > key)
-            break;
+        if (nodeSize != pageSize && num+1 > leafCapacity(pageSize, Traits::WIDTH) && packedSize() > countOffset(pageSize))
+        {
+            memmove(buffer+Traits::WIDTH*i,buffer+Traits::WIDTH*(i+1),Traits::WIDTH*(num-i));
+            memmove(ridPtr(i),ridPtr(i+1),sizeof(RecordId)*(num-i));
+            setKeyCount(num);
+            return RC_NODE_FULL;
+        }
     }
-    memmove(buffer+sizeof(int)+(sizeof(key)+sizeof(RecordId))*(i+1),buffer+sizeof(int)
-            +(sizeof(key)+sizeof(RecordId))*i,(sizeof(RecordId)+sizeof(int))*(num-i));
-    memcpy(buffer+sizeof(int)+(sizeof(key)+sizeof(RecordId))*i,&rid,sizeof(RecordId));
-    memcpy(buffer+sizeof(int)+sizeof(RecordId)+(sizeof(key)+sizeof(RecordId))*i,&key,sizeof(int));
-    
-    num +=1;
-    memcpy(buffer,&num,sizeof(int));
     return 0;
 }
 
@@ -89,41 +554,42 @@ RC BTLeafNode::insert(int key, const RecordId& rid)
  * @param siblingKey[OUT] the first key in the sibling node after split.
  * @return 0 if successful. Return an error code if there is an error.
  */
-RC BTLeafNode::insertAndSplit(int key, const RecordId& rid, 
-                              BTLeafNode& sibling, int& siblingKey)
+template<typename Key>
+RC BasicBTLeafNode<Key>::insertAndSplit(const Key& key, const RecordId& rid,
+                              BasicBTLeafNode& sibling, Key& siblingKey)
 {
-    int total;
-    total = (sizeof(buffer)-sizeof(int))/(sizeof(RecordId)+sizeof(int));
+    convert();
+    sibling.convert();
     int num;
     num = getKeyCount();
     RC rc = -1;
-    if(num < leaftotal)
+    // a packed node may be full before it has leaftotal entries
+    if(num < leaftotal && nodeSize == pageSize)
         return rc;
-    char tempNode[PageFile::PAGE_SIZE+sizeof(RecordId)+sizeof(int)];
-    memcpy(tempNode,buffer,sizeof(buffer));
-    int i;
-    for(i = 0; i < num; i++)
-    {
-        int cur_key;
-        memcpy(&cur_key,tempNode+sizeof(int)+sizeof(RecordId)+(sizeof(key)+sizeof(RecordId))*i,sizeof(int));
-        if(cur_key > key)
-            break;
-    }
-    memmove(tempNode+sizeof(int)+(sizeof(key)+sizeof(RecordId))*(i+1),tempNode+sizeof(int)+(sizeof(key)+sizeof(RecordId))*i,(sizeof(RecordId)+sizeof(int))*(num-i));
-    memcpy(tempNode+sizeof(int)+(sizeof(key)+sizeof(RecordId))*i,&rid,sizeof(RecordId));
-    memcpy(tempNode+sizeof(int)+sizeof(RecordId)+(sizeof(key)+sizeof(RecordId))*i,&key,sizeof(int));
-    
+    // the keys and the RecordIds with the new pair in place
+    char tempKeys[2*PageFile::MAX_PAGE_SIZE+sizeof(Key)];
+    RecordId tempRids[MAX_PACKED_ENTRIES+1];
+    int i = Traits::upperBound(keys(), num, key);
+    memcpy(tempKeys,buffer,Traits::WIDTH*i);
+    memcpy(tempRids,ridPtr(0),sizeof(RecordId)*i);
+    Traits::write(tempKeys+Traits::WIDTH*i,key);
+    tempRids[i] = rid;
+    memcpy(tempKeys+Traits::WIDTH*(i+1),buffer+Traits::WIDTH*i,Traits::WIDTH*(num-i));
+    memcpy(tempRids+i+1,ridPtr(i),sizeof(RecordId)*(num-i));
+
     num +=1;
     int num_left= (num/2)+1;
     int num_right = num-num_left;
-    memset(buffer,0,sizeof(buffer));
-    memcpy(buffer,&num_left,sizeof(int));
-    memcpy(buffer+sizeof(int),tempNode+sizeof(int),(sizeof(RecordId)+sizeof(int))*num_left);
-    
-    memcpy(sibling.buffer,&num_right,sizeof(int));
-    memcpy(sibling.buffer+sizeof(int),tempNode+sizeof(int)+(sizeof(RecordId)+sizeof(int))*num_left,(sizeof(RecordId)+sizeof(int))*num_right);
-    
-    memcpy(&siblingKey,sibling.buffer+sizeof(int)+sizeof(RecordId),sizeof(int));
+    clear();
+    memcpy(buffer,tempKeys,Traits::WIDTH*num_left);
+    memcpy(ridPtr(0),tempRids,sizeof(RecordId)*num_left);
+    setKeyCount(num_left);
+
+    memcpy(sibling.buffer,tempKeys+Traits::WIDTH*num_left,Traits::WIDTH*num_right);
+    memcpy(sibling.ridPtr(0),tempRids+num_left,sizeof(RecordId)*num_right);
+    sibling.setKeyCount(num_right);
+
+    siblingKey = Traits::read(tempKeys+Traits::WIDTH*num_left);
     return 0;
 }
 
@@ -138,26 +604,42 @@ RC BTLeafNode::insertAndSplit(int key, const RecordId& rid,
                    behind the largest key smaller than searchKey.
  * @return 0 if searchKey is found. Otherwise return an error code.
  */
-RC BTLeafNode::locate(int searchKey, int& eid)
+template<typename Key>
+RC BasicBTLeafNode<Key>::locate(const Key& searchKey, int& eid)
 {
     int num = getKeyCount();
     int i;
-    for(i = 0; i < num; i++)
+    if (isLegacy())
     {
-        int key;
-        memcpy(&key,buffer+sizeof(int)+sizeof(RecordId)+(sizeof(key)+sizeof(RecordId))*i,sizeof(int));
-        if(key == searchKey)
+        for(i = 0; i < num; i++)
         {
-            eid = i+1;
-            return 0;
-        }
-        else if(key > searchKey)
-        {
-            eid = i+1;
-            return RC_NO_SUCH_RECORD;
+            Key key = Traits::read(buffer+sizeof(int)+sizeof(RecordId)+(Traits::WIDTH+sizeof(RecordId))*i);
+            int c = Traits::compare(key, searchKey);
+            if(c == 0)
+            {
+                eid = i+1;
+                return 0;
+            }
+            else if(c > 0)
+            {
+                eid = i+1;
+                return RC_NO_SUCH_RECORD;
+            }
         }
+        eid = i+1;
+        return 0;
+    }
+    if (isPacked())
+    {
+        if constexpr (Traits::PACKABLE)
+            return locatePacked(searchKey, eid);
+        else
+            return RC_INVALID_FILE_FORMAT;
     }
+    i = Traits::lowerBound(keys(), num, searchKey);
     eid = i+1;
+    if (i < num && Traits::compare(Traits::read(buffer+Traits::WIDTH*i), searchKey) != 0)
+        return RC_NO_SUCH_RECORD;
     return 0;
 }
 
@@ -168,83 +650,192 @@ RC BTLeafNode::locate(int searchKey, int& eid)
  * @param rid[OUT] the RecordId from the entry
  * @return 0 if successful. Return an error code if there is an error.
  */
-RC BTLeafNode::readEntry(int eid, int& key, RecordId& rid)
+template<typename Key>
+RC BasicBTLeafNode<Key>::readEntry(int eid, Key& key, RecordId& rid)
 {
-    int num;
-    memcpy(&num, buffer, sizeof(int));
-    RC rc;
+    int num = getKeyCount();
     if(eid < 1 || eid > num)
-        return rc;
-    memcpy(&key,buffer+sizeof(int)+sizeof(RecordId)+(sizeof(key)+sizeof(RecordId))*(eid-1),sizeof(int));
-    memcpy(&rid, buffer+sizeof(int)+(sizeof(RecordId)+sizeof(key))*(eid-1),sizeof(rid));
+        return RC_INVALID_CURSOR;
+    if (isLegacy())
+    {
+        key = Traits::read(buffer+sizeof(int)+sizeof(RecordId)+(Traits::WIDTH+sizeof(RecordId))*(eid-1));
+        memcpy(&rid, buffer+sizeof(int)+(sizeof(RecordId)+Traits::WIDTH)*(eid-1),sizeof(rid));
+        return 0;
+    }
+    if (isPacked())
+    {
+        if constexpr (Traits::PACKABLE)
+            return readPacked(eid, key, rid);
+        else
+            return RC_INVALID_FILE_FORMAT;
+    }
+    key = Traits::read(buffer+Traits::WIDTH*(eid-1));
+    memcpy(&rid,ridPtr(eid-1),sizeof(rid));
     return 0;
 }
 
 /*
  * Return the pid of the next slibling node.
- * @return the PageId of the next sibling node 
+ * @return the PageId of the next sibling node
  */
-PageId BTLeafNode::getNextNodePtr()
+template<typename Key>
+PageId BasicBTLeafNode<Key>::getNextNodePtr()
 {
     PageId next_pid;
-    memcpy(&next_pid,buffer+sizeof(buffer)-sizeof(PageId),sizeof(PageId));
+    memcpy(&next_pid,buffer+nodeSize-sizeof(PageId),sizeof(PageId));
     return next_pid;
-    
+
 }
 
 /*
  * Set the pid of the next slibling node.
- * @param pid[IN] the PageId of the next sibling node 
+ * @param pid[IN] the PageId of the next sibling node
  * @return 0 if successful. Return an error code if there is an error.
  */
-RC BTLeafNode::setNextNodePtr(PageId pid)
+template<typename Key>
+RC BasicBTLeafNode<Key>::setNextNodePtr(PageId pid)
 {
-    memcpy(buffer+sizeof(buffer)-sizeof(PageId),&pid,sizeof(pid));
+    memcpy(buffer+nodeSize-sizeof(PageId),&pid,sizeof(pid));
     return 0;
 }
 
+template<typename Key>
+void BasicBTNonLeafNode<Key>::setPageSize(int size)
+{
+    pageSize = size;
+    // the keys, one more child pointer than keys, then the count, the
+    // flag and the unused next pointer
+    nonleaftotal = (size-2*sizeof(int)-2*sizeof(PageId))/(Traits::WIDTH+sizeof(PageId));
+}
+
+template<typename Key>
+void BasicBTNonLeafNode<Key>::clear()
+{
+    memset(buffer,0,pageSize);
+    writeFlag(buffer, pageSize, NONLEAF_FLAG);
+}
+
+template<typename Key>
+bool BasicBTNonLeafNode<Key>::isLegacy() const
+{
+    return readFlag(buffer, pageSize) != NONLEAF_FLAG;
+}
+
+template<typename Key>
+void BasicBTNonLeafNode<Key>::setKeyCount(int count)
+{
+    memcpy(buffer+countOffset(pageSize),&count,sizeof(int));
+}
+
+template<typename Key>
+void BasicBTNonLeafNode<Key>::convert()
+{
+    if (!isLegacy())
+        return;
+    // the old node is a count and the first pointer, followed by
+    // (key, PageId) pairs
+    char old[PageFile::MAX_PAGE_SIZE];
+    memcpy(old,buffer,pageSize);
+    int num;
+    memcpy(&num,old,sizeof(int));
+    if (num < 0 || num > nonleaftotal)
+        num = 0;
+    clear();
+    memcpy(pidPtr(0),old+sizeof(int),sizeof(PageId));
+    for (int i = 0; i < num; i++)
+    {
+        const char* entry = old+sizeof(int)+sizeof(PageId)+(Traits::WIDTH+sizeof(PageId))*i;
+        memcpy(buffer+Traits::WIDTH*i,entry,Traits::WIDTH);
+        memcpy(pidPtr(i+1),entry+Traits::WIDTH,sizeof(PageId));
+    }
+    setKeyCount(num);
+}
+
+template<typename Key>
+char* BasicBTNonLeafNode<Key>::ownPage()
+{
+    if (!page || pageBytes < pageSize)
+    {
+        page.reset(allocNodeBuffer(pageSize));
+        pageBytes = pageSize;
+    }
+    return page.get();
+}
+
 /*
  * Read the content of the node from the page pid in the PageFile pf.
  * @param pid[IN] the PageId to read
  * @param pf[IN] PageFile to read from
  * @return 0 if successful. Return an error code if there is an error.
  */
-RC BTNonLeafNode::read(PageId pid, const PageFile& pf)
+template<typename Key>
+RC BasicBTNonLeafNode<Key>::read(PageId pid, const PageFile& pf)
 {
     RC rc;
     if (pid < 0 || pid >= pf.endPid())
         return RC_INVALID_PID;
+    setPageSize(pf.getPageSize());
+    buffer = ownPage();
     if ((rc = pf.read(pid, buffer)) < 0)
         return rc;
+    // a node read into its own buffer may be updated
+    convert();
     return 0;
  }
-    
+
 /*
  * Write the content of the node to the page pid in the PageFile pf.
  * @param pid[IN] the PageId to write to
  * @param pf[IN] PageFile to write to
  * @return 0 if successful. Return an error code if there is an error.
  */
-RC BTNonLeafNode::write(PageId pid, PageFile& pf)
+template<typename Key>
+RC BasicBTNonLeafNode<Key>::write(PageId pid, PageFile& pf)
 {
     RC rc;
     if (pid < 0)
         return RC_INVALID_PID;
-    int flag = 1;
-    memcpy(buffer+1016,&flag,4);
+    if (pageSize != pf.getPageSize())
+        return RC_INVALID_PAGE_SIZE;
+    // the node is always written in the current layout
+    convert();
     if((rc=pf.write(pid, buffer))<0)
         return rc;
     return 0;
 }
 
+/*
+ * Prepare the content of the node for the page pid in the PageFile pf
+ * and add it to batch, to be written by PageFile::writev().
+ * @param pid[IN] the PageId to write to
+ * @param pf[IN] PageFile to write to
+ * @param batch[IN/OUT] the pages to write together
+ * @return 0 if successful. Return an error code if there is an error.
+ */
+template<typename Key>
+RC BasicBTNonLeafNode<Key>::write(PageId pid, PageFile& pf, std::vector<PageIO>& batch)
+{
+    if (pid < 0)
+        return RC_INVALID_PID;
+    if (pageSize != pf.getPageSize())
+        return RC_INVALID_PAGE_SIZE;
+    convert();
+    PageIO io;
+    io.pid = pid;
+    io.buffer = buffer;
+    batch.push_back(io);
+    return 0;
+}
+
 /*
  * Return the number of keys stored in the node.
  * @return the number of keys in the node
  */
-int BTNonLeafNode::getKeyCount()
+template<typename Key>
+int BasicBTNonLeafNode<Key>::getKeyCount()
 {
     int count;
-    memcpy(&count,buffer,sizeof(int));
+    memcpy(&count, isLegacy() ? buffer : buffer+countOffset(pageSize), sizeof(int));
     return count;
 }
 
@@ -255,28 +846,23 @@ int BTNonLeafNode::getKeyCount()
  * @param pid[IN] the PageId to insert
  * @return 0 if successful. Return an error code if the node is full.
  */
-RC BTNonLeafNode::insert(int key, PageId pid)
+template<typename Key>
+RC BasicBTNonLeafNode<Key>::insert(const Key& key, PageId pid)
 {
-    
+    convert();
     int num;
     num = getKeyCount();
     RC rc=-1;
     if(num >= nonleaftotal)
         return rc;
-    int i;
-    for(i = 0; i< num;i++)
-    {
-        int cur_key;
-        memcpy(&cur_key,buffer+sizeof(int)+sizeof(PageId)+(sizeof(int)+sizeof(PageId))*i,sizeof(int));
-        if(cur_key > key)
-            break;
-    }
-    memmove(buffer+sizeof(int)+sizeof(PageId)+(sizeof(int)+sizeof(PageId))*(i+1),buffer+sizeof(int)+sizeof(PageId)+(sizeof(PageId)+sizeof(int))*i,(sizeof(int)+sizeof(PageId))*(num-i));
-    memcpy(buffer+sizeof(int)+sizeof(PageId)+(sizeof(int)+sizeof(PageId))*i,&key,sizeof(int));
-    memcpy(buffer+sizeof(int)+sizeof(PageId)+(sizeof(int)+sizeof(PageId))*i+sizeof(int),&pid,sizeof(PageId));
-    
-    num += 1;
-    memcpy(buffer,&num,sizeof(int));
+    // the key goes after the keys equal to it, and pid right behind it
+    int i = Traits::upperBound(keys(), num, key);
+    memmove(buffer+Traits::WIDTH*(i+1),buffer+Traits::WIDTH*i,Traits::WIDTH*(num-i));
+    memmove(pidPtr(i+2),pidPtr(i+1),sizeof(PageId)*(num-i));
+    Traits::write(buffer+Traits::WIDTH*i,key);
+    memcpy(pidPtr(i+1),&pid,sizeof(PageId));
+
+    setKeyCount(num+1);
     return 0;
 }
 
@@ -290,37 +876,39 @@ RC BTNonLeafNode::insert(int key, PageId pid)
  * @param midKey[OUT] the key in the middle after the split. This key should be inserted to the parent node.
  * @return 0 if successful. Return an error code if there is an error.
  */
-RC BTNonLeafNode::insertAndSplit(int key, PageId pid, BTNonLeafNode& sibling, int& midKey)
+template<typename Key>
+RC BasicBTNonLeafNode<Key>::insertAndSplit(const Key& key, PageId pid, BasicBTNonLeafNode& sibling, Key& midKey)
 {
+    convert();
+    sibling.convert();
     int num;
     num = getKeyCount();
     RC rc=-1;
     if(num < nonleaftotal)
         return rc;
-    char tempNode[PageFile::PAGE_SIZE+sizeof(int)+sizeof(PageId)];
-    memcpy(tempNode,buffer,PageFile::PAGE_SIZE);
-    int i;
-    for(i = 0; i < num; i++)
-    {
-        int cur_key;
-        memcpy(&cur_key,tempNode+sizeof(int)+sizeof(PageId)+(sizeof(int)+sizeof(PageId))*i,sizeof(int));
-        if(cur_key > key)
-            break;
-    }
-    memmove(tempNode+sizeof(int)+sizeof(PageId)+(sizeof(int)+sizeof(PageId))*(i+1),buffer+sizeof(int)+sizeof(PageId)+(sizeof(PageId)+sizeof(int))*i,(sizeof(int)+sizeof(PageId))*(num-i));
-    memcpy(tempNode+sizeof(int)+sizeof(PageId)+(sizeof(int)+sizeof(PageId))*i,&key,sizeof(int));
-    memcpy(tempNode+sizeof(int)+sizeof(PageId)+(sizeof(int)+sizeof(PageId))*i+sizeof(int),&pid,sizeof(PageId));
-    
+    // the keys and the pointers with the new pair in place
+    char tempKeys[PageFile::MAX_PAGE_SIZE+sizeof(Key)];
+    PageId tempPids[PageFile::MAX_PAGE_SIZE/sizeof(PageId)];
+    int i = Traits::upperBound(keys(), num, key);
+    memcpy(tempKeys,buffer,Traits::WIDTH*i);
+    memcpy(tempPids,pidPtr(0),sizeof(PageId)*(i+1));
+    Traits::write(tempKeys+Traits::WIDTH*i,key);
+    tempPids[i+1] = pid;
+    memcpy(tempKeys+Traits::WIDTH*(i+1),buffer+Traits::WIDTH*i,Traits::WIDTH*(num-i));
+    memcpy(tempPids+i+2,pidPtr(i+1),sizeof(PageId)*(num-i));
+
     num += 1;
     int num_left = num/2;
     int num_right = num -num_left-1;
-    memset(buffer,0,PageFile::PAGE_SIZE);
-    memcpy(buffer,&num_left,sizeof(int));
-    memcpy(buffer+sizeof(int),tempNode+sizeof(int),sizeof(PageId)+(sizeof(int)+sizeof(PageId))*num_left);
-    
-    memcpy(&midKey,tempNode+sizeof(int)+sizeof(PageId)+(sizeof(int)+sizeof(PageId))*num_left,sizeof(int));
-    memcpy(sibling.buffer,&num_right,sizeof(int));
-    memcpy(sibling.buffer+sizeof(int),tempNode+sizeof(int)+sizeof(PageId)+(sizeof(int)+sizeof(PageId))*num_left+sizeof(int),sizeof(PageId)+(sizeof(int)+sizeof(PageId))*num_right);
+    clear();
+    memcpy(buffer,tempKeys,Traits::WIDTH*num_left);
+    memcpy(pidPtr(0),tempPids,sizeof(PageId)*(num_left+1));
+    setKeyCount(num_left);
+
+    midKey = Traits::read(tempKeys+Traits::WIDTH*num_left);
+    memcpy(sibling.buffer,tempKeys+Traits::WIDTH*(num_left+1),Traits::WIDTH*num_right);
+    memcpy(sibling.pidPtr(0),tempPids+num_left+1,sizeof(PageId)*(num_right+1));
+    sibling.setKeyCount(num_right);
     return 0;
 }
 
@@ -329,30 +917,40 @@ RC BTNonLeafNode::insertAndSplit(int key, PageId pid, BTNonLeafNode& sibling, in
  * output it in pid.
  * @param searchKey[IN] the searchKey that is being looked up.
  * @param pid[OUT] the pointer to the child node to follow.
+ * @param first[IN] true for the leftmost child that may hold searchKey
  * @return 0 if successful. Return an error code if there is an error.
  */
-RC BTNonLeafNode::locateChildPtr(int searchKey, PageId& pid)
+template<typename Key>
+RC BasicBTNonLeafNode<Key>::locateChildPtr(const Key& searchKey, PageId& pid, bool first)
 {
     int num;
     num = getKeyCount();
     RC rc=-1;
     if(num < 1)
         return rc;
-    for( int i = 0; i< num ; i++)
+    if (isLegacy())
     {
-        int cur_key;
-        memcpy(&cur_key,buffer+sizeof(int)+sizeof(PageId)+(sizeof(int)+sizeof(PageId))*i,sizeof(int));
-        if(cur_key>searchKey)
-        {
-            memcpy(&pid,buffer+sizeof(int)+(sizeof(PageId)+sizeof(int))*i,sizeof(PageId));
-            break;
-        }
-        else if(i == num-1)
+        for( int i = 0; i< num ; i++)
         {
-            memcpy(&pid,buffer+sizeof(int)+(sizeof(PageId)+sizeof(int))*num,sizeof(PageId));
-                    
+            Key cur_key = Traits::read(buffer+sizeof(int)+sizeof(PageId)+(Traits::WIDTH+sizeof(PageId))*i);
+            int c = Traits::compare(cur_key, searchKey);
+            if(c > 0 || (first && c == 0))
+            {
+                memcpy(&pid,buffer+sizeof(int)+(sizeof(PageId)+Traits::WIDTH)*i,sizeof(PageId));
+                break;
+            }
+            else if(i == num-1)
+            {
+                memcpy(&pid,buffer+sizeof(int)+(sizeof(PageId)+Traits::WIDTH)*num,sizeof(PageId));
+
+            }
         }
+        return 0;
     }
+    // the child left of the first key larger than searchKey, or of the
+    // first key not smaller than it
+    int i = first ? Traits::lowerBound(keys(), num, searchKey) : Traits::upperBound(keys(), num, searchKey);
+    memcpy(&pid,pidPtr(i),sizeof(PageId));
     return 0;
 }
 
@@ -363,32 +961,41 @@ RC BTNonLeafNode::locateChildPtr(int searchKey, PageId& pid)
  * @param pid2[IN] the PageId to insert behind the key
  * @return 0 if successful. Return an error code if there is an error.
  */
-RC BTNonLeafNode::initializeRoot(PageId pid1, int key, PageId pid2)
+template<typename Key>
+RC BasicBTNonLeafNode<Key>::initializeRoot(PageId pid1, const Key& key, PageId pid2)
 {
     int count;
     RC rc=-1;
+    convert();
     count = getKeyCount();
     if(count != 0)
         return rc;
-    count = 1;
-    memcpy(buffer,&count,sizeof(int));
-    memcpy(buffer+sizeof(int),&pid1,sizeof(PageId));
-    memcpy(buffer+sizeof(int)+sizeof(PageId),&key,sizeof(PageId));
-    memcpy(buffer+sizeof(int)+sizeof(PageId)+sizeof(int),&pid2,sizeof(PageId));
-    int flag = 1;
-    memcpy(buffer+PageFile::PAGE_SIZE-sizeof(PageId)-sizeof(int), &flag, sizeof(int));
+    Traits::write(buffer,key);
+    memcpy(pidPtr(0),&pid1,sizeof(PageId));
+    memcpy(pidPtr(1),&pid2,sizeof(PageId));
+    setKeyCount(1);
     return 0;
 }
 
 
-RC BTNonLeafNode::readentry(int eid, int& key, PageId& pid)
+template<typename Key>
+RC BasicBTNonLeafNode<Key>::readentry(int eid, Key& key, PageId& pid)
 {
-    memcpy(&key, buffer+sizeof(int)+sizeof(PageId)+(sizeof(int)+sizeof(PageId))*(eid-1), sizeof(int));
-    memcpy(&pid, buffer+sizeof(int)+sizeof(PageId)+(sizeof(int)+sizeof(PageId))*(eid-1)+sizeof(int), sizeof(PageId));
+    if (isLegacy())
+    {
+        key = Traits::read(buffer+sizeof(int)+sizeof(PageId)+(Traits::WIDTH+sizeof(PageId))*(eid-1));
+        memcpy(&pid, buffer+sizeof(int)+sizeof(PageId)+(Traits::WIDTH+sizeof(PageId))*(eid-1)+Traits::WIDTH, sizeof(PageId));
+        return 0;
+    }
+    key = Traits::read(buffer+Traits::WIDTH*(eid-1));
+    memcpy(&pid, pidPtr(eid), sizeof(PageId));
     return 0;
 }
 
-
-
-
-
+// the key types of the indexes (see BTreeKey.h)
+template class BasicBTLeafNode<int>;
+template class BasicBTLeafNode<int64_t>;
+template class BasicBTLeafNode<ValueKey>;
+template class BasicBTNonLeafNode<int>;
+template class BasicBTNonLeafNode<int64_t>;
+template class BasicBTNonLeafNode<ValueKey>;
@@ -12,12 +12,51 @@
 
 #include "RecordFile.h"
 #include "PageFile.h"
+#include "BTreeKey.h"
+#include <cstdlib>
 #include <cstring>
+#include <vector>
+#include <memory>
 
 /**
- * BTLeafNode: The class representing a B+tree leaf node.
+ * The layout of a node page.
+ * The keys of a node are kept in an array of their own at the start of the
+ * page, so that a search reads them contiguously (see KeySearch). The
+ * RecordIds of a leaf, or the child pointers of a non-leaf node, follow
+ * the keys. The key count, the node flag and the next node pointer sit at
+ * the end of the page.
+ * Nodes written before this layout have flag 0 (leaf) or 1 (non-leaf).
+ * They start with the key count, followed by (RecordId, key) or
+ * (key, PageId) pairs. They are searched as they are, and converted to
+ * the new layout when they are read for an update.
+ * Each key takes KeyTraits<Key>::WIDTH bytes in the key array.
+ * A leaf of an index with packed leaves (see BTLeafNode::setPacking())
+ * may be stored packed instead, with flag 4: after a header with the
+ * smallest key, pid and sid of the node and the # bits each needs, the
+ * keys, the pids and the sids follow as three bit-packed arrays of their
+ * differences from the smallest one (frame of reference). The trailer is
+ * the same as in the current layout.
  */
-class BTLeafNode {
+const int LEGACY_LEAF_FLAG = 0;
+const int LEGACY_NONLEAF_FLAG = 1;
+const int LEAF_FLAG = 2;
+const int NONLEAF_FLAG = 3;
+const int PACKED_LEAF_FLAG = 4;
+
+/**
+ * Frees the buffer a node owns. It is allocated aligned like a cache
+ * frame, so that the keys start on a cache line.
+ */
+struct NodeBufferDeleter {
+  void operator()(char* p) const { free(p); }
+};
+
+/**
+ * BasicBTLeafNode: The class representing a B+tree leaf node, with keys
+ * of type Key (see KeyTraits in BTreeKey.h).
+ */
+template<typename Key>
+class BasicBTLeafNode {
   public:
    /**
     * Insert the (key, rid) pair to the node.
@@ -26,7 +65,7 @@ class BTLeafNode {
     * @param rid[IN] the RecordId to insert
     * @return 0 if successful. Return an error code if the node is full.
     */
-    RC insert(int key, const RecordId& rid);
+    RC insert(const Key& key, const RecordId& rid);
 
    /**
     * Insert the (key, rid) pair to the node
@@ -39,7 +78,7 @@ class BTLeafNode {
     * @param siblingKey[OUT] the first key in the sibling node after split.
     * @return 0 if successful. Return an error code if there is an error.
     */
-    RC insertAndSplit(int key, const RecordId& rid, BTLeafNode& sibling, int& siblingKey);
+    RC insertAndSplit(const Key& key, const RecordId& rid, BasicBTLeafNode& sibling, Key& siblingKey);
 
    /**
     * If searchKey exists in the node, set eid to the index entry
@@ -52,7 +91,7 @@ class BTLeafNode {
                       behind the largest key smaller than searchKey.
     * @return 0 if searchKey is found. If not, RC_NO_SEARCH_RECORD.
     */
-    RC locate(int searchKey, int& eid);
+    RC locate(const Key& searchKey, int& eid);
 
    /**
     * Read the (key, rid) pair from the eid entry.
@@ -61,7 +100,7 @@ class BTLeafNode {
     * @param rid[OUT] the RecordId from the slot
     * @return 0 if successful. Return an error code if there is an error.
     */
-    RC readEntry(int eid, int& key, RecordId& rid);
+    RC readEntry(int eid, Key& key, RecordId& rid);
 
    /**
     * Return the pid of the next slibling node.
@@ -98,26 +137,190 @@ class BTLeafNode {
     * @return 0 if successful. Return an error code if there is an error.
     */
     RC write(PageId pid, PageFile& pf);
+
+   /**
+    * Prepare the content of the node for the page pid in the PageFile pf
+    * and add it to batch, to be written with the other pages of batch
+    * by PageFile::writev(). The node must stay alive until then.
+    * @param pid[IN] the PageId to write to
+    * @param pf[IN] PageFile to write to
+    * @param batch[IN/OUT] the pages to write together
+    * @return 0 if successful. Return an error code if there is an error.
+    */
+    RC write(PageId pid, PageFile& pf, std::vector<PageIO>& batch);
     
-    BTLeafNode(){memset(buffer,0,PageFile::PAGE_SIZE);}
-    
-    static const int leaftotal = ((PageFile::PAGE_SIZE-sizeof(int)-sizeof(PageId))/(sizeof(RecordId)+sizeof(int)))-1;
+   /**
+    * Construct an empty node for a file with the given page size.
+    * @param size[IN] the page size of the index file
+    */
+    explicit BasicBTLeafNode(int size = PageFile::DEFAULT_PAGE_SIZE){setPageSize(size); buffer = ownPage(); clear();}
+
+   /**
+    * Construct the node as a view over a page pinned with PageFile::pin().
+    * The node works on the cached frame directly, without copying it,
+    * and must not be used after the page is unpinned. It holds only a
+    * pointer to the frame, and allocates no buffer of its own.
+    * @param frame[IN] the pinned page
+    * @param size[IN] the page size of the index file
+    */
+    explicit BasicBTLeafNode(const char* frame, int size = PageFile::DEFAULT_PAGE_SIZE){buffer = const_cast<char*>(frame); setPageSize(size);}
+
+   /**
+    * Construct the node as a view over a page pinned with
+    * PageFile::pinMutable(). Changes to the node go to the cached frame.
+    * @param frame[IN] the pinned page
+    * @param size[IN] the page size of the index file
+    */
+    explicit BasicBTLeafNode(char* frame, int size = PageFile::DEFAULT_PAGE_SIZE){buffer = frame; setPageSize(size);}
+
+   /**
+    * Tell whether a node page holds a leaf node, in either layout.
+    * @param page[IN] the node page
+    * @param size[IN] the page size of the index file
+    * @return true if the page is a leaf node
+    */
+    static bool isLeaf(const char* page, int size);
+
+   /**
+    * Let the node hold up to about twice the entries of a page, and
+    * write it packed when it does not fit in the page otherwise.
+    * A packed node is full when its entries no longer fit in the page,
+    * or when there are twice as many as fit unpacked, less two; either
+    * half of a split then fits unpacked. Call this on a node read with
+    * read() or constructed empty, before changing it. Only int keys are
+    * packed (KeyTraits::PACKABLE); for other keys this does nothing.
+    * @param on[IN] true to pack the node
+    */
+    void setPacking(bool on);
+
+   /**
+    * The maximum # keys in the node. It follows from the page size.
+    */
+    int leaftotal;
     //static const int leaftotal = 72;
   private:
+    typedef KeyTraits<Key> Traits;
+
+    BasicBTLeafNode(const BasicBTLeafNode&);
+    BasicBTLeafNode& operator=(const BasicBTLeafNode&);
+
+    void setPageSize(int size);
+
    /**
-    * The main memory buffer for loading the content of the disk page 
-    * that contains the node.
+    * Return true if the node is a view over a packed page.
+    */
+    bool isPacked() const;
+
+   /**
+    * Return # bytes the node takes packed.
+    */
+    int packedSize() const;
+
+   /**
+    * Pack the node into the image, or lay it out unpacked there if it
+    * does not fit packed. This and the packed paths below are defined
+    * for int keys only.
+    */
+    void pack();
+
+   /**
+    * Unpack the packed page in the image into the node.
+    */
+    RC unpack();
+
+   /**
+    * Write the packed header and the packed arrays of the node to the
+    * image.
+    */
+    void packEntries();
+
+   /**
+    * locate() and readEntry() on a view over a packed page.
+    */
+    RC locatePacked(const Key& searchKey, int& eid);
+    RC readPacked(int eid, Key& key, RecordId& rid);
+
+   /**
+    * Return the page to write for the node: the buffer, or the image of
+    * a packed node.
+    */
+    char* output();
+
+   /**
+    * Return the image, allocated on first use.
+    */
+    char* packImage();
+
+   /**
+    * Make the node empty, in the current layout.
+    */
+    void clear();
+
+   /**
+    * Convert a node in the old layout to the current one, in place.
+    */
+    void convert();
+
+   /**
+    * Return true if the node is in the old layout.
+    */
+    bool isLegacy() const;
+
+    const char* keys() const { return buffer; }
+    char* ridPtr(int i) const { return buffer + Traits::WIDTH*leaftotal + sizeof(RecordId)*i; }
+    void setKeyCount(int count);
+
+   /**
+    * The size of the node page in bytes.
+    */
+    int pageSize;
+
+   /**
+    * The size of the node in memory: pageSize, or twice as much for a
+    * packed node. The trailer sits at its end.
+    */
+    int nodeSize;
+
+   /**
+    * The buffer the node owns, for a node constructed empty or read with
+    * read(). A view over a pinned frame has none.
     */
-    char buffer[PageFile::PAGE_SIZE];
+    std::unique_ptr<char[], NodeBufferDeleter> page;
+
+   /**
+    * The size of page in bytes: twice the page size, so that the node
+    * can be packed.
+    */
+    int pageBytes = 0;
+
+   /**
+    * Return the buffer the node owns, allocated on first use, by the
+    * page size.
+    */
+    char* ownPage();
+
+   /**
+    * The image: the page of a packed node, as read or to be written.
+    * Only a node that is packed allocates it, as large as a page.
+    */
+    std::unique_ptr<char[]> image;
+    int imageBytes = 0;
+
+   /**
+    * The content of the node: either page or a pinned cache frame.
+    */
+    char* buffer;
    // PageId current_pid;
     //PageId next_pid;
 }; 
 
 
 /**
- * BTNonLeafNode: The class representing a B+tree nonleaf node.
+ * BasicBTNonLeafNode: The class representing a B+tree nonleaf node, with
+ * keys of type Key.
  */
-class BTNonLeafNode {
+template<typename Key>
+class BasicBTNonLeafNode {
   public:
    /**
     * Insert a (key, pid) pair to the node.
@@ -126,7 +329,7 @@ class BTNonLeafNode {
     * @param pid[IN] the PageId to insert
     * @return 0 if successful. Return an error code if the node is full.
     */
-    RC insert(int key, PageId pid);
+    RC insert(const Key& key, PageId pid);
 
    /**
     * Insert the (key, pid) pair to the node
@@ -140,7 +343,7 @@ class BTNonLeafNode {
     * @param midKey[OUT] the key in the middle after the split. This key should be inserted to the parent node.
     * @return 0 if successful. Return an error code if there is an error.
     */
-    RC insertAndSplit(int key, PageId pid, BTNonLeafNode& sibling, int& midKey);
+    RC insertAndSplit(const Key& key, PageId pid, BasicBTNonLeafNode& sibling, Key& midKey);
 
    /**
     * Given the searchKey, find the child-node pointer to follow and
@@ -148,9 +351,12 @@ class BTNonLeafNode {
     * Remember that the keys inside a B+tree node are sorted.
     * @param searchKey[IN] the searchKey that is being looked up.
     * @param pid[OUT] the pointer to the child node to follow.
+    * @param first[IN] true for the leftmost child that may hold
+    *                  searchKey: the entries equal to a key of the node
+    *                  may sit on both sides of it
     * @return 0 if successful. Return an error code if there is an error.
     */
-    RC locateChildPtr(int searchKey, PageId& pid);
+    RC locateChildPtr(const Key& searchKey, PageId& pid, bool first = false);
 
    /**
     * Initialize the root node with (pid1, key, pid2).
@@ -159,7 +365,7 @@ class BTNonLeafNode {
     * @param pid2[IN] the PageId to insert behind the key
     * @return 0 if successful. Return an error code if there is an error.
     */
-    RC initializeRoot(PageId pid1, int key, PageId pid2);
+    RC initializeRoot(PageId pid1, const Key& key, PageId pid2);
 
    /**
     * Return the number of keys stored in the node.
@@ -183,24 +389,115 @@ class BTNonLeafNode {
     */
     RC write(PageId pid, PageFile& pf);
 
+   /**
+    * Prepare the content of the node for the page pid in the PageFile pf
+    * and add it to batch, to be written with the other pages of batch
+    * by PageFile::writev(). The node must stay alive until then.
+    * @param pid[IN] the PageId to write to
+    * @param pf[IN] PageFile to write to
+    * @param batch[IN/OUT] the pages to write together
+    * @return 0 if successful. Return an error code if there is an error.
+    */
+    RC write(PageId pid, PageFile& pf, std::vector<PageIO>& batch);
+
     //static const int nonleaftotal = 72;
-    BTNonLeafNode(){memset(buffer,0,PageFile::PAGE_SIZE);}
 
-    static const int nonleaftotal = ((PageFile::PAGE_SIZE-sizeof(int)-sizeof(PageId))/(sizeof(RecordId)+sizeof(int)))-1;
+   /**
+    * Construct an empty node for a file with the given page size.
+    * @param size[IN] the page size of the index file
+    */
+    explicit BasicBTNonLeafNode(int size = PageFile::DEFAULT_PAGE_SIZE){setPageSize(size); buffer = ownPage(); clear();}
+
+   /**
+    * Construct the node as a view over a page pinned with PageFile::pin().
+    * The node works on the cached frame directly, without copying it,
+    * and must not be used after the page is unpinned. It holds only a
+    * pointer to the frame, and allocates no buffer of its own.
+    * @param frame[IN] the pinned page
+    * @param size[IN] the page size of the index file
+    */
+    explicit BasicBTNonLeafNode(const char* frame, int size = PageFile::DEFAULT_PAGE_SIZE){buffer = const_cast<char*>(frame); setPageSize(size);}
+
+   /**
+    * Construct the node as a view over a page pinned with
+    * PageFile::pinMutable(). Changes to the node go to the cached frame.
+    * @param frame[IN] the pinned page
+    * @param size[IN] the page size of the index file
+    */
+    explicit BasicBTNonLeafNode(char* frame, int size = PageFile::DEFAULT_PAGE_SIZE){buffer = frame; setPageSize(size);}
+
+   /**
+    * The maximum # keys in the node. It follows from the page size.
+    */
+    int nonleaftotal;
     
-    RC readentry(int eid, int& key, PageId& pid);
+    RC readentry(int eid, Key& key, PageId& pid);
     
-    char buffer[PageFile::PAGE_SIZE];
+    char* buffer;
 
     
   private:
+    typedef KeyTraits<Key> Traits;
+
+    BasicBTNonLeafNode(const BasicBTNonLeafNode&);
+    BasicBTNonLeafNode& operator=(const BasicBTNonLeafNode&);
+
+    void setPageSize(int size);
+
+   /**
+    * Make the node empty, in the current layout.
+    */
+    void clear();
+
+   /**
+    * Convert a node in the old layout to the current one, in place.
+    */
+    void convert();
+
+   /**
+    * Return true if the node is in the old layout.
+    */
+    bool isLegacy() const;
+
+    const char* keys() const { return buffer; }
+    char* pidPtr(int i) const { return buffer + Traits::WIDTH*nonleaftotal + sizeof(PageId)*i; }
+    void setKeyCount(int count);
+
+   /**
+    * The size of the node page in bytes.
+    */
+    int pageSize;
+
+   /**
+    * The buffer the node owns, for a node constructed empty or read with
+    * read(). A view over a pinned frame has none.
+    */
+    std::unique_ptr<char[], NodeBufferDeleter> page;
+
+   /**
+    * The size of page in bytes.
+    */
+    int pageBytes = 0;
+
+   /**
+    * Return the buffer the node owns, allocated on first use, by the
+    * page size.
+    */
+    char* ownPage();
+
    /**
     * The main memory buffer for loading the content of the disk page 
     * that contains the node.
     */
-    //char buffer[PageFile::PAGE_SIZE];
+    //char buffer[PageFile::MAX_PAGE_SIZE];
     
     
 }; 
 
+/**
+ * The nodes of an index on the key column.
+ */
+typedef BasicBTLeafNode<int> BTLeafNode;
+typedef BasicBTNonLeafNode<int> BTNonLeafNode;
+
 #endif /* BTREENODE_H */
@@ -0,0 +1,550 @@
+/**
+ * Copyright (C) 2008 by The Regents of the University of California
+ * Redistribution of this file is permitted under the terms of the GNU
+ * Public License (GPL).
+ */
+
+#include "Bruinbase.h"
+#include "BufferPool.h"
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+using std::mutex;
+using std::unique_lock;
+
+BufferPool::BufferPool()
+{
+  frameCount = 0;
+  publishedCount = 0;
+  frames = NULL;
+  bucketMask = 0;
+  buckets = NULL;
+  for (int l = 0; l < LIST_COUNT; l++) {
+    lists[l].head = lists[l].tail = -1;
+    lists[l].size = 0;
+  }
+  a1inLimit = ringLimit = ghostLimit = 0;
+  ghostClock = 0;
+  writingFrames = 0;
+}
+
+BufferPool::~BufferPool()
+{
+  freeFrames();
+  delete [] buckets;
+}
+
+RC BufferPool::setFrameCount(int count)
+{
+  RC rc;
+
+  if (count <= 0) return RC_INVALID_CACHE_SIZE;
+
+  unique_lock<mutex> guard(lock);
+
+  // dirty pages must reach the disk before their frames go away. the
+  // lock is released while they are written, so look again after each file
+  for (int i = 0; i < frameCount; ) {
+    if (frames[i].dirty) {
+      if ((rc = flushLocked(frames[i].fd, guard)) < 0) return rc;
+      i = 0;
+    } else {
+      i++;
+    }
+  }
+
+  freeFrames();
+  delete [] buckets;
+
+  frameCount = count;
+  init();
+  return 0;
+}
+
+int BufferPool::getFrameCount()
+{
+  int count = publishedCount.load(std::memory_order_relaxed);
+  if (count > 0) return count;
+
+  unique_lock<mutex> guard(lock);
+
+  if (frameCount == 0) init();
+  return frameCount;
+}
+
+void BufferPool::init()
+{
+  // when the pool size was not set explicitly, take it from the environment
+  if (frameCount <= 0) {
+    const char* env = getenv("BRUINBASE_CACHE_PAGES");
+    frameCount = (env != NULL) ? atoi(env) : 0;
+    if (frameCount <= 0) frameCount = DEFAULT_FRAME_COUNT;
+  }
+
+  // use at least twice as many hash buckets as frames
+  int bucketCount = 1;
+  while (bucketCount < 2 * frameCount) bucketCount <<= 1;
+  bucketMask = bucketCount - 1;
+  buckets = new int[bucketCount];
+  for (int i = 0; i < bucketCount; i++) buckets[i] = -1;
+
+  // every frame starts empty, on the free list
+  frames = new Frame[frameCount];
+  for (int l = 0; l < LIST_COUNT; l++) {
+    lists[l].head = lists[l].tail = -1;
+    lists[l].size = 0;
+  }
+  ghostQueue.clear();
+  ghostSet.clear();
+  ghostClock = 0;
+  dirtyFrames.clear();
+  writers.clear();
+  for (int i = 0; i < frameCount; i++) {
+    frames[i].fd = -1;
+    frames[i].pid = -1;
+    frames[i].hnext = -1;
+    frames[i].pinCount = 0;
+    frames[i].dirty = false;
+    frames[i].loading = false;
+    frames[i].writing = false;
+    frames[i].owner = NULL;
+    frames[i].buffer = NULL;
+    frames[i].size = 0;
+    frames[i].list = -1;
+    listPushFront(i, FREE_LIST);
+  }
+
+  // 2Q parameters: a quarter of the pool holds pages seen once, and the
+  // ghost list remembers half a pool of pages recently evicted from it
+  publishedCount = frameCount;
+  a1inLimit = std::max(1, frameCount / 4);
+  ghostLimit = std::max(1, frameCount / 2);
+  ringLimit = std::max(1, std::min((int)SCAN_RING_FRAMES, frameCount / 8));
+}
+
+void BufferPool::freeFrames()
+{
+  for (int i = 0; i < frameCount; i++) free(frames[i].buffer);
+  delete [] frames;
+  frames = NULL;
+}
+
+RC BufferPool::reserve(int frame, int size)
+{
+  void* p;
+
+  if (frames[frame].size >= size) return 0;
+  // the buffer is aligned for direct i/o
+  if (posix_memalign(&p, PageFile::DIRECT_ALIGNMENT, size) != 0) return RC_OUT_OF_MEMORY;
+  free(frames[frame].buffer);
+  frames[frame].buffer = (char*) p;
+  frames[frame].size = size;
+  return 0;
+}
+
+int BufferPool::bucketOf(int fd, PageId pid) const
+{
+  unsigned h = (unsigned)pid * 2654435761u ^ (unsigned)fd * 2246822519u;
+  return (int)((h ^ (h >> 15)) & bucketMask);
+}
+
+void BufferPool::hashInsert(int frame)
+{
+  int b = bucketOf(frames[frame].fd, frames[frame].pid);
+  frames[frame].hnext = buckets[b];
+  buckets[b] = frame;
+}
+
+void BufferPool::hashRemove(int frame)
+{
+  int* link = &buckets[bucketOf(frames[frame].fd, frames[frame].pid)];
+  while (*link != -1) {
+    if (*link == frame) {
+      *link = frames[frame].hnext;
+      break;
+    }
+    link = &frames[*link].hnext;
+  }
+  frames[frame].hnext = -1;
+}
+
+void BufferPool::listUnlink(int frame)
+{
+  Frame& f = frames[frame];
+  FrameList& l = lists[f.list];
+  if (f.prev != -1) frames[f.prev].next = f.next; else l.head = f.next;
+  if (f.next != -1) frames[f.next].prev = f.prev; else l.tail = f.prev;
+  f.prev = f.next = -1;
+  f.list = -1;
+  l.size--;
+}
+
+void BufferPool::listPushFront(int frame, int list)
+{
+  Frame& f = frames[frame];
+  FrameList& l = lists[list];
+  f.prev = -1;
+  f.next = l.head;
+  if (l.head != -1) frames[l.head].prev = frame;
+  l.head = frame;
+  if (l.tail == -1) l.tail = frame;
+  f.list = list;
+  l.size++;
+}
+
+static long long ghostKey(int fd, PageId pid)
+{
+  return ((long long)fd << 32) | (unsigned)pid;
+}
+
+void BufferPool::ghostAdd(int fd, PageId pid)
+{
+  long long key = ghostKey(fd, pid);
+
+  // a ghost is identified by its key and the time it was added, so that
+  // a stale queue entry does not drop a newer ghost of the same page
+  ghostSet[key] = ++ghostClock;
+  ghostQueue.push_back(std::make_pair(key, ghostClock));
+
+  // forget the oldest ghosts first
+  while ((int)ghostSet.size() > ghostLimit || ghostQueue.size() > 2 * (size_t)ghostLimit) {
+    std::unordered_map<long long, unsigned long>::iterator it = ghostSet.find(ghostQueue.front().first);
+    if (it != ghostSet.end() && it->second == ghostQueue.front().second) ghostSet.erase(it);
+    ghostQueue.pop_front();
+  }
+}
+
+bool BufferPool::ghostRemove(int fd, PageId pid)
+{
+  // the queue entry stays; it is skipped when it reaches the front
+  return ghostSet.erase(ghostKey(fd, pid)) > 0;
+}
+
+void BufferPool::release(int frame)
+{
+  // unhash the frame and put it on the free list so that it is reused first
+  hashRemove(frame);
+  frames[frame].fd = -1;
+  frames[frame].pid = -1;
+  frames[frame].pinCount = 0;
+  frames[frame].dirty = false;
+  frames[frame].loading = false;
+  frames[frame].writing = false;
+  frames[frame].owner = NULL;
+  listUnlink(frame);
+  listPushFront(frame, FREE_LIST);
+}
+
+int BufferPool::find(int fd, PageId pid) const
+{
+  for (int i = buckets[bucketOf(fd, pid)]; i != -1; i = frames[i].hnext) {
+    if (frames[i].fd == fd && frames[i].pid == pid) return i;
+  }
+  return -1;
+}
+
+int BufferPool::victimFrom(int list) const
+{
+  // the oldest unpinned frame of the list
+  int victim = lists[list].tail;
+  while (victim != -1 && frames[victim].pinCount > 0) victim = frames[victim].prev;
+  return victim;
+}
+
+int BufferPool::chooseVictim(bool scan) const
+{
+  int victim = -1;
+
+  // the frame released last is reused first
+  if (lists[FREE_LIST].size > 0) return lists[FREE_LIST].head;
+
+  // a scan reuses its own ring of frames once the ring is full
+  if (scan && lists[RING_LIST].size >= ringLimit) victim = victimFrom(RING_LIST);
+
+  // 2Q: pages seen once leave before pages seen twice, unless there are
+  // few of them. pages left over from a finished scan go in between
+  if (victim == -1 && lists[A1IN_LIST].size > a1inLimit) victim = victimFrom(A1IN_LIST);
+  if (victim == -1) victim = victimFrom(RING_LIST);
+  if (victim == -1) victim = victimFrom(AM_LIST);
+  if (victim == -1) victim = victimFrom(A1IN_LIST);
+  return victim;
+}
+
+int BufferPool::allocate(int victim, int fd, PageId pid, PageFile* owner)
+{
+  int list;
+  bool scan = (owner != NULL && owner->pattern == PageFile::ACCESS_SEQUENTIAL);
+
+  if (frames[victim].fd != -1) {
+    frames[victim].owner->note(IOStats::EVICTIONS, frames[victim].pid, frames[victim].buffer);
+    if (frames[victim].list == A1IN_LIST) ghostAdd(frames[victim].fd, frames[victim].pid);
+    hashRemove(victim);
+  }
+
+  frames[victim].fd = fd;
+  frames[victim].pid = pid;
+  frames[victim].dirty = false;
+  frames[victim].owner = owner;
+  hashInsert(victim);
+
+  // a page read by a scan goes to the ring. a page evicted not long ago
+  // from A1in has been seen twice and goes straight to Am
+  if (scan) list = RING_LIST;
+  else if (ghostRemove(fd, pid)) list = AM_LIST;
+  else list = A1IN_LIST;
+  listUnlink(victim);
+  listPushFront(victim, list);
+  return victim;
+}
+
+int BufferPool::fetch(int fd, PageId pid, PageFile* owner, bool& load)
+{
+  unique_lock<mutex> guard(lock);
+  bool scan = (owner != NULL && owner->pattern == PageFile::ACCESS_SEQUENTIAL);
+
+  if (frameCount == 0) init();
+
+  for (;;) {
+    int i = find(fd, pid);
+    if (i >= 0) {
+      // the page is being read by another thread. wait for it and look again,
+      // since the read may have failed and dropped the frame
+      if (frames[i].loading) {
+        ready.wait(guard);
+        continue;
+      }
+
+      // Am is kept in LRU order. pages in A1in and in the ring are not moved
+      // on a hit, so that a burst of accesses does not make a page hot
+      if (frames[i].list == AM_LIST && lists[AM_LIST].head != i) {
+        listUnlink(i);
+        listPushFront(i, AM_LIST);
+      }
+      frames[i].pinCount++;
+      load = false;
+      return i;
+    }
+
+    // pinned frames are never chosen. the frames of a write-back are
+    // free again once it is done
+    int victim = chooseVictim(scan);
+    if (victim == -1 && writingFrames > 0) {
+      ready.wait(guard);
+      continue;
+    }
+    if (victim == -1) return RC_CACHE_FULL;
+
+    // a dirty victim is written back along with the other dirty pages of
+    // its file, so that the disk sees one pass in pid order. the lock is
+    // released for the writes, so look for the page again afterwards
+    if (frames[victim].dirty) {
+      RC rc = flushLocked(frames[victim].fd, guard);
+      if (rc < 0) return rc;
+      continue;
+    }
+
+    // the frame may hold a smaller page, or none yet
+    RC rc = reserve(victim, owner != NULL ? owner->getPageSize() : (int)PageFile::MAX_PAGE_SIZE);
+    if (rc < 0) return rc;
+
+    // take the frame and keep other threads off it until the caller fills it
+    i = allocate(victim, fd, pid, owner);
+    frames[i].pinCount = 1;
+    frames[i].loading = true;
+    load = true;
+    return i;
+  }
+}
+
+void BufferPool::loaded(int frame, bool ok)
+{
+  unique_lock<mutex> guard(lock);
+
+  frames[frame].loading = false;
+  if (!ok) release(frame);
+  ready.notify_all();
+}
+
+void BufferPool::unpinFrame(int frame)
+{
+  unique_lock<mutex> guard(lock);
+
+  if (frames[frame].pinCount > 0) frames[frame].pinCount--;
+}
+
+RC BufferPool::unpin(int fd, PageId pid, bool writeThrough)
+{
+  unique_lock<mutex> guard(lock);
+
+  if (frameCount == 0) return RC_INVALID_PID;
+
+  int i = find(fd, pid);
+  if (i < 0 || frames[i].pinCount == 0) return RC_INVALID_PID;
+  frames[i].pinCount--;
+
+  // a page modified through a mutable pin goes to the disk as soon as
+  // its last pin is released. the frame stays pinned while it is written
+  // without the lock, and is dirty again if the write fails
+  if (writeThrough && frames[i].dirty && frames[i].pinCount == 0) {
+    PageFile* owner = frames[i].owner;
+    frames[i].pinCount++;
+    frames[i].writing = true;
+    frames[i].dirty = false;
+    writers[fd]++;
+    writingFrames++;
+
+    guard.unlock();
+    RC rc = owner->writePage(pid, frames[i].buffer);
+    guard.lock();
+
+    frames[i].pinCount--;
+    frames[i].writing = false;
+    if (rc < 0) setDirty(i);
+    writers[fd]--;
+    writingFrames--;
+    ready.notify_all();
+    return rc;
+  }
+  return 0;
+}
+
+void BufferPool::refresh(int fd, PageId pid, const void* buffer)
+{
+  unique_lock<mutex> guard(lock);
+
+  if (frameCount == 0) return;
+
+  int i = find(fd, pid);
+  if (i >= 0 && !frames[i].loading && frames[i].buffer != buffer) {
+    memcpy(frames[i].buffer, buffer, frames[i].owner->getPageSize());
+  }
+}
+
+void BufferPool::markDirty(int frame)
+{
+  unique_lock<mutex> guard(lock);
+
+  setDirty(frame);
+}
+
+void BufferPool::setDirty(int frame)
+{
+  if (!frames[frame].dirty) dirtyFrames[frames[frame].fd].push_back(frame);
+  frames[frame].dirty = true;
+}
+
+RC BufferPool::flushFile(int fd)
+{
+  unique_lock<mutex> guard(lock);
+
+  if (frameCount == 0) return 0;
+  return flushLocked(fd, guard);
+}
+
+RC BufferPool::flushLocked(int fd, unique_lock<mutex>& guard)
+{
+  RC rc = 0;
+  std::vector<int> listed;
+  std::vector<int> dirty;
+  std::vector<bool> held;
+  std::vector<std::pair<PageId, int> > order;
+
+  // the pages another thread is writing back must be on the disk when
+  // this flush returns, and each page is written by one thread at a time
+  while (writers[fd] > 0) ready.wait(guard);
+
+  std::unordered_map<int, std::vector<int> >::iterator it = dirtyFrames.find(fd);
+  if (it == dirtyFrames.end()) return 0;
+  listed.swap(it->second);
+
+  // order the frames that are still dirty pages of the file by pid
+  for (unsigned k = 0; k < listed.size(); k++) {
+    int i = listed[k];
+    if (frames[i].fd == fd && frames[i].dirty) order.push_back(std::make_pair(frames[i].pid, i));
+  }
+  std::sort(order.begin(), order.end());
+  order.erase(std::unique(order.begin(), order.end()), order.end());
+  for (unsigned k = 0; k < order.size(); k++) dirty.push_back(order[k].second);
+  if (dirty.empty()) return 0;
+
+  // pin the frames for the writes, which run without the lock. a page
+  // pinned by its holder may still be modified, and stays dirty. the
+  // others are clean unless they are modified during the write, which
+  // makes them dirty again
+  for (unsigned k = 0; k < dirty.size(); k++) {
+    Frame& f = frames[dirty[k]];
+    held.push_back(f.pinCount > 0);
+    f.pinCount++;
+    f.writing = true;
+    if (!held[k]) f.dirty = false;
+  }
+  writers[fd]++;
+  writingFrames += dirty.size();
+  guard.unlock();
+
+  // the pages with consecutive pids are written with one system call
+  unsigned done = 0;
+  while (done < dirty.size()) {
+    Frame& f = frames[dirty[done]];
+    std::vector<char*> buffers(1, f.buffer);
+    unsigned j = done + 1;
+    while (j < dirty.size() && frames[dirty[j]].owner == f.owner &&
+           frames[dirty[j]].pid == f.pid + (PageId)(j - done)) {
+      buffers.push_back(frames[dirty[j]].buffer);
+      j++;
+    }
+    if ((rc = f.owner->writePages(f.pid, &buffers[0], j - done)) < 0) break;
+    done = j;
+  }
+
+  guard.lock();
+  for (unsigned k = 0; k < dirty.size(); k++) {
+    Frame& f = frames[dirty[k]];
+    f.pinCount--;
+    f.writing = false;
+    // the pages not written are still dirty
+    if (k >= done) f.dirty = true;
+  }
+
+  // the pages that stay dirty are flushed again next time
+  std::vector<int>& relist = dirtyFrames[fd];
+  for (unsigned k = 0; k < dirty.size(); k++) {
+    if (frames[dirty[k]].dirty) relist.push_back(dirty[k]);
+  }
+  writers[fd]--;
+  writingFrames -= dirty.size();
+  ready.notify_all();
+  return rc;
+}
+
+void BufferPool::invalidate(int fd, PageId pid)
+{
+  unique_lock<mutex> guard(lock);
+
+  if (frameCount == 0) return;
+
+  // a frame being written back is dropped once the write is done
+  int i;
+  while ((i = find(fd, pid)) >= 0 && frames[i].writing) ready.wait(guard);
+  if (i >= 0) release(i);
+}
+
+void BufferPool::invalidateFile(int fd)
+{
+  unique_lock<mutex> guard(lock);
+
+  while (writers[fd] > 0) ready.wait(guard);
+  for (int i = 0; i < frameCount; i++) {
+    if (frames[i].fd == fd) release(i);
+  }
+  dirtyFrames.erase(fd);
+  writers.erase(fd);
+
+  // the fd may be reused for another file. forget its ghosts
+  std::unordered_map<long long, unsigned long>::iterator it = ghostSet.begin();
+  while (it != ghostSet.end()) {
+    if ((int)(it->first >> 32) == fd) it = ghostSet.erase(it);
+    else ++it;
+  }
+}
@@ -0,0 +1,234 @@
+/*
+ * Copyright (C) 2008 by The Regents of the University of California
+ * Redistribution of this file is permitted under the terms of the GNU
+ * Public License (GPL).
+ */
+
+#ifndef BUFFERPOOL_H
+#define BUFFERPOOL_H
+
+#include "Bruinbase.h"
+#include "PageFile.h"
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+/**
+ * The page cache shared by every open PageFile in the process.
+ * A frame is identified by (fd, pid) and found through a chained hash
+ * table, so lookup and replacement are O(1) regardless of the pool size.
+ *
+ * Frames are replaced with the 2Q policy, so that a large scan does not
+ * push the hot pages (B+tree roots and interior nodes) out of the pool.
+ * A page seen for the first time enters A1in, a FIFO queue holding about
+ * a quarter of the pool. A page evicted from A1in is remembered on a ghost
+ * list, and if it is read again while remembered, it enters Am, which is
+ * kept in LRU order. Pages of a file advised as sequential (a table scan)
+ * go to a small ring of frames that the scan keeps reusing instead.
+ *
+ * A frame has no buffer until it first takes a page, and then one as
+ * large as the page. The buffer only grows when a larger page takes the
+ * frame, so a pool of files with small pages holds small frames.
+ *
+ * A dirty frame is written back by its
+ * owner PageFile, together with the other dirty pages of the file, when
+ * it is chosen for eviction. A pinned frame is never evicted.
+ *
+ * The pool is safe to use from several threads. Its bookkeeping is guarded
+ * by one mutex; disk reads and writes happen outside the lock, and a thread
+ * asking for a page that another thread is still reading waits for that
+ * read instead of issuing its own. A frame being written back stays pinned
+ * until the write is done, and a flush of a file first waits for the
+ * write-backs of the file already under way.
+ */
+class BufferPool {
+ public:
+  // # frames used when setFrameCount() is not called before the first use
+  static const int DEFAULT_FRAME_COUNT = 4096;
+
+  // the most frames the ring of a sequential scan takes
+  static const int SCAN_RING_FRAMES = 32;
+
+  BufferPool();
+  ~BufferPool();
+
+  /**
+   * set the number of frames in the pool.
+   * this should be called when the process starts, before any page is
+   * cached; calling it later drops every cached page.
+   * if it is never called, the pool is sized from the environment variable
+   * BRUINBASE_CACHE_PAGES or DEFAULT_FRAME_COUNT.
+   * @param count[IN] # frames (pages) the pool can hold
+   * @return error code. 0 if no error
+   */
+  RC setFrameCount(int count);
+
+  /**
+   * @return # frames in the pool. once the pool is set up, this does not
+   *         take the lock
+   */
+  int getFrameCount();
+
+  /**
+   * find the frame caching the page and pin it. if the page is not cached,
+   * a frame is taken for it, evicting an unpinned page, and load is set to true: the caller must then fill the frame and call
+   * loaded(). if another thread is filling the frame, this call waits.
+   * @param fd[IN] file descriptor of the file the page belongs to
+   * @param pid[IN] the page to look for
+   * @param owner[IN] the PageFile that writes the page back when dirty
+   * @param load[OUT] true if the caller has to fill the frame
+   * @return the pinned frame number, or an error code (< 0) if every frame
+   *         is pinned or a dirty page could not be written back
+   */
+  int fetch(int fd, PageId pid, PageFile* owner, bool& load);
+
+  /**
+   * finish filling a frame returned by fetch() with load set.
+   * threads waiting for the page are woken up.
+   * @param frame[IN] the frame number
+   * @param ok[IN] false if the page could not be read. the frame is dropped
+   *               and the caller's pin is released
+   */
+  void loaded(int frame, bool ok);
+
+  /**
+   * release one pin of the frame.
+   * @param frame[IN] the frame number
+   */
+  void unpinFrame(int frame);
+
+  /**
+   * release one pin of the frame caching the page.
+   * if writeThrough is set and the page was modified through the pin,
+   * it is written to the disk when its last pin is released.
+   * @param fd[IN] file descriptor of the file the page belongs to
+   * @param pid[IN] the pinned page
+   * @param writeThrough[IN] true to write a dirty page back immediately
+   * @return error code. 0 if no error
+   */
+  RC unpin(int fd, PageId pid, bool writeThrough);
+
+  /**
+   * mark the frame as modified. it is written back before eviction.
+   * @param frame[IN] the frame number
+   */
+  void markDirty(int frame);
+
+  /**
+   * copy a page that was just written to the disk into its cached frame,
+   * if the page is cached.
+   * @param fd[IN] file descriptor of the file the page belongs to
+   * @param pid[IN] the written page
+   * @param buffer[IN] the new content of the page
+   */
+  void refresh(int fd, PageId pid, const void* buffer);
+
+  /**
+   * write every dirty page of the file back in pid order.
+   * pinned pages are written but stay dirty, as their holder may still
+   * modify them.
+   * @param fd[IN] file descriptor of the file
+   * @return error code. 0 if no error
+   */
+  RC flushFile(int fd);
+
+  /**
+   * drop the page from the pool if it is cached, without writing it back.
+   * @param fd[IN] file descriptor of the file the page belongs to
+   * @param pid[IN] the page to drop
+   */
+  void invalidate(int fd, PageId pid);
+
+  /**
+   * drop every cached page of the file, without writing it back.
+   * @param fd[IN] file descriptor of the file being closed
+   */
+  void invalidateFile(int fd);
+
+  /**
+   * @param frame[IN] the frame number
+   * @return pointer to the page buffer of the frame
+   */
+  char* data(int frame) { return frames[frame].buffer; }
+
+ private:
+  struct Frame {
+    int    fd;       // file descriptor of the cached page. -1 if unused
+    PageId pid;      // page id of the cached page
+    int    hnext;    // next frame in the same hash bucket
+    int    list;     // the replacement list the frame is on
+    int    prev;     // the newer neighbor in the list
+    int    next;     // the older neighbor in the list
+    int    pinCount; // # outstanding pins. the frame is not evicted while > 0
+    bool   dirty;    // true if the page was modified and not written back
+    bool   loading;  // true while the page is being read into the frame
+    bool   writing;  // true while the page is being written back
+    PageFile* owner; // the PageFile that writes the page back
+    char*  buffer;   // the page content, aligned for direct i/o
+    int    size;     // # bytes the buffer holds. 0 until the frame is used
+  };
+
+  //
+  // the following functions must be called with the lock held.
+  // flushLocked() releases it while it writes
+  //
+  void init();
+  int  find(int fd, PageId pid) const;
+  int  allocate(int victim, int fd, PageId pid, PageFile* owner);
+  RC   reserve(int frame, int size);
+  void freeFrames();
+  RC   flushLocked(int fd, std::unique_lock<std::mutex>& guard);
+  int  victimFrom(int list) const;
+  int  chooseVictim(bool scan) const;
+  int  bucketOf(int fd, PageId pid) const;
+  void hashInsert(int frame);
+  void hashRemove(int frame);
+  void listUnlink(int frame);
+  void listPushFront(int frame, int list);
+  void ghostAdd(int fd, PageId pid);
+  bool ghostRemove(int fd, PageId pid);
+  void release(int frame);
+  void setDirty(int frame);
+
+  // the replacement lists. the head of a list is its newest frame
+  enum { FREE_LIST, A1IN_LIST, AM_LIST, RING_LIST, LIST_COUNT };
+  struct FrameList {
+    int head;
+    int tail;
+    int size;
+  };
+
+  std::mutex lock;               // guards everything below but the page content
+  std::condition_variable ready; // signaled when a frame finishes loading
+                                 // or being written back
+
+  int    frameCount;  // # frames. 0 until the pool is initialized
+  std::atomic<int> publishedCount;  // frameCount, read without the lock
+  Frame* frames;      // frame descriptors
+  int    bucketMask;  // (# hash buckets - 1). # buckets is a power of two
+  int*   buckets;     // head frame of each hash chain. -1 if empty
+  FrameList lists[LIST_COUNT];
+
+  int    a1inLimit;   // # frames A1in keeps before it gives up pages
+  int    ringLimit;   // # frames in the ring of a sequential scan
+  int    ghostLimit;  // # pages the ghost list remembers
+
+  // the ghost list: pages recently evicted from A1in, keyed by (fd, pid).
+  // the queue keeps them in eviction order to forget the oldest first
+  std::unordered_map<long long, unsigned long> ghostSet;
+  std::deque<std::pair<long long, unsigned long> > ghostQueue;
+  unsigned long ghostClock;
+
+  // the frames made dirty, by fd, so that a flush need not look at every
+  // frame. a frame written back or reused since may still be listed
+  std::unordered_map<int, std::vector<int> > dirtyFrames;
+
+  // # write-backs under way, by fd. they run without the lock
+  std::unordered_map<int, int> writers;
+  int writingFrames;  // # frames pinned by the write-backs under way
+};
+
+#endif // BUFFERPOOL_H
@@ -0,0 +1,112 @@
+/**
+ * Copyright (C) 2008 by The Regents of the University of California
+ * Redistribution of this file is permitted under the terms of the GNU
+ * Public License (GPL).
+ */
+
+#include "IOStats.h"
+#include <ctime>
+
+using std::map;
+using std::mutex;
+using std::string;
+using std::unique_lock;
+
+std::mutex IOStats::registryLock;
+std::map<std::string, IOStats*> IOStats::registry;
+
+static const char* roleNames[ROLE_COUNT] = { "header", "leaf", "interior", "heap" };
+static const char* opNames[IOStats::OP_COUNT] = { "disk read", "disk write", "page decode" };
+
+IOStats::IOStats()
+{
+  reset();
+}
+
+IOStats* IOStats::forFile(const string& filename)
+{
+  unique_lock<mutex> guard(registryLock);
+
+  IOStats*& stats = registry[filename];
+  if (stats == NULL) stats = new IOStats();
+  return stats;
+}
+
+void IOStats::dump(FILE* out)
+{
+  unique_lock<mutex> guard(registryLock);
+
+  for (map<string, IOStats*>::const_iterator it = registry.begin(); it != registry.end(); ++it) {
+    it->second->print(out, it->first);
+  }
+}
+
+void IOStats::resetAll()
+{
+  unique_lock<mutex> guard(registryLock);
+
+  for (map<string, IOStats*>::iterator it = registry.begin(); it != registry.end(); ++it) {
+    it->second->reset();
+  }
+}
+
+long long IOStats::now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long) ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+void IOStats::latency(Op op, long long start)
+{
+  long long ns = now() - start;
+  int bucket = 0;
+
+  while (bucket < HISTOGRAM_BUCKETS - 1 && ns >= (2LL << bucket)) bucket++;
+  histogram[op][bucket]++;
+}
+
+void IOStats::reset()
+{
+  for (int r = 0; r < ROLE_COUNT; r++) {
+    for (int c = 0; c < COUNTER_COUNT; c++) counters[r][c] = 0;
+  }
+  for (int o = 0; o < OP_COUNT; o++) {
+    for (int b = 0; b < HISTOGRAM_BUCKETS; b++) histogram[o][b] = 0;
+    pageBytes[o] = storedBytes[o] = 0;
+  }
+}
+
+void IOStats::print(FILE* out, const string& filename) const
+{
+  fprintf(out, "%s\n", filename.c_str());
+  fprintf(out, "  %-9s %10s %10s %10s %10s %10s %10s %10s\n", "role",
+          "reads", "writes", "hits", "misses", "evictions", "diskreads", "diskwrites");
+  for (int r = 0; r < ROLE_COUNT; r++) {
+    fprintf(out, "  %-9s", roleNames[r]);
+    for (int c = 0; c < COUNTER_COUNT; c++) fprintf(out, " %10lld", get((PageRole) r, (Counter) c));
+    fprintf(out, "\n");
+  }
+
+  // the compression ratio of a compressed file
+  for (int o = OP_READ; o <= OP_WRITE; o++) {
+    long long stored = getStoredBytes((Op) o);
+    if (stored == 0) continue;
+    fprintf(out, "  compressed %s: %lld bytes of pages in %lld bytes (ratio %.2f)\n",
+            (o == OP_READ) ? "reads" : "writes", getPageBytes((Op) o), stored,
+            (double) getPageBytes((Op) o) / stored);
+  }
+
+  // print only the buckets that are in use
+  for (int o = 0; o < OP_COUNT; o++) {
+    bool any = false;
+    for (int b = 0; b < HISTOGRAM_BUCKETS; b++) {
+      long long n = getLatency((Op) o, b);
+      if (n == 0) continue;
+      if (!any) fprintf(out, "  %s latency (ns)\n", opNames[o]);
+      any = true;
+      if (b == HISTOGRAM_BUCKETS - 1) fprintf(out, "    >= %-12lld %10lld\n", 1LL << b, n);
+      else fprintf(out, "    < %-13lld %10lld\n", 2LL << b, n);
+    }
+  }
+}
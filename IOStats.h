@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2008 by The Regents of the University of California
+ * Redistribution of this file is permitted under the terms of the GNU
+ * Public License (GPL).
+ */
+
+#ifndef IOSTATS_H
+#define IOSTATS_H
+
+#include <cstdio>
+#include <string>
+#include <map>
+#include <mutex>
+#include <atomic>
+
+/**
+ * What a page holds. The i/o counters of a file are kept separately
+ * for each role.
+ */
+enum PageRole {
+  ROLE_HEADER,    // the header page of a file, or of an index
+  ROLE_LEAF,      // a leaf node of a B+tree
+  ROLE_INTERIOR,  // a non-leaf node of a B+tree
+  ROLE_HEAP,      // a page of records, or any other page
+  ROLE_COUNT
+};
+
+/**
+ * The i/o statistics of one file.
+ * The statistics are kept by file name and live as long as the process,
+ * so that they add up over every time the file is opened.
+ * All counters are atomic; they may be updated by several threads.
+ */
+class IOStats {
+ public:
+  // the events counted for each page role
+  enum Counter {
+    READS,        // page reads asked for
+    WRITES,       // page writes asked for
+    HITS,         // reads served from the page cache
+    MISSES,       // reads that had to go to the disk
+    EVICTIONS,    // pages dropped from the page cache
+    DISK_READS,   // pages read from the disk, read ahead included
+    DISK_WRITES,  // pages written to the disk
+    COUNTER_COUNT
+  };
+
+  // the kinds of i/o timed. OP_DECODE is the decompression of a page
+  // read from a compressed file
+  enum Op { OP_READ, OP_WRITE, OP_DECODE, OP_COUNT };
+
+  // bucket i of a histogram counts the calls that took [2^i, 2^(i+1))
+  // nanoseconds. the last bucket also takes every longer call
+  static const int HISTOGRAM_BUCKETS = 32;
+
+  /**
+   * find the statistics of a file, and create them the first time.
+   * @param filename[IN] the name of the file
+   * @return the statistics of the file. they are never freed
+   */
+  static IOStats* forFile(const std::string& filename);
+
+  /**
+   * print the statistics of every file seen so far.
+   * @param out[IN] where to print them
+   */
+  static void dump(FILE* out);
+
+  /**
+   * set the statistics of every file to zero.
+   */
+  static void resetAll();
+
+  /**
+   * @return the current time in nanoseconds, to time an i/o with latency()
+   */
+  static long long now();
+
+  void count(PageRole role, Counter c, long long n = 1) { counters[role][c] += n; }
+
+  /**
+   * add a disk i/o to the latency histogram.
+   * @param op[IN] the kind of i/o
+   * @param start[IN] the time the i/o started, from now()
+   */
+  void latency(Op op, long long start);
+
+  /**
+   * count the bytes of compressed pages read from or written to the disk.
+   * @param op[IN] OP_READ or OP_WRITE
+   * @param pages[IN] # bytes of the pages
+   * @param stored[IN] # bytes on the disk for them
+   */
+  void compression(Op op, long long pages, long long stored) {
+    pageBytes[op] += pages;
+    storedBytes[op] += stored;
+  }
+
+  long long get(PageRole role, Counter c) const { return counters[role][c].load(); }
+  long long getLatency(Op op, int bucket) const { return histogram[op][bucket].load(); }
+  long long getPageBytes(Op op) const { return pageBytes[op].load(); }
+  long long getStoredBytes(Op op) const { return storedBytes[op].load(); }
+
+  void reset();
+
+ private:
+  IOStats();
+  IOStats(const IOStats&);
+  IOStats& operator=(const IOStats&);
+
+  void print(FILE* out, const std::string& filename) const;
+
+  std::atomic<long long> counters[ROLE_COUNT][COUNTER_COUNT];
+  std::atomic<long long> histogram[OP_COUNT][HISTOGRAM_BUCKETS];
+  std::atomic<long long> pageBytes[OP_COUNT];    // see compression()
+  std::atomic<long long> storedBytes[OP_COUNT];
+
+  static std::mutex registryLock;
+  static std::map<std::string, IOStats*> registry;
+};
+
+#endif /* IOSTATS_H */
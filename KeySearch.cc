@@ -0,0 +1,122 @@
+/**
+ * Copyright (C) 2008 by The Regents of the University of California
+ * Redistribution of this file is permitted under the terms of the GNU
+ * Public License (GPL).
+ */
+
+#include "KeySearch.h"
+#include <climits>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define KEYSEARCH_X86
+#endif
+
+// the binary search stops at this many keys, and the compares count them
+static const int SSE2_WINDOW = 32;
+static const int AVX2_WINDOW = 64;
+
+typedef int (*SearchFunc)(const int* keys, int count, int key);
+
+// narrow [keys, keys + count) down to at most window keys that hold the
+// answer. each step keeps the half the answer is in, without a branch
+static const int* narrow(const int* keys, int& count, int key, int window)
+{
+  const int* base = keys;
+  int n = count;
+
+  while (n > window) {
+    int half = n / 2;
+    base = (base[half - 1] < key) ? base + half : base;
+    n -= half;
+  }
+  count = n;
+  return base;
+}
+
+static int lowerBoundBinary(const int* keys, int count, int key)
+{
+  const int* base = keys;
+  int n = count;
+
+  if (n == 0) return 0;
+  while (n > 1) {
+    int half = n / 2;
+    base = (base[half] < key) ? base + half : base;
+    n -= half;
+  }
+  return (base - keys) + (*base < key);
+}
+
+#ifdef KEYSEARCH_X86
+
+static int lowerBoundSSE2(const int* keys, int count, int key)
+{
+  const int* base = narrow(keys, count, key, SSE2_WINDOW);
+  __m128i k = _mm_set1_epi32(key);
+  int n = 0;
+  int i = 0;
+
+  for (; i + 4 <= count; i += 4) {
+    __m128i v = _mm_loadu_si128((const __m128i*)(base + i));
+    n += __builtin_popcount(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmplt_epi32(v, k))));
+  }
+  for (; i < count; i++) n += (base[i] < key);
+
+  return (base - keys) + n;
+}
+
+__attribute__((target("avx2,popcnt")))
+static int lowerBoundAVX2(const int* keys, int count, int key)
+{
+  const int* base = narrow(keys, count, key, AVX2_WINDOW);
+  __m256i k = _mm256_set1_epi32(key);
+  int n = 0;
+  int i = 0;
+
+  for (; i + 8 <= count; i += 8) {
+    __m256i v = _mm256_loadu_si256((const __m256i*)(base + i));
+    n += __builtin_popcount(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(k, v))));
+  }
+  for (; i < count; i++) n += (base[i] < key);
+
+  return (base - keys) + n;
+}
+
+#endif /* KEYSEARCH_X86 */
+
+static SearchFunc chooseSearch(const char*& name)
+{
+#ifdef KEYSEARCH_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    name = "avx2";
+    return lowerBoundAVX2;
+  }
+  if (__builtin_cpu_supports("sse2")) {
+    name = "sse2";
+    return lowerBoundSSE2;
+  }
+#endif
+  name = "binary";
+  return lowerBoundBinary;
+}
+
+static const char* searchName;
+static const SearchFunc search = chooseSearch(searchName);
+
+int KeySearch::lowerBound(const int* keys, int count, int key)
+{
+  return search(keys, count, key);
+}
+
+int KeySearch::upperBound(const int* keys, int count, int key)
+{
+  // the keys <= INT_MAX are all of them
+  return (key == INT_MAX) ? count : search(keys, count, key + 1);
+}
+
+const char* KeySearch::kernel()
+{
+  return searchName;
+}
@@ -0,0 +1,42 @@
+/*
+ * Copyright (C) 2008 by The Regents of the University of California
+ * Redistribution of this file is permitted under the terms of the GNU
+ * Public License (GPL).
+ */
+
+#ifndef KEYSEARCH_H
+#define KEYSEARCH_H
+
+/**
+ * Search the sorted key array of a B+tree node.
+ * The search narrows the array down with a branchless binary search, and
+ * counts the keys below the search key in what is left with SIMD compares
+ * (AVX2, or SSE2). The kernel is picked once, at startup, from what the
+ * processor supports; without SIMD the binary search goes all the way.
+ */
+class KeySearch {
+ public:
+  /**
+   * @param keys[IN] the keys, in ascending order
+   * @param count[IN] # keys
+   * @param key[IN] the key to search for
+   * @return # keys smaller than key: the position of the first key >= key
+   */
+  static int lowerBound(const int* keys, int count, int key);
+
+  /**
+   * @param keys[IN] the keys, in ascending order
+   * @param count[IN] # keys
+   * @param key[IN] the key to search for
+   * @return # keys smaller than or equal to key: the position of the first
+   *         key > key
+   */
+  static int upperBound(const int* keys, int count, int key);
+
+  /**
+   * @return the name of the kernel in use: "avx2", "sse2" or "binary"
+   */
+  static const char* kernel();
+};
+
+#endif /* KEYSEARCH_H */
@@ -0,0 +1,141 @@
+/**
+ * Copyright (C) 2008 by The Regents of the University of California
+ * Redistribution of this file is permitted under the terms of the GNU
+ * Public License (GPL).
+ */
+
+#include "PageCodec.h"
+#include <cstring>
+
+// the match finder remembers the last position of each hash of 4 bytes
+static const int HASH_BITS = 12;
+
+static unsigned read32(const char* p)
+{
+  unsigned v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static unsigned hash32(unsigned v)
+{
+  return (v * 2654435761u) >> (32 - HASH_BITS);
+}
+
+// write the continuation bytes of a length field of 15 or more
+static char* putLength(char* op, const char* end, int n)
+{
+  for (; n >= 255; n -= 255) {
+    if (op >= end) return NULL;
+    *op++ = (char) 255;
+  }
+  if (op >= end) return NULL;
+  *op++ = (char) n;
+  return op;
+}
+
+// read the continuation bytes of a length field of 15
+static const char* getLength(const char* ip, const char* end, int& n)
+{
+  unsigned char c;
+  do {
+    if (ip >= end) return NULL;
+    c = (unsigned char) *ip++;
+    n += c;
+  } while (c == 255);
+  return ip;
+}
+
+// write one (literals, match) pair. a match length of 0 ends the page
+static char* putSequence(char* op, const char* end, const char* literals, int count, int offset, int match)
+{
+  int ml = (match > 0) ? match - PageCodec::MIN_MATCH : 0;
+
+  if (op >= end) return NULL;
+  char* token = op++;
+  *token = (char)(((count < 15) ? count : 15) << 4 | ((ml < 15) ? ml : 15));
+  if (count >= 15 && (op = putLength(op, end, count - 15)) == NULL) return NULL;
+
+  if (end - op < count) return NULL;
+  memcpy(op, literals, count);
+  op += count;
+  if (match == 0) return op;
+
+  if (end - op < 2) return NULL;
+  *op++ = (char)(offset & 0xff);
+  *op++ = (char)(offset >> 8);
+  if (ml >= 15 && (op = putLength(op, end, ml - 15)) == NULL) return NULL;
+  return op;
+}
+
+int PageCodec::compress(const char* src, int size, char* dst, int capacity)
+{
+  unsigned short table[1 << HASH_BITS];  // position + 1. 0 for none
+  const char* end = dst + capacity;
+  char* op = dst;
+  int   anchor = 0;
+  int   ip = 0;
+
+  memset(table, 0, sizeof(table));
+
+  while (ip + MIN_MATCH <= size) {
+    unsigned v = read32(src + ip);
+    unsigned h = hash32(v);
+    int candidate = (int) table[h] - 1;
+    table[h] = (unsigned short)(ip + 1);
+
+    if (candidate < 0 || read32(src + candidate) != v) {
+      ip++;
+      continue;
+    }
+
+    // extend the match as far as it goes. it may overlap the position
+    int match = MIN_MATCH;
+    while (ip + match < size && src[candidate + match] == src[ip + match]) match++;
+
+    if ((op = putSequence(op, end, src + anchor, ip - anchor, ip - candidate, match)) == NULL) return 0;
+    ip += match;
+    anchor = ip;
+  }
+
+  // the rest of the page is literals
+  if ((op = putSequence(op, end, src + anchor, size - anchor, 0, 0)) == NULL) return 0;
+  return op - dst;
+}
+
+RC PageCodec::decompress(const char* src, int length, char* dst, int size)
+{
+  const char* ip = src;
+  const char* iend = src + length;
+  char* op = dst;
+  char* oend = dst + size;
+
+  while (ip < iend) {
+    unsigned char token = (unsigned char) *ip++;
+    int count = token >> 4;
+    int match = token & 15;
+
+    // the literals
+    if (count == 15 && (ip = getLength(ip, iend, count)) == NULL) return RC_INVALID_FILE_FORMAT;
+    if (iend - ip < count || oend - op < count) return RC_INVALID_FILE_FORMAT;
+    memcpy(op, ip, count);
+    ip += count;
+    op += count;
+    if (ip == iend) break;
+
+    // the match. it is copied a byte at a time, since it may overlap
+    // the bytes it produces
+    if (iend - ip < 2) return RC_INVALID_FILE_FORMAT;
+    int offset = (unsigned char) ip[0] | ((unsigned char) ip[1] << 8);
+    ip += 2;
+    if (match == 15 && (ip = getLength(ip, iend, match)) == NULL) return RC_INVALID_FILE_FORMAT;
+    match += MIN_MATCH;
+    if (offset == 0 || offset > op - dst || oend - op < match) return RC_INVALID_FILE_FORMAT;
+
+    const char* from = op - offset;
+    for (int i = 0; i < match; i++) op[i] = from[i];
+    op += match;
+  }
+
+  return (op == oend) ? 0 : RC_INVALID_FILE_FORMAT;
+}
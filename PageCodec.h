@@ -0,0 +1,49 @@
+/*
+ * Copyright (C) 2008 by The Regents of the University of California
+ * Redistribution of this file is permitted under the terms of the GNU
+ * Public License (GPL).
+ */
+
+#ifndef PAGECODEC_H
+#define PAGECODEC_H
+
+#include "Bruinbase.h"
+
+/**
+ * A fast LZ77 codec for single pages.
+ * A compressed page is a sequence of (literals, match) pairs. Each pair
+ * starts with a token byte: the high 4 bits are the # literals and the low
+ * 4 bits the match length - MIN_MATCH. A field of 15 continues in the bytes
+ * after the token (literals) or the offset (match length), each adding up
+ * to 255. The literals follow, then the 2-byte offset of the match back
+ * from the current position. The last pair has literals only.
+ * The codec keeps no state between pages, so any page can be decoded alone.
+ */
+class PageCodec {
+ public:
+  // the shortest match worth encoding
+  static const int MIN_MATCH = 4;
+
+  /**
+   * compress a page.
+   * @param src[IN] the page
+   * @param size[IN] # bytes in the page. at most 65535
+   * @param dst[OUT] the compressed page
+   * @param capacity[IN] # bytes dst can hold
+   * @return # bytes of the compressed page. 0 if it does not fit in capacity
+   */
+  static int compress(const char* src, int size, char* dst, int capacity);
+
+  /**
+   * decompress a page.
+   * @param src[IN] the compressed page
+   * @param length[IN] # bytes of the compressed page
+   * @param dst[OUT] the page
+   * @param size[IN] # bytes in the page
+   * @return error code. 0 if no error. RC_INVALID_FILE_FORMAT if the
+   *         compressed page is corrupt or does not decode to size bytes
+   */
+  static RC decompress(const char* src, int length, char* dst, int size);
+};
+
+#endif /* PAGECODEC_H */
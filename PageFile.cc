@@ -9,84 +9,457 @@
 
 #include "Bruinbase.h"
 #include "PageFile.h"
+#include "BufferPool.h"
+#include "AsyncIO.h"
+#include "PageLog.h"
+#include "PageCodec.h"
+#include <cerrno>
+#include <cstdlib>
 #include <cstring>
+#include <vector>
+#include <algorithm>
+#include <climits>
 #include <fcntl.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
 using std::string;
 
-int PageFile::readCount = 0;
-int PageFile::writeCount = 0;
-int PageFile::cacheClock = 1;
-struct PageFile::cacheStruct PageFile::readCache[PageFile::CACHE_COUNT];
+std::atomic<long long> PageFile::readCount(0);
+std::atomic<long long> PageFile::writeCount(0);
+BufferPool PageFile::cache;
 
 PageFile::PageFile() 
 { 
   fd = -1; 
   epid = 0; 
+  writeBack = false;
+  map = NULL;
+  mapLength = 0;
+  direct = false;
+  pageSize = DEFAULT_PAGE_SIZE;
+  base = 0;
+  pattern = ACCESS_NORMAL;
+  stats = NULL;
+  classifier = NULL;
+  log = NULL;
+  groupCommitDelay = -1;
+  allocEnd = reserved = 0;
+  compressed = slotsDirty = false;
+  dataEnd = 0;
+  readAheadPages = DEFAULT_READ_AHEAD;
+  hitCount = missCount = 0;
+  lastPid = -1;
+  seqRun = 0;
+  raStart = raEnd = 0;
+  readAheadCount = readAheadHitCount = 0;
 }
 
 PageFile::PageFile(const string& filename, char mode)
 {
   fd = -1;
   epid = 0;
+  writeBack = false;
+  map = NULL;
+  mapLength = 0;
+  direct = false;
+  pageSize = DEFAULT_PAGE_SIZE;
+  base = 0;
+  pattern = ACCESS_NORMAL;
+  stats = NULL;
+  classifier = NULL;
+  log = NULL;
+  groupCommitDelay = -1;
+  allocEnd = reserved = 0;
+  compressed = slotsDirty = false;
+  dataEnd = 0;
+  readAheadPages = DEFAULT_READ_AHEAD;
+  hitCount = missCount = 0;
+  lastPid = -1;
+  seqRun = 0;
+  raStart = raEnd = 0;
+  readAheadCount = readAheadHitCount = 0;
   open(filename.c_str(), mode);
 }
 
-RC PageFile::open(const string& filename, char mode)
+// "BPF1": marks a file that starts with a header page
+static const int HEADER_MAGIC = 0x31465042;
+
+// the flags of a file in its header page
+static const int FILE_COMPRESSED = 1;  // the pages are stored with PageCodec
+
+// the layout of the header page. the rest of the page is zero
+struct FileHeader {
+  int magic;     // HEADER_MAGIC
+  int pageSize;  // the page size of the file
+  int freeHead;  // the first trunk page of the free list (+1). 0 for none
+  int freeCount; // # free pages on the free list
+  int flags;     // FILE_COMPRESSED. 0 for none
+};
+
+// "BPM1": the first word of the page map of a compressed file
+static const int MAP_MAGIC = 0x314d5042;
+
+// the page map starts with this header, followed by a PageSlot per page
+struct MapHeader {
+  int magic;     // MAP_MAGIC
+  int pageSize;  // the page size of the file
+  int count;     // # pages in the map
+  int unused;
+};
+
+PageFile::~PageFile()
+{
+  // the cache may still hold dirty pages that point back to this object
+  if (fd > 0) close();
+}
+
+RC PageFile::setCacheSize(int pages)
+{
+  return cache.setFrameCount(pages);
+}
+
+// the page size for new files when the caller does not ask for one
+static int defaultPageSize()
+{
+  const char* env = getenv("BRUINBASE_PAGE_SIZE");
+  int size = (env != NULL) ? atoi(env) : 0;
+  return PageFile::isValidPageSize(size) ? size : PageFile::DEFAULT_PAGE_SIZE;
+}
+
+bool PageFile::isValidPageSize(int size)
+{
+  return size >= MIN_PAGE_SIZE && size <= MAX_PAGE_SIZE && (size & (size - 1)) == 0;
+}
+
+RC PageFile::open(const string& filename, char mode, int size)
 {
   RC   rc;
   int  oflag;
+  PageId head = -1;
   struct stat statbuf;
 
   if (fd > 0) return RC_FILE_OPEN_FAILED;
+  if (size != 0 && !isValidPageSize(size)) return RC_INVALID_PAGE_SIZE;
 
   // set the unix file flag depending on the file mode
   switch (mode) {
   case 'r':
   case 'R':
     oflag = O_RDONLY;
+    writeBack = false;
     break;
   case 'w':
   case 'W':
     oflag = (O_RDWR|O_CREAT);
+    writeBack = false;
+    break;
+  case 'm':
+  case 'M':
+    oflag = (O_RDWR|O_CREAT);
+    writeBack = false;
+    break;
+  case 'd':
+  case 'D':
+    oflag = (O_RDWR|O_CREAT|O_DIRECT);
+    writeBack = false;
     break;
   default:
     return RC_INVALID_FILE_MODE;
   }
 
-  // open the file
+  // open the file. file systems without direct i/o (tmpfs, for one)
+  // refuse O_DIRECT; use normal i/o there
   fd = ::open(filename.c_str(), oflag, 0644);
+  if (fd < 0 && errno == EINVAL && (oflag & O_DIRECT)) {
+    oflag &= ~O_DIRECT;
+    fd = ::open(filename.c_str(), oflag, 0644);
+  }
   if (fd < 0) { fd = -1; return RC_FILE_OPEN_FAILED; }
+  direct = (oflag & O_DIRECT) != 0;
+  stats = IOStats::forFile(filename);
 
   // get the size of the file to set the end pid
   rc = ::fstat(fd, &statbuf);
   if (rc < 0) { ::close(fd); fd = -1; return RC_FILE_OPEN_FAILED; }
-  epid = statbuf.st_size / PAGE_SIZE;
 
+  // a new file starts with a header page that records its page size.
+  // a file without the header was written with DEFAULT_PAGE_SIZE pages
+  if (statbuf.st_size == 0 && (oflag & O_RDWR)) {
+    rc = writeHeader(size != 0 ? size : defaultPageSize());
+  } else {
+    rc = readHeader(head);
+  }
+  if (rc < 0) { ::close(fd); fd = -1; return rc; }
+  epid = (statbuf.st_size > 0) ? statbuf.st_size / pageSize - base : 0;
+
+  // the pages of a compressed file are found through its page map. they
+  // are not aligned for direct i/o, and cannot be mapped
+  mapName = filename + ".pmap";
+  slots.clear();
+  slotsDirty = false;
+  if (compressed) {
+    rc = (mode == 'm' || mode == 'M') ? RC_INVALID_FILE_MODE : loadPageMap();
+    if (rc < 0) { ::close(fd); fd = -1; compressed = false; return rc; }
+    epid = slots.size();
+    dataEnd = statbuf.st_size;
+    if (direct) {
+      ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) & ~O_DIRECT);
+      direct = false;
+    }
+  }
+
+  // the pages committed to the log of the file may not be in it yet
+  logName = filename + ".wal";
+  if ((rc = recover((oflag & O_RDWR) != 0)) < 0) { ::close(fd); fd = -1; return rc; }
+
+  // take the free list. a writer removes it from the file until the
+  // close, so that a crash cannot leave a page in use on it
+  freePages.clear();
+  if (head >= 0) {
+    if ((rc = loadFreeList(head)) == 0 && (oflag & O_RDWR)) {
+      if ((rc = writeHeader(pageSize)) == 0 && ::fdatasync(fd) < 0) rc = RC_FILE_WRITE_FAILED;
+    }
+    if (rc < 0) { ::close(fd); fd = -1; return rc; }
+  }
+  allocEnd = reserved = epid;
+
+  // map the file in 'm' mode
+  if (mode == 'm' || mode == 'M') {
+    if ((rc = remap(epid)) < 0) { ::close(fd); fd = -1; return rc; }
+  }
+
+  hitCount = missCount = 0;
+  lastPid = -1;
+  seqRun = 0;
+  raStart = raEnd = 0;
+  readAheadCount = readAheadHitCount = 0;
   return 0;
 }
 
 RC PageFile::close()
 {
+  RC rc = 0;
+
   if (fd <= 0) return RC_FILE_CLOSE_FAILED;
 
-  // close the file
-  if (::close(fd) < 0) return RC_FILE_CLOSE_FAILED;
+  // copy the pages in the log back to the file. a log that could only be
+  // read is left for a later writer
+  if (log != NULL) {
+    rc = log->isWritable() ? checkpoint() : 0;
+    if (log->close() < 0 && rc == 0) rc = RC_FILE_CLOSE_FAILED;
+    delete log;
+    log = NULL;
+  }
 
-  // evict all cached pages for this file
-  for (int i = 0; i < CACHE_COUNT; i++) {
-    if (readCache[i].fd == fd && readCache[i].lastAccessed != 0) {
-       readCache[i].fd = 0;
-       readCache[i].pid = 0;
-       readCache[i].lastAccessed = 0;
-    }
+  // write back the dirty pages and evict all cached pages for this file
+  // before its fd can be reused. when the checkpoint failed, the pages
+  // are left to the recovery from the log
+  if (rc == 0) rc = flush();
+
+  // keep the free pages in the file. they are written after the dirty
+  // pages, since a free page may have been written before it was freed
+  if (rc == 0 && !freePages.empty()) rc = saveFreeList();
+  freePages.clear();
+  if (rc == 0 && slotsDirty) rc = savePageMap();
+
+  // give back the disk space reserved past the end of the file
+  struct stat statbuf;
+  if (reserved > epid && ::fstat(fd, &statbuf) == 0) ::ftruncate(fd, statbuf.st_size);
+  cache.invalidateFile(fd);
+
+  // release the mapping of a mapped file
+  if (map != NULL) {
+    ::munmap(map, mapLength);
+    map = NULL;
+    mapLength = 0;
   }
 
+  // close the file
+  if (::close(fd) < 0) return RC_FILE_CLOSE_FAILED;
+
   // set the fd and epid to the initial state
   fd = -1; 
   epid = 0;
+  writeBack = false;
+  direct = false;
+  pageSize = DEFAULT_PAGE_SIZE;
+  base = 0;
+  pattern = ACCESS_NORMAL;
+  compressed = slotsDirty = false;
+  slots.clear();
+  dataEnd = 0;
+  return rc;
+}
+
+RC PageFile::flush()
+{
+  RC rc;
+
+  if (fd <= 0) return 0;
+
+  // write the dirty pages in pid order, so that the disk sees
+  // (mostly) sequential writes
+  if ((rc = cache.flushFile(fd)) < 0) return rc;
+
+  // the page map of a compressed file points to the pages just written
+  if (slotsDirty) rc = savePageMap();
+  return rc;
+}
+
+RC PageFile::setCompression(bool on)
+{
+  if (fd <= 0) return RC_FILE_OPEN_FAILED;
+  if (on == compressed) return 0;
+
+  // the format of the pages cannot change once a page is in the file
+  if (epid > 0 || allocEnd > 0 || base == 0 || map != NULL || log != NULL) return RC_INVALID_FILE_MODE;
+  if ((::fcntl(fd, F_GETFL) & O_ACCMODE) == O_RDONLY) return RC_INVALID_FILE_MODE;
+
+  compressed = on;
+  slots.clear();
+  slotsDirty = on;
+  dataEnd = offsetOf(0);
+  if (!on) ::unlink(mapName.c_str());
+  if (on && direct) {
+    ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) & ~O_DIRECT);
+    direct = false;
+  }
+  return writeHeader(pageSize);
+}
+
+RC PageFile::loadPageMap()
+{
+  MapHeader header;
+  int       mfd;
+  ssize_t   n;
+
+  // a compressed file without pages may not have a map yet
+  if ((mfd = ::open(mapName.c_str(), O_RDONLY)) < 0) {
+    return (errno == ENOENT && epid == 0) ? 0 : RC_INVALID_FILE_FORMAT;
+  }
+
+  n = ::pread(mfd, &header, sizeof(header), 0);
+  if (n != sizeof(header) || header.magic != MAP_MAGIC || header.pageSize != pageSize || header.count < 0) {
+    ::close(mfd);
+    return RC_INVALID_FILE_FORMAT;
+  }
+
+  slots.resize(header.count);
+  size_t length = slots.size() * sizeof(PageSlot);
+  n = (length > 0) ? ::pread(mfd, &slots[0], length, sizeof(header)) : 0;
+  ::close(mfd);
+  if (n != (ssize_t) length) {
+    slots.clear();
+    return RC_INVALID_FILE_FORMAT;
+  }
+  return 0;
+}
+
+RC PageFile::savePageMap()
+{
+  MapHeader header;
+  int       mfd;
+  string    temp = mapName + ".tmp";
+  std::unique_lock<std::mutex> guard(slotLock);
+
+  // the pages must be on the disk before the map points to them
+  if (::fdatasync(fd) < 0) return RC_FILE_WRITE_FAILED;
+
+  if ((mfd = ::open(temp.c_str(), O_WRONLY|O_CREAT|O_TRUNC, 0644)) < 0) return RC_FILE_WRITE_FAILED;
+  header.magic = MAP_MAGIC;
+  header.pageSize = pageSize;
+  header.count = slots.size();
+  header.unused = 0;
+
+  struct iovec iov[2];
+  iov[0].iov_base = &header;
+  iov[0].iov_len = sizeof(header);
+  iov[1].iov_base = slots.empty() ? NULL : &slots[0];
+  iov[1].iov_len = slots.size() * sizeof(PageSlot);
+  ssize_t n = ::pwritev(mfd, iov, 2, 0);
+  if (n != (ssize_t)(iov[0].iov_len + iov[1].iov_len) || ::fsync(mfd) < 0) {
+    ::close(mfd);
+    ::unlink(temp.c_str());
+    return RC_FILE_WRITE_FAILED;
+  }
+  ::close(mfd);
+
+  if (::rename(temp.c_str(), mapName.c_str()) < 0) return RC_FILE_WRITE_FAILED;
+  slotsDirty = false;
+  return 0;
+}
+
+RC PageFile::setWriteBack(bool on)
+{
+  RC rc;
+
+  // a mapped file has no cached pages to hold back
+  if (map != NULL) return 0;
+
+  // the pages of a file with a log go to the disk through the log only
+  if (!on && log != NULL) return RC_INVALID_FILE_MODE;
+
+  if (!on && writeBack) {
+    if ((rc = flush()) < 0) return rc;
+  }
+  writeBack = on;
+  return 0;
+}
+
+RC PageFile::advise(AccessPattern pattern)
+{
+  int advice;
+
+  if (fd <= 0) return RC_FILE_OPEN_FAILED;
+
+  // the page cache reads the pages of a sequential file through a ring
+  this->pattern = pattern;
+
+  if (map != NULL) {
+    switch (pattern) {
+    case ACCESS_SEQUENTIAL: advice = MADV_SEQUENTIAL; break;
+    case ACCESS_RANDOM:     advice = MADV_RANDOM; break;
+    default:                advice = MADV_NORMAL; break;
+    }
+    // hints are best effort; a failure does not affect correctness
+    ::madvise(map, mapLength, advice);
+  } else {
+    switch (pattern) {
+    case ACCESS_SEQUENTIAL: advice = POSIX_FADV_SEQUENTIAL; break;
+    case ACCESS_RANDOM:     advice = POSIX_FADV_RANDOM; break;
+    default:                advice = POSIX_FADV_NORMAL; break;
+    }
+    ::posix_fadvise(fd, 0, 0, advice);
+  }
+
+  return 0;
+}
+
+RC PageFile::remap(PageId pages)
+{
+  size_t length = (size_t)(pages + base) * pageSize;
+  void*  addr;
+
+  if (length <= mapLength && map != NULL) return 0;
+
+  // reserve twice the size needed, so that a growing file is remapped
+  // only every time its size doubles. the part of the mapping beyond the
+  // end of the file is never touched
+  length = 2 * length;
+  if (length < MIN_MAP_LENGTH) length = MIN_MAP_LENGTH;
+
+  if (map == NULL) {
+    addr = ::mmap(NULL, length, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+  } else {
+    addr = ::mremap(map, mapLength, length, MREMAP_MAYMOVE);
+  }
+  if (addr == MAP_FAILED) return RC_FILE_OPEN_FAILED;
+
+  map = (char*) addr;
+  mapLength = length;
   return 0;
 }
 
@@ -95,86 +468,1158 @@ PageId PageFile::endPid() const
   return epid;
 }
 
-RC PageFile::seek(PageId pid) const
+// true if the buffer can be handed to direct i/o as it is
+static bool isAligned(const void* buffer)
 {
-  return (::lseek(fd, pid * PAGE_SIZE, SEEK_SET) < 0) ? RC_FILE_SEEK_FAILED : 0;
+  return ((size_t)buffer % PageFile::DIRECT_ALIGNMENT) == 0;
 }
 
-RC PageFile::write(PageId pid, const void* buffer)
+// allocate a buffer aligned for direct i/o. release it with free()
+static char* alignedAlloc(size_t length)
+{
+  void* p;
+  if (posix_memalign(&p, PageFile::DIRECT_ALIGNMENT, length) != 0) return NULL;
+  return (char*) p;
+}
+
+RC PageFile::readHeader(PageId& head)
+{
+  FileHeader header;
+  ssize_t    n;
+  char*      block;
+
+  // the header is read in one aligned block, so that this works on a
+  // direct file too
+  if ((block = alignedAlloc(DIRECT_ALIGNMENT)) == NULL) return RC_OUT_OF_MEMORY;
+  long long start = IOStats::now();
+  do {
+    n = ::pread(fd, block, DIRECT_ALIGNMENT, 0);
+  } while (n < 0 && errno == EINTR);
+  memcpy(&header, block, sizeof(header));
+  free(block);
+  if (n < 0) return RC_FILE_READ_FAILED;
+  stats->latency(IOStats::OP_READ, start);
+  stats->count(ROLE_HEADER, IOStats::DISK_READS);
+
+  head = -1;
+  if (n >= (ssize_t)sizeof(header) && header.magic == HEADER_MAGIC) {
+    if (!isValidPageSize(header.pageSize)) return RC_INVALID_FILE_FORMAT;
+    pageSize = header.pageSize;
+    base = 1;
+    head = header.freeHead - 1;
+    compressed = (header.flags & FILE_COMPRESSED) != 0;
+  } else {
+    pageSize = DEFAULT_PAGE_SIZE;
+    base = 0;
+    compressed = false;
+  }
+  return 0;
+}
+
+RC PageFile::writeHeader(int size, PageId head, int count)
+{
+  FileHeader header;
+  ssize_t    n;
+  char*      page;
+
+  if ((page = alignedAlloc(size)) == NULL) return RC_OUT_OF_MEMORY;
+  memset(page, 0, size);
+  header.magic = HEADER_MAGIC;
+  header.pageSize = size;
+  header.freeHead = head + 1;
+  header.freeCount = count;
+  header.flags = compressed ? FILE_COMPRESSED : 0;
+  memcpy(page, &header, sizeof(header));
+
+  pageSize = size;
+  base = 1;
+
+  long long start = IOStats::now();
+  do {
+    n = ::pwrite(fd, page, size, 0);
+  } while (n < 0 && errno == EINTR);
+  if (n < 0 && direct && errno == EINVAL) {
+    n = (bounceWrite(0, page) < 0) ? -1 : size;
+  }
+  free(page);
+  if (n != size) return RC_FILE_WRITE_FAILED;
+  stats->latency(IOStats::OP_WRITE, start);
+  stats->count(ROLE_HEADER, IOStats::DISK_WRITES);
+
+  return 0;
+}
+
+RC PageFile::loadFreeList(PageId head)
+{
+  RC    rc = 0;
+  char* page;
+  int   trunks = 0;
+
+  if ((page = alignedAlloc(pageSize)) == NULL) return RC_OUT_OF_MEMORY;
+
+  // a chain longer than the file is broken
+  while (head >= 0 && rc == 0) {
+    int next, count;
+    if (head >= epid || ++trunks > epid) { rc = RC_INVALID_FILE_FORMAT; break; }
+    if ((rc = readPage(head, page)) < 0) break;
+    memcpy(&next, page, sizeof(int));
+    memcpy(&count, page + sizeof(int), sizeof(int));
+    if (count < 0 || count > (int)((pageSize - 2 * sizeof(int)) / sizeof(PageId))) {
+      rc = RC_INVALID_FILE_FORMAT;
+      break;
+    }
+
+    freePages.insert(head);
+    for (int i = 0; i < count; i++) {
+      PageId pid;
+      memcpy(&pid, page + 2 * sizeof(int) + i * sizeof(PageId), sizeof(PageId));
+      if (pid >= 0 && pid < epid) freePages.insert(pid);
+    }
+    head = next - 1;
+  }
+
+  free(page);
+  if (rc < 0) freePages.clear();
+  return rc;
+}
+
+RC PageFile::saveFreeList()
+{
+  RC    rc = 0;
+  char* page;
+  PageId head = -1;
+  int   perTrunk = (pageSize - 2 * sizeof(int)) / sizeof(PageId);
+
+  // a file without the header page has no place for the list
+  if (base == 0 || (::fcntl(fd, F_GETFL) & O_ACCMODE) == O_RDONLY) return 0;
+  if ((page = alignedAlloc(pageSize)) == NULL) return RC_OUT_OF_MEMORY;
+
+  // the pages given out at the end of the file but never written are not
+  // in it. the others go to trunk pages, taken from the free pages
+  std::vector<PageId> pids;
+  for (std::set<PageId>::const_iterator it = freePages.begin(); it != freePages.end(); ++it) {
+    if (*it < epid) pids.push_back(*it);
+  }
+  int total = pids.size();
+
+  while (!pids.empty() && rc == 0) {
+    PageId trunk = pids.back();
+    pids.pop_back();
+    int count = ((int)pids.size() < perTrunk) ? pids.size() : perTrunk;
+    int next = head + 1;
+
+    memset(page, 0, pageSize);
+    memcpy(page, &next, sizeof(int));
+    memcpy(page + sizeof(int), &count, sizeof(int));
+    memcpy(page + 2 * sizeof(int), &pids[pids.size() - count], count * sizeof(PageId));
+    pids.resize(pids.size() - count);
+
+    rc = writePage(trunk, page);
+    cache.invalidate(fd, trunk);
+    head = trunk;
+  }
+  free(page);
+  if (rc < 0) return rc;
+
+  // the trunk pages must be on the disk before the header points to them
+  if (::fdatasync(fd) < 0) return RC_FILE_WRITE_FAILED;
+  return writeHeader(pageSize, head, total);
+}
+
+void PageFile::growEnd(PageId pages)
+{
+  reserve(pages);
+
+  // readers look at the end pid without a lock. it only ever grows
+  PageId end = epid.load();
+  while (end < pages && !epid.compare_exchange_weak(end, pages)) { }
+}
+
+void PageFile::reserve(PageId pages)
+{
+  // the pages of a compressed file do not sit at their offsets
+  if (pages <= reserved || map != NULL || compressed) return;
+
+  // grow by an eighth of the file, so that a large file grows in few steps
+  PageId extent = reserved / 8;
+  if (extent < MIN_EXTENT_SIZE / pageSize) extent = MIN_EXTENT_SIZE / pageSize;
+  if (pages < reserved + extent) pages = reserved + extent;
+
+  // the size of the file stays as it is. a file system without fallocate
+  // allocates the pages as they are written
+  ::fallocate(fd, FALLOC_FL_KEEP_SIZE, offsetOf(reserved), (off_t)(pages - reserved) * pageSize);
+  reserved = pages;
+}
+
+RC PageFile::allocate(PageId& pid, PageId hint)
+{
+  std::set<PageId>::iterator it;
+
+  if (fd <= 0) return RC_FILE_OPEN_FAILED;
+  if (allocEnd < epid) allocEnd = epid;
+
+  // a free page right after the hint, or any free page without one
+  if (hint >= 0) {
+    it = freePages.upper_bound(hint);
+    if (it != freePages.end() && *it <= hint + NEAR_PAGES) {
+      pid = *it;
+      freePages.erase(it);
+      return 0;
+    }
+  } else if (!freePages.empty()) {
+    pid = *freePages.begin();
+    freePages.erase(freePages.begin());
+    return 0;
+  }
+
+  // a new page at the end of the file
+  pid = allocEnd++;
+  reserve(allocEnd);
+  return 0;
+}
+
+RC PageFile::freePage(PageId pid)
+{
+  if (fd <= 0) return RC_FILE_OPEN_FAILED;
+  if (pid < 0 || (pid >= epid && pid >= allocEnd)) return RC_INVALID_PID;
+
+  freePages.insert(pid);
+  return 0;
+}
+
+RC PageFile::setLogging(bool on)
 {
   RC rc;
-  if (pid < 0) return RC_INVALID_PID; 
 
-  // seek to the location of the page
-  if ((rc = seek(pid)) < 0) return rc;
+  if (fd <= 0) return RC_FILE_OPEN_FAILED;
 
-  // write the buffer to the disk page
-  if (::write(fd, buffer, PAGE_SIZE) < 0) return RC_FILE_WRITE_FAILED;
+  if (!on) {
+    if (log == NULL) return 0;
+    if ((rc = checkpoint()) < 0) return rc;
+    rc = log->close();
+    delete log;
+    log = NULL;
+    return rc;
+  }
+
+  if (log != NULL) return 0;
+  if (map != NULL || compressed || (::fcntl(fd, F_GETFL) & O_ACCMODE) == O_RDONLY) return RC_INVALID_FILE_MODE;
+
+  // the pages written so far go to the file, not to the log
+  if ((rc = flush()) < 0) return rc;
+
+  log = new PageLog();
+  if ((rc = log->open(logName, pageSize, true)) < 0) {
+    delete log;
+    log = NULL;
+    return rc;
+  }
+  setGroupCommit(groupCommitDelay);
+  writeBack = true;
+  return 0;
+}
+
+void PageFile::setGroupCommit(int usec)
+{
+  groupCommitDelay = usec;
+  if (usec < 0) {
+    const char* env = getenv("BRUINBASE_GROUP_COMMIT_USEC");
+    usec = (env != NULL) ? atoi(env) : PageLog::DEFAULT_GROUP_COMMIT_DELAY;
+  }
+  if (log != NULL) log->setGroupCommitDelay(usec);
+}
+
+RC PageFile::commit()
+{
+  RC rc;
+
+  // the dirty pages go to the log, followed by the commit frame
+  if ((rc = flush()) < 0 || log == NULL) return rc;
+  if ((rc = log->commit()) < 0) return rc;
+
+  // the pages are copied back lazily, once the log has grown large
+  if (log->size() > PageLog::DEFAULT_CHECKPOINT_SIZE) return checkpoint();
+  return 0;
+}
+
+RC PageFile::checkpoint()
+{
+  RC rc = 0;
+  std::vector<PageId> pids;
+  bool found;
+  char* page;
+
+  if (log == NULL) return 0;
+  if (!log->isWritable()) return RC_INVALID_FILE_MODE;
+
+  // the log must be on the disk before the file is overwritten, so that
+  // a crash during the checkpoint can be recovered from it
+  if ((rc = flush()) < 0 || (rc = log->commit()) < 0 || (rc = log->sync()) < 0) return rc;
 
-  // if the page is in read cache, invalidate it
-  for (int i = 0; i < CACHE_COUNT; i++) {
-    if (readCache[i].fd == fd && readCache[i].pid == pid &&
-        readCache[i].lastAccessed != 0) {
-       readCache[i].fd = 0;
-       readCache[i].pid = 0;
-       readCache[i].lastAccessed = 0;
-       break;
+  if ((page = alignedAlloc(pageSize)) == NULL) return RC_OUT_OF_MEMORY;
+  log->committedPages(pids);
+  for (unsigned i = 0; i < pids.size() && rc == 0; i++) {
+    if ((rc = log->read(pids[i], page, found)) == 0 && found) rc = writePage(pids[i], page);
+  }
+  free(page);
+  if (rc < 0) return rc;
+
+  if (::fdatasync(fd) < 0) return RC_FILE_WRITE_FAILED;
+  return log->reset();
+}
+
+RC PageFile::recover(bool writable)
+{
+  RC rc;
+
+  if (::access(logName.c_str(), F_OK) < 0) return 0;
+
+  log = new PageLog();
+  if ((rc = log->open(logName, pageSize, writable)) < 0) {
+    delete log;
+    log = NULL;
+    // an empty log of a read-only file has nothing to recover
+    return (rc == RC_FILE_OPEN_FAILED && !writable) ? 0 : rc;
+  }
+  if (log->endPid() > epid) epid = log->endPid();
+  if (!writable) return 0;
+
+  // write the pages back, and leave the file without a log
+  rc = checkpoint();
+  if (log->close() < 0 && rc == 0) rc = RC_FILE_CLOSE_FAILED;
+  delete log;
+  log = NULL;
+  return rc;
+}
+
+RC PageFile::readPage(PageId pid, void* buffer) const
+{
+  RC rc;
+  ssize_t n = -1;
+  long long start = IOStats::now();
+
+  if (compressed) {
+    char* page = (char*) buffer;
+    return readCompressed(pid, &page, 1);
+  }
+
+  // the latest image of a page in the log is there
+  if (log != NULL) {
+    bool found;
+    if ((rc = log->read(pid, buffer, found)) < 0) return rc;
+    if (found) {
+      readCount++;
+      stats->latency(IOStats::OP_READ, start);
+      note(IOStats::DISK_READS, pid, buffer);
+      return 0;
     }
   }
 
-  // if the written pid >= end pid, update the end pid
-  if (pid >= epid) epid = pid + 1;
+  // read the page at its offset. the file cursor is not used, so that
+  // concurrent readers of the same fd do not interfere with each other.
+  // direct i/o that the device cannot take as it is goes through a bounce
+  // buffer
+  if (!direct || isAligned(buffer)) {
+    do {
+      n = ::pread(fd, buffer, pageSize, offsetOf(pid));
+    } while (n < 0 && errno == EINTR);
+  }
+  if (n < 0 && direct && (errno == EINVAL || !isAligned(buffer))) {
+    if ((rc = bounceRead(offsetOf(pid), buffer, n)) < 0) return rc;
+  }
+  if (n < 0) return RC_FILE_READ_FAILED;
+
+  // a page that is still only in the cache of a write-back file reads
+  // as zeros beyond the current end of the file
+  if (n < pageSize) memset((char*)buffer + n, 0, pageSize - n);
+
+  // increase the page read count
+  readCount++;
+  stats->latency(IOStats::OP_READ, start);
+  note(IOStats::DISK_READS, pid, buffer);
+
+  return 0;
+}
+
+RC PageFile::writePage(PageId pid, const void* buffer)
+{
+  ssize_t n;
+  long long start = IOStats::now();
+
+  if (compressed) {
+    char* page = (char*) buffer;
+    return writeCompressed(pid, &page, 1);
+  }
+
+  // write the buffer to the disk page
+  if (direct && !isAligned(buffer)) {
+    RC rc = bounceWrite(offsetOf(pid), buffer);
+    if (rc < 0) return rc;
+    n = pageSize;
+  } else {
+    do {
+      n = ::pwrite(fd, buffer, pageSize, offsetOf(pid));
+    } while (n < 0 && errno == EINTR);
+    if (n < 0 && direct && errno == EINVAL) {
+      RC rc = bounceWrite(offsetOf(pid), buffer);
+      if (rc < 0) return rc;
+      n = pageSize;
+    }
+  }
+  if (n != pageSize) return RC_FILE_WRITE_FAILED;
 
   // increase page write count
   writeCount++;
+  stats->latency(IOStats::OP_WRITE, start);
+  note(IOStats::DISK_WRITES, pid, buffer);
 
   return 0;
 }
 
-RC PageFile::read(PageId pid, void* buffer) const
+//
+// orders the entries of a vectored read or write by pid. the sort is
+// stable, so the entries of the same page keep their order
+//
+struct PageIOLess {
+  const PageIO* pages;
+  PageIOLess(const PageIO* p) : pages(p) {}
+  bool operator()(int a, int b) const { return pages[a].pid < pages[b].pid; }
+};
+
+static void sortPages(const PageIO* pages, int count, std::vector<int>& order)
+{
+  order.resize(count);
+  for (int i = 0; i < count; i++) order[i] = i;
+  std::stable_sort(order.begin(), order.end(), PageIOLess(pages));
+}
+
+RC PageFile::readPages(PageId pid, char* const* buffers, int count) const
+{
+  RC rc;
+  struct iovec iov[IOV_MAX];
+
+  if (compressed) return readCompressed(pid, buffers, count);
+
+  // a run with a page in the log is read page by page
+  if (log != NULL) {
+    for (int i = 0; i < count; i++) {
+      if (!log->contains(pid + i)) continue;
+      for (i = 0; i < count; i++) {
+        if ((rc = readPage(pid + i, buffers[i])) < 0) return rc;
+      }
+      return 0;
+    }
+  }
+
+  while (count > 0) {
+    int     pages = (count < IOV_MAX) ? count : IOV_MAX;
+    bool    aligned = true;
+    ssize_t n = -1;
+    long long start = IOStats::now();
+
+    for (int i = 0; i < pages; i++) {
+      iov[i].iov_base = buffers[i];
+      iov[i].iov_len = pageSize;
+      if (direct && !isAligned(buffers[i])) aligned = false;
+    }
+    if (aligned) {
+      do {
+        n = ::preadv(fd, iov, pages, offsetOf(pid));
+      } while (n < 0 && errno == EINTR);
+    }
+
+    if (n < 0) {
+      // direct i/o the device cannot take as it is goes page by page
+      // through the bounce buffer
+      if (!direct) return RC_FILE_READ_FAILED;
+      for (int i = 0; i < pages; i++) {
+        if ((rc = readPage(pid + i, buffers[i])) < 0) return rc;
+      }
+    } else {
+      // the pages beyond the end of the file read as zeros
+      for (int i = 0; i < pages; i++) {
+        ssize_t got = n - (ssize_t)i * pageSize;
+        if (got < 0) got = 0;
+        if (got < pageSize) memset(buffers[i] + got, 0, pageSize - got);
+        note(IOStats::DISK_READS, pid + i, buffers[i]);
+      }
+      readCount += pages;
+      stats->latency(IOStats::OP_READ, start);
+    }
+
+    pid += pages;
+    buffers += pages;
+    count -= pages;
+  }
+
+  return 0;
+}
+
+RC PageFile::writePages(PageId pid, char* const* buffers, int count)
+{
+  RC rc;
+  struct iovec iov[IOV_MAX];
+
+  if (compressed) return writeCompressed(pid, buffers, count);
+
+  // the pages of a file with a log are appended to the log. they reach
+  // the file at the next checkpoint
+  if (log != NULL) {
+    long long start = IOStats::now();
+    if ((rc = log->append(pid, buffers, count)) < 0) return rc;
+    writeCount += count;
+    stats->latency(IOStats::OP_WRITE, start);
+    for (int i = 0; i < count; i++) note(IOStats::DISK_WRITES, pid + i, buffers[i]);
+    return 0;
+  }
+
+  while (count > 0) {
+    int     pages = (count < IOV_MAX) ? count : IOV_MAX;
+    bool    aligned = true;
+    ssize_t n = -1;
+    long long start = IOStats::now();
+
+    for (int i = 0; i < pages; i++) {
+      iov[i].iov_base = buffers[i];
+      iov[i].iov_len = pageSize;
+      if (direct && !isAligned(buffers[i])) aligned = false;
+    }
+    if (aligned) {
+      do {
+        n = ::pwritev(fd, iov, pages, offsetOf(pid));
+      } while (n < 0 && errno == EINTR);
+    }
+
+    if (n < 0 && direct) {
+      for (int i = 0; i < pages; i++) {
+        if ((rc = writePage(pid + i, buffers[i])) < 0) return rc;
+      }
+    } else {
+      if (n != (ssize_t)pages * pageSize) return RC_FILE_WRITE_FAILED;
+      writeCount += pages;
+      stats->latency(IOStats::OP_WRITE, start);
+      for (int i = 0; i < pages; i++) note(IOStats::DISK_WRITES, pid + i, buffers[i]);
+    }
+
+    pid += pages;
+    buffers += pages;
+    count -= pages;
+  }
+
+  return 0;
+}
+
+RC PageFile::readCompressed(PageId pid, char* const* buffers, int count) const
+{
+  RC rc;
+  std::vector<PageSlot> run(count);
+  std::vector<char> data;
+
+  {
+    std::unique_lock<std::mutex> guard(slotLock);
+    for (int i = 0; i < count; i++) {
+      if (pid + i < (PageId) slots.size()) {
+        run[i] = slots[pid + i];
+      } else {
+        run[i].offset = 0;
+      }
+    }
+  }
+
+  for (int i = 0; i < count; ) {
+    if (run[i].offset != 0 && (run[i].length <= 0 || run[i].length > run[i].capacity || run[i].length > pageSize)) {
+      return RC_INVALID_FILE_FORMAT;
+    }
+
+    // a page never written reads as zeros
+    if (run[i].offset == 0) {
+      memset(buffers[i], 0, pageSize);
+      i++;
+      continue;
+    }
+
+    // the pages stored one after another are read together
+    int j = i + 1;
+    while (j < count && run[j].offset != 0 && run[j].offset == run[j - 1].offset + run[j - 1].capacity &&
+           run[j].length > 0 && run[j].length <= run[j].capacity && run[j].length <= pageSize) j++;
+    size_t length = run[j - 1].offset + run[j - 1].length - run[i].offset;
+    data.resize(length);
+
+    ssize_t n;
+    long long start = IOStats::now();
+    do {
+      n = ::pread(fd, &data[0], length, run[i].offset);
+    } while (n < 0 && errno == EINTR);
+    if (n != (ssize_t) length) return RC_FILE_READ_FAILED;
+    stats->latency(IOStats::OP_READ, start);
+    stats->compression(IOStats::OP_READ, (long long)(j - i) * pageSize, length);
+
+    // decode each page into its buffer. a page that did not compress is
+    // stored as it is
+    for (int k = i; k < j; k++) {
+      const char* stored = &data[run[k].offset - run[i].offset];
+      if (run[k].length == pageSize) {
+        memcpy(buffers[k], stored, pageSize);
+      } else {
+        start = IOStats::now();
+        if ((rc = PageCodec::decompress(stored, run[k].length, buffers[k], pageSize)) < 0) return rc;
+        stats->latency(IOStats::OP_DECODE, start);
+      }
+      note(IOStats::DISK_READS, pid + k, buffers[k]);
+    }
+    readCount += j - i;
+    i = j;
+  }
+
+  return 0;
+}
+
+RC PageFile::writeCompressed(PageId pid, char* const* buffers, int count)
+{
+  std::vector<char> packed;    // the pages moved to the end, one after another
+  std::vector<PageSlot> run(count);
+  char page[MAX_PAGE_SIZE];
+  long long stored = 0;
+  ssize_t n;
+  std::unique_lock<std::mutex> guard(slotLock);
+  long long start = IOStats::now();
+
+  for (int i = 0; i < count; i++) {
+    // a page that does not compress is stored as it is
+    const char* image = page;
+    int length = PageCodec::compress(buffers[i], pageSize, page, pageSize - 1);
+    if (length == 0) {
+      image = buffers[i];
+      length = pageSize;
+    }
+    stored += length;
+
+    // the page stays in its space if it fits, and moves to the end otherwise
+    PageSlot& slot = run[i];
+    if (pid + i < (PageId) slots.size() && slots[pid + i].offset != 0 && length <= slots[pid + i].capacity) {
+      slot = slots[pid + i];
+      slot.length = length;
+      do {
+        n = ::pwrite(fd, image, length, slot.offset);
+      } while (n < 0 && errno == EINTR);
+      if (n != length) return RC_FILE_WRITE_FAILED;
+    } else {
+      slot.offset = dataEnd + packed.size();
+      slot.length = length;
+      slot.capacity = (length + COMPRESSED_SLOT_SIZE - 1) / COMPRESSED_SLOT_SIZE * COMPRESSED_SLOT_SIZE;
+      packed.insert(packed.end(), image, image + length);
+      packed.resize(packed.size() + slot.capacity - length, 0);
+    }
+  }
+
+  if (!packed.empty()) {
+    do {
+      n = ::pwrite(fd, &packed[0], packed.size(), dataEnd);
+    } while (n < 0 && errno == EINTR);
+    if (n != (ssize_t) packed.size()) return RC_FILE_WRITE_FAILED;
+    dataEnd += packed.size();
+  }
+
+  // the map points to the new pages only once they are written
+  if (pid + count > (PageId) slots.size()) {
+    PageSlot none = { 0, 0, 0 };
+    slots.resize(pid + count, none);
+  }
+  for (int i = 0; i < count; i++) {
+    slots[pid + i] = run[i];
+    note(IOStats::DISK_WRITES, pid + i, buffers[i]);
+  }
+  slotsDirty = true;
+
+  writeCount += count;
+  stats->latency(IOStats::OP_WRITE, start);
+  stats->compression(IOStats::OP_WRITE, (long long) count * pageSize, stored);
+  return 0;
+}
+
+RC PageFile::bounceRead(off_t offset, void* buffer, ssize_t& n) const
+{
+  off_t   start = offset & ~(off_t)(DIRECT_ALIGNMENT - 1);
+  size_t  length = ((offset + pageSize - start) + DIRECT_ALIGNMENT - 1) & ~(size_t)(DIRECT_ALIGNMENT - 1);
+  ssize_t got;
+  char*   block;
+
+  if ((block = alignedAlloc(length)) == NULL) return RC_OUT_OF_MEMORY;
+
+  // read the aligned block around the page and take the page out of it
+  do {
+    got = ::pread(fd, block, length, start);
+  } while (got < 0 && errno == EINTR);
+  if (got < 0) { free(block); return RC_FILE_READ_FAILED; }
+
+  n = got - (offset - start);
+  if (n < 0) n = 0;
+  if (n > pageSize) n = pageSize;
+  memcpy(buffer, block + (offset - start), n);
+
+  free(block);
+  return 0;
+}
+
+RC PageFile::bounceWrite(off_t offset, const void* buffer)
+{
+  off_t   start = offset & ~(off_t)(DIRECT_ALIGNMENT - 1);
+  size_t  length = ((offset + pageSize - start) + DIRECT_ALIGNMENT - 1) & ~(size_t)(DIRECT_ALIGNMENT - 1);
+  ssize_t got, n;
+  char*   block;
+
+  if ((block = alignedAlloc(length)) == NULL) return RC_OUT_OF_MEMORY;
+
+  // read-modify-write the aligned block around the page. the part of the
+  // block beyond the end of the file reads as zeros
+  do {
+    got = ::pread(fd, block, length, start);
+  } while (got < 0 && errno == EINTR);
+  if (got < 0) { free(block); return RC_FILE_WRITE_FAILED; }
+  memset(block + got, 0, length - got);
+  memcpy(block + (offset - start), buffer, pageSize);
+
+  do {
+    n = ::pwrite(fd, block, length, start);
+  } while (n < 0 && errno == EINTR);
+  free(block);
+  if (n != (ssize_t)length) return RC_FILE_WRITE_FAILED;
+
+  // the block may reach past the end of the file. cut the file back so
+  // that it grows by the written page only
+  if (got < (ssize_t)length) {
+    off_t size = start + got;
+    if (size < offset + pageSize) size = offset + pageSize;
+    if (::ftruncate(fd, size) < 0) return RC_FILE_WRITE_FAILED;
+  }
+
+  return 0;
+}
+
+RC PageFile::write(PageId pid, const void* buffer)
 {
   RC rc;
+  int frame;
+  bool load;
+
+  if (pid < 0) return RC_INVALID_PID; 
+
+  if (map != NULL) {
+    // grow the file first; touching the mapping beyond the end of the
+    // file is an error
+    if (pid >= epid) {
+      if (::ftruncate(fd, offsetOf(pid + 1)) < 0) return RC_FILE_WRITE_FAILED;
+      if ((rc = remap(pid + 1)) < 0) return rc;
+    }
+    memcpy(map + offsetOf(pid), buffer, pageSize);
+  } else if (writeBack) {
+    // update the cached page and leave the disk write for later.
+    // the whole page is overwritten, so a missing page is never read
+    if ((frame = cache.fetch(fd, pid, this, load)) < 0) return frame;
+    if (cache.data(frame) != buffer) memcpy(cache.data(frame), buffer, pageSize);
+    if (load) cache.loaded(frame, true);
+    cache.markDirty(frame);
+    cache.unpinFrame(frame);
+  } else {
+    // write the buffer to the disk page
+    if ((rc = writePage(pid, buffer)) < 0) return rc;
+
+    // if the page is in read cache, refresh it. it may be pinned
+    cache.refresh(fd, pid, buffer);
+  }
+
+  // if the written pid >= end pid, update the end pid
+  if (pid >= epid) growEnd(pid + 1);
+  note(IOStats::WRITES, pid, buffer);
+
+  return 0;
+}
+
+RC PageFile::writev(const PageIO* pages, int count)
+{
+  RC     rc = 0;
+  PageId last = -1;
+  std::vector<int> order;
+
+  for (int i = 0; i < count; i++) {
+    if (pages[i].pid < 0) return RC_INVALID_PID;
+    if (pages[i].pid > last) last = pages[i].pid;
+  }
+  if (count <= 0) return 0;
+
+  if (map != NULL || writeBack) {
+    // grow a mapped file once for all the pages
+    if (map != NULL && last >= epid) {
+      if (::ftruncate(fd, offsetOf(last + 1)) < 0) return RC_FILE_WRITE_FAILED;
+      if ((rc = remap(last + 1)) < 0) return rc;
+      growEnd(last + 1);
+    }
+
+    // the pages only go to memory. a mapped file copies them into the
+    // mapping; a write-back file keeps them in the cache, and its flush
+    // writes the consecutive dirty pages with one system call
+    for (int i = 0; i < count; i++) {
+      if ((rc = write(pages[i].pid, pages[i].buffer)) < 0) return rc;
+    }
+    return 0;
+  }
+
+  for (int i = 0; i < count; i++) note(IOStats::WRITES, pages[i].pid, pages[i].buffer);
+
+  // keep the last buffer of each page, in pid order
+  sortPages(pages, count, order);
+  std::vector<PageId> pids;
+  std::vector<char*>  buffers;
+  for (int k = 0; k < count; k++) {
+    if (k + 1 < count && pages[order[k + 1]].pid == pages[order[k]].pid) continue;
+    pids.push_back(pages[order[k]].pid);
+    buffers.push_back((char*) pages[order[k]].buffer);
+  }
+
+  // write each run of consecutive pids with one system call
+  unsigned written = 0;
+  while (written < pids.size()) {
+    unsigned j = written + 1;
+    while (j < pids.size() && pids[j] == pids[j - 1] + 1) j++;
+    if ((rc = writePages(pids[written], &buffers[written], j - written)) < 0) break;
+    written = j;
+  }
+
+  // refresh the cached copies of the pages written, and the end pid
+  for (unsigned i = 0; i < written; i++) cache.refresh(fd, pids[i], buffers[i]);
+  if (written > 0 && pids[written - 1] >= epid) growEnd(pids[written - 1] + 1);
+
+  return rc;
+}
+
+RC PageFile::prefetch(const PageId* pids, int count) const
+{
+  RC rc = 0;
+  bool load;
+  std::vector<PageId>    pages(pids, pids + count);
+  std::vector<int>       frames;
+  std::vector<IORequest> reqs;
+
+  if (fd <= 0) return RC_FILE_OPEN_FAILED;
+
+  // issue the reads in pid order, and each page only once
+  std::sort(pages.begin(), pages.end());
+  pages.erase(std::unique(pages.begin(), pages.end()), pages.end());
+
+  if (map != NULL) {
+    // the kernel reads the pages in the background
+    for (unsigned i = 0; i < pages.size(); i++) {
+      if (pages[i] < 0 || pages[i] >= epid) continue;
+      off_t offset = offsetOf(pages[i]);
+      off_t start = offset & ~(off_t)(DIRECT_ALIGNMENT - 1);
+      ::madvise(map + start, offset + pageSize - start, MADV_WILLNEED);
+    }
+    return 0;
+  }
+
+  // take a frame for every page not cached yet. the frames stay pinned
+  // and marked as loading until the batch completes
+  for (unsigned i = 0; i < pages.size(); i++) {
+    if (pages[i] < 0 || pages[i] >= epid) continue;
+    // the batch reads the file only. a page in the log is read when asked for
+    if (log != NULL && log->contains(pages[i])) continue;
+    int frame = cache.fetch(fd, pages[i], const_cast<PageFile*>(this), load);
+    if (frame < 0) break;
+    if (!load) {
+      cache.unpinFrame(frame);
+      continue;
+    }
+
+    IORequest req;
+    req.fd = fd;
+    req.buffer = cache.data(frame);
+    req.length = pageSize;
+    req.offset = offsetOf(pages[i]);
+    req.result = 0;
+    reqs.push_back(req);
+    frames.push_back(frame);
+  }
+  if (reqs.empty()) return 0;
+
+  // the pages of a compressed file are decoded into their frames. the
+  // pages stored one after another are read together
+  if (compressed) {
+    for (unsigned i = 0; i < reqs.size(); ) {
+      PageId first = reqs[i].offset / pageSize - base;
+      std::vector<char*> buffers;
+      unsigned j = i;
+      while (j < reqs.size() && reqs[j].offset / pageSize - base == first + (PageId)(j - i)) {
+        buffers.push_back((char*) reqs[j++].buffer);
+      }
+      RC r = readPages(first, &buffers[0], j - i);
+      if (r < 0 && rc == 0) rc = r;
+      for (; i < j; i++) {
+        cache.loaded(frames[i], r == 0);
+        if (r == 0) cache.unpinFrame(frames[i]);
+      }
+    }
+    return rc;
+  }
+
+  long long start = IOStats::now();
+  if (AsyncIO::engine().readBatch(&reqs[0], reqs.size()) < 0) {
+    for (unsigned i = 0; i < reqs.size(); i++) reqs[i].result = -1;
+  }
+
+  stats->latency(IOStats::OP_READ, start);
+
+  // publish the pages. a read the batch could not do (direct i/o the
+  // device refuses, for one) is retried alone, and drops its frame if
+  // it fails again
+  for (unsigned i = 0; i < reqs.size(); i++) {
+    bool ok = reqs[i].result >= 0;
+    if (ok) {
+      if (reqs[i].result < pageSize) {
+        memset((char*)reqs[i].buffer + reqs[i].result, 0, pageSize - reqs[i].result);
+      }
+      readCount++;
+      note(IOStats::DISK_READS, reqs[i].offset / pageSize - base, reqs[i].buffer);
+    } else {
+      RC r = readPage(reqs[i].offset / pageSize - base, reqs[i].buffer);
+      if (r < 0 && rc == 0) rc = r;
+      ok = (r == 0);
+    }
+    cache.loaded(frames[i], ok);
+    if (ok) cache.unpinFrame(frames[i]);
+  }
+
+  return rc;
+}
+
+RC PageFile::fetch(PageId pid, int& frame) const
+{
+  RC rc;
+  bool load;
 
   if (pid < 0 || pid >= epid) return RC_INVALID_PID; 
 
-  //
-  // if the page is in cache, read it from there
-  //
-  for (int i = 0; i < CACHE_COUNT; i++) {
-    if (readCache[i].fd == fd && readCache[i].pid == pid && 
-        readCache[i].lastAccessed != 0) {
-       memcpy(buffer, readCache[i].buffer, PAGE_SIZE);
-       readCache[i].lastAccessed = ++cacheClock;
-       return 0;
-    }
-  }
-
-  // seek to the page
-  if ((rc = seek(pid)) < 0) return rc;
-  
-  // find the cache slot to evict
-  int toEvict = 0; 
-  for (int i = 0; i < CACHE_COUNT; i++) {
-    if (readCache[i].lastAccessed == 0) {
-      toEvict = i;
-      break;
+  // find the page in cache, or take a frame for it
+  if ((frame = cache.fetch(fd, pid, const_cast<PageFile*>(this), load)) < 0) {
+    return frame;
+  }
+
+  if (!load) {
+    hitCount++;
+    note(IOStats::HITS, pid, cache.data(frame));
+    if (pid >= raStart && pid < raEnd) readAheadHitCount++;
+    readAhead(pid);
+    return 0;
+  }
+
+  // read the page to cache
+  rc = readPage(pid, cache.data(frame));
+  cache.loaded(frame, rc == 0);
+  if (rc < 0) return rc;
+
+  missCount++;
+  note(IOStats::MISSES, pid, cache.data(frame));
+  readAhead(pid);
+
+  return 0;
+}
+
+void PageFile::readAhead(PageId pid) const
+{
+  PageId last = lastPid.exchange(pid);
+  PageId from, to;
+  int    window;
+
+  // the records of a page are read one after another. that is not a new read
+  if (pid == last) return;
+
+  if (pid != last + 1) {
+    seqRun = 0;
+    raStart = raEnd = 0;
+    return;
+  }
+  if (++seqRun < SEQUENTIAL_THRESHOLD || readAheadPages == 0) return;
+
+  // keep the window ahead of the reader. the next batch is read when the
+  // reader is half way through the current one, and it must fit in the
+  // cache next to the pages being read
+  window = readAheadPages;
+  if (map == NULL && window > cache.getFrameCount() / 8) window = cache.getFrameCount() / 8;
+  if (window <= 0 || pid + window / 2 < raEnd) return;
+
+  from = (raEnd > pid) ? (PageId) raEnd : pid + 1;
+  to = pid + 1 + window;
+  if (to > epid) to = epid;
+  if (from >= to) return;
+
+  if (raEnd <= pid) raStart = from;
+  raEnd = to;
+
+  std::vector<PageId> pids;
+  for (PageId p = from; p < to; p++) pids.push_back(p);
+  if (prefetch(&pids[0], pids.size()) == 0) readAheadCount += pids.size();
+}
+
+RC PageFile::read(PageId pid, void* buffer) const
+{
+  RC rc;
+  int frame;
+
+  // a mapped page is copied straight from the mapping
+  if (map != NULL) {
+    if (pid < 0 || pid >= epid) return RC_INVALID_PID; 
+    memcpy(buffer, map + offsetOf(pid), pageSize);
+    note(IOStats::READS, pid, buffer);
+    readAhead(pid);
+    return 0;
+  }
+
+  // bring the page to cache and copy it to the buffer
+  if ((rc = fetch(pid, frame)) < 0) return rc;
+  memcpy(buffer, cache.data(frame), pageSize);
+  note(IOStats::READS, pid, buffer);
+  cache.unpinFrame(frame);
+
+  return 0;
+}
+
+RC PageFile::readv(const PageIO* pages, int count) const
+{
+  RC  rc = 0;
+  int k = 0;
+  bool load;
+  std::vector<int> order;
+
+  if (fd <= 0) return RC_FILE_OPEN_FAILED;
+  for (int i = 0; i < count; i++) {
+    if (pages[i].pid < 0 || pages[i].pid >= epid) return RC_INVALID_PID;
+  }
+
+  // mapped pages are copied straight from the mapping
+  if (map != NULL) {
+    for (int i = 0; i < count; i++) {
+      memcpy(pages[i].buffer, map + offsetOf(pages[i].pid), pageSize);
+      note(IOStats::READS, pages[i].pid, pages[i].buffer);
+    }
+    return 0;
+  }
+
+  // visit the pages in pid order, so that the missing ones form runs
+  sortPages(pages, count, order);
+
+  while (k < count) {
+    std::vector<int>  first;   // the position in order of each page of the batch
+    std::vector<int>  frames;
+    std::vector<bool> loads;
+
+    // take a frame for every page. the frames stay pinned until the pages
+    // are copied out, so a batch ends when the cache has no frame left
+    while (k < count) {
+      int frame = cache.fetch(fd, pages[order[k]].pid, const_cast<PageFile*>(this), load);
+      if (frame < 0) {
+        if (frames.empty()) return frame;
+        break;
+      }
+      first.push_back(k);
+      frames.push_back(frame);
+      loads.push_back(load);
+      for (k++; k < count && pages[order[k]].pid == pages[order[k - 1]].pid; k++);
     }
-    if (readCache[i].lastAccessed < readCache[toEvict].lastAccessed) {
-      toEvict = i;
+
+    // read the missing pages, one run of consecutive pids at a time
+    for (unsigned i = 0; i < frames.size(); ) {
+      if (!loads[i]) {
+        hitCount++;
+        note(IOStats::HITS, pages[order[first[i]]].pid, cache.data(frames[i]));
+        i++;
+        continue;
+      }
+
+      PageId pid = pages[order[first[i]]].pid;
+      std::vector<char*> buffers(1, cache.data(frames[i]));
+      unsigned j = i + 1;
+      while (j < frames.size() && loads[j] && pages[order[first[j]]].pid == pid + (PageId)(j - i)) {
+        buffers.push_back(cache.data(frames[j]));
+        j++;
+      }
+
+      RC r = readPages(pid, &buffers[0], j - i);
+      for (unsigned m = i; m < j; m++) {
+        cache.loaded(frames[m], r == 0);
+        if (r < 0) frames[m] = -1;
+      }
+      if (r < 0 && rc == 0) rc = r;
+      if (r == 0) {
+        missCount += j - i;
+        for (unsigned m = i; m < j; m++) note(IOStats::MISSES, pid + (PageId)(m - i), buffers[m - i]);
+      }
+      i = j;
     }
+
+    // copy the pages out to every buffer that asked for them
+    for (unsigned i = 0; i < frames.size(); i++) {
+      if (frames[i] < 0) continue;
+      int end = (i + 1 < first.size()) ? first[i + 1] : k;
+      for (int p = first[i]; p < end; p++) {
+        memcpy(pages[order[p]].buffer, cache.data(frames[i]), pageSize);
+        note(IOStats::READS, pages[order[p]].pid, pages[order[p]].buffer);
+      }
+      cache.unpinFrame(frames[i]);
+    }
+    if (rc < 0) return rc;
   }
-  readCache[toEvict].fd = fd;
-  readCache[toEvict].pid = pid;
-  readCache[toEvict].lastAccessed = ++cacheClock;
- 
-  // read the page to cache first and copy it to the buffer
-  if (::read(fd, readCache[toEvict].buffer, PAGE_SIZE) < 0) {
-    return RC_FILE_READ_FAILED;
+
+  return 0;
+}
+
+RC PageFile::pin(PageId pid, const char*& page) const
+{
+  RC rc;
+  int frame;
+
+  // a mapped page needs no pin. the mapping only moves when the file grows
+  if (map != NULL) {
+    if (pid < 0 || pid >= epid) return RC_INVALID_PID; 
+    page = map + offsetOf(pid);
+    note(IOStats::READS, pid, page);
+    readAhead(pid);
+    return 0;
   }
-  memcpy(buffer, readCache[toEvict].buffer, PAGE_SIZE);
 
-  // increase the page read count
-  readCount++;
+  // the pin taken by fetch() is handed over to the caller
+  if ((rc = fetch(pid, frame)) < 0) return rc;
+  page = cache.data(frame);
+  note(IOStats::READS, pid, page);
 
   return 0;
 }
+
+RC PageFile::pinMutable(PageId pid, char*& page)
+{
+  RC rc;
+  int frame;
+
+  if (map != NULL) {
+    if (pid < 0 || pid >= epid) return RC_INVALID_PID; 
+    page = map + offsetOf(pid);
+    note(IOStats::READS, pid, page);
+    note(IOStats::WRITES, pid, page);
+    return 0;
+  }
+
+  if ((rc = fetch(pid, frame)) < 0) return rc;
+  cache.markDirty(frame);
+  page = cache.data(frame);
+  note(IOStats::READS, pid, page);
+  note(IOStats::WRITES, pid, page);
+
+  return 0;
+}
+
+RC PageFile::unpin(PageId pid) const
+{
+  if (map != NULL) return (pid < 0 || pid >= epid) ? RC_INVALID_PID : 0;
+
+  // without write-back, a page modified through a mutable pin goes to
+  // the disk as soon as its last pin is released
+  return cache.unpin(fd, pid, !writeBack);
+}
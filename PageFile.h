@@ -11,53 +11,326 @@
 #define PAGEFILE_H
 
 #include <string>
+#include <set>
+#include <vector>
+#include <mutex>
+#include <sys/types.h>
+#include <atomic>
 #include "Bruinbase.h"
+#include "IOStats.h"
 
 typedef int PageId;
 
 /**
- * read/write a file in the unit of a page
+ * one page of a vectored read or write. see PageFile::readv() and writev()
+ */
+struct PageIO {
+  PageId pid;     // the page to read or write
+  void*  buffer;  // the content of the page, getPageSize() bytes
+};
+
+class BufferPool;
+class PageLog;
+
+/**
+ * read/write a file in the unit of a page.
+ * all disk i/o is positional (pread/pwrite), so several threads may read
+ * the same PageFile at the same time.
+ * a file opened in 'm' mode is memory-mapped instead: pages are read and
+ * written in the mapping and bypass the page cache.
+ * every file created by PageFile starts with a header page that records its
+ * page size, which is chosen when the file is created. the header page is
+ * not visible to the users of PageFile: page 0 is the first page after it.
+ * a file without the header has DEFAULT_PAGE_SIZE pages.
+ * a file opened in 'd' mode bypasses the operating system cache (O_DIRECT),
+ * so that its pages are cached only once, in the page cache of PageFile.
+ * the pages of a compressed file (see setCompression()) are stored with
+ * PageCodec and decoded into the page cache when they are read.
  */
 class PageFile {
  public:
 
-  static const int PAGE_SIZE = 1024;    // the size of a page is 1KB
+  // # pages read ahead of a sequential reader, unless set by setReadAhead()
+  static const int DEFAULT_READ_AHEAD = 16;
+
+  // the smallest # bytes of disk space reserved at a time past the end of
+  // the file (see allocate())
+  static const int MIN_EXTENT_SIZE = 65536;
+
+  // allocate() gives out a free page at most this far after the hint
+  static const int NEAR_PAGES = 16;
+
+  // the space for a page of a compressed file is reserved in multiples of
+  // this # bytes, so that a page rewritten a little larger often fits
+  static const int COMPRESSED_SLOT_SIZE = 64;
+
+  // # pages read in order before the file counts as read sequentially
+  static const int SEQUENTIAL_THRESHOLD = 3;
+
+  static const int DEFAULT_PAGE_SIZE = 1024;  // the page size of files without a header
+  static const int MIN_PAGE_SIZE = 1024;      // the smallest page size of a file
+  static const int MAX_PAGE_SIZE = 16384;     // the largest page size of a file
+
+  // access pattern hints for advise()
+  enum AccessPattern { ACCESS_NORMAL, ACCESS_SEQUENTIAL, ACCESS_RANDOM };
 
   PageFile();
   PageFile(const std::string& filename, char mode);
+  ~PageFile();
 
   /**
-   * open a file in read or write mode.
-   * when opened in 'w' mode, if the file does not exist, it is created.
+   * open a file in read, write, memory-mapped or direct mode.
+   * when opened in 'w', 'm' or 'd' mode, if the file does not exist, it is created.
+   * a file is written through to the disk until setWriteBack() turns on
+   * write-back mode.
+   * a file opened in 'm' mode is mapped into memory for reading and writing.
+   * it suits tables and indexes that are loaded once and queried many times.
+   * a file opened in 'd' mode is read and written like in 'w' mode, but its
+   * disk i/o bypasses the operating system cache. it suits files much larger
+   * than the memory. if the file system does not support direct i/o, the
+   * file is opened for normal i/o.
+   * a new file gets the given page size. if it is 0, the page size is taken
+   * from the environment variable BRUINBASE_PAGE_SIZE or DEFAULT_PAGE_SIZE.
+   * an existing file keeps the page size it was created with.
+   * if the file has a write-ahead log left over from a crash (see
+   * setLogging()), the committed pages in the log are recovered: a file
+   * opened for writing gets them written back, and a file opened in 'r'
+   * mode reads them from the log.
    * @param filename[IN] the name of the file to open
-   * @param mode[IN] 'r' for read, 'w' for write
+   * @param mode[IN] 'r' for read, 'w' for write, 'm' for memory-mapped,
+   *                 'd' for direct
+   * @param size[IN] the page size of a new file: a power of two between
+   *                 MIN_PAGE_SIZE and MAX_PAGE_SIZE, or 0 for the default
    * @return error code. 0 if no error
    */
-  RC open(const std::string& filename, char mode);
+  RC open(const std::string& filename, char mode, int size = 0);
 
   /**
-   * close the file.
+   * @return the size of the pages of the file in bytes
+   */
+  int getPageSize() const { return pageSize; }
+
+  /**
+   * @param size[IN] a page size
+   * @return true if a file can be created with the page size
+   */
+  static bool isValidPageSize(int size);
+
+  /**
+   * close the file. dirty pages of the file are flushed first.
    * @return error code. 0 if no error
    */
   RC close();
+
+  /**
+   * write every dirty cached page of this file to the disk in pid order.
+   * @return error code. 0 if no error
+   */
+  RC flush();
+
+  /**
+   * store the pages of the file compressed, or not. the format of the
+   * pages is chosen when the file is created: call this before the first
+   * page is written. the header page marks the file as compressed.
+   * each page is compressed alone, and stored in as many bytes as it takes
+   * (or uncompressed, if it does not compress). the page map in the file
+   * <filename>.pmap tells where each page is. the map is saved by flush()
+   * and close(); until then a crash may lose the pages written.
+   * a page rewritten larger than its space moves to the end of the file,
+   * and the space it leaves is not reused.
+   * a compressed file cannot be mapped or have a log, and its disk i/o
+   * does not bypass the operating system cache.
+   * @param on[IN] true to compress the pages
+   * @return error code. 0 if no error
+   */
+  RC setCompression(bool on);
+
+  /**
+   * @return true if the pages of the file are stored compressed
+   */
+  bool isCompressed() const { return compressed; }
+
+  /**
+   * turn the write-ahead log of the file on or off. the log is kept in
+   * the file <filename>.wal. while it is on, the file is in write-back mode
+   * and its pages reach the disk through the log only: the dirty pages
+   * written out of the cache are appended to the log, and commit() makes
+   * the pages written so far one transaction. a checkpoint copies the
+   * pages back to the file once the log grows past
+   * PageLog::DEFAULT_CHECKPOINT_SIZE, and when the file is closed.
+   * a crash loses only the transactions whose commit() has not returned,
+   * and never leaves one half done.
+   * a mapped file cannot have a log.
+   * @param on[IN] true to turn the log on
+   * @return error code. 0 if no error
+   */
+  RC setLogging(bool on);
+
+  /**
+   * @return true if the file has a write-ahead log
+   */
+  bool isLogging() const { return log != NULL; }
+
+  /**
+   * end the transaction of the pages written since the last commit, and
+   * return once it is on the disk. without a log, this only flushes the
+   * file.
+   * @return error code. 0 if no error
+   */
+  RC commit();
+
+  /**
+   * copy the pages in the log back to the file and empty the log.
+   * the pages written since the last commit are committed first.
+   * @return error code. 0 if no error
+   */
+  RC checkpoint();
+
+  /**
+   * set how long the commits to the log of this file wait for one
+   * another after a sync, so that several commits share one fsync.
+   * the default is BRUINBASE_GROUP_COMMIT_USEC from the environment,
+   * or PageLog::DEFAULT_GROUP_COMMIT_DELAY.
+   * @param usec[IN] the delay in microseconds. 0 syncs every commit
+   */
+  void setGroupCommit(int usec);
+
+  /**
+   * turn write-back mode on or off.
+   * in write-back mode, write() only updates the cached page and marks it
+   * dirty. dirty pages reach the disk when they are evicted from the cache,
+   * or when flush() or close() is called.
+   * turning write-back off flushes the dirty pages of the file.
+   * @param on[IN] true to turn write-back on
+   * @return error code. 0 if no error
+   */
+  RC setWriteBack(bool on);
+
+  /**
+   * tell the operating system how the file is about to be accessed:
+   * sequentially (table scans) or randomly (index probes).
+   * this is madvise() on a mapped file and posix_fadvise() otherwise.
+   * the pages of a sequential file are also kept in a small ring of cache
+   * frames, so that a scan does not evict the pages of other files.
+   * @param pattern[IN] the expected access pattern
+   * @return error code. 0 if no error
+   */
+  RC advise(AccessPattern pattern);
   
   /**
    * read a disk page into memory buffer.
+   * the buffer must hold getPageSize() bytes.
    * @param pid[IN] the page to read
    * @param buffer[OUT] pointer to memory buffer
    * @return error code. 0 if no error
    */
   RC read(PageId pid, void *buffer) const;
+
+  /**
+   * bring a disk page into the cache and pin it there, without copying.
+   * the returned pointer stays valid until the matching unpin().
+   * on a mapped file, the pointer points into the mapping and is only
+   * valid until the next write() that grows the file.
+   * @param pid[IN] the page to pin
+   * @param page[OUT] pointer to the cached page (read-only)
+   * @return error code. 0 if no error
+   */
+  RC pin(PageId pid, const char*& page) const;
+
+  /**
+   * same as pin(), but the page may be modified in place.
+   * the page is marked dirty and written back like a write() to it.
+   * @param pid[IN] the page to pin
+   * @param page[OUT] pointer to the cached page
+   * @return error code. 0 if no error
+   */
+  RC pinMutable(PageId pid, char*& page);
+
+  /**
+   * release a page pinned by pin() or pinMutable().
+   * @param pid[IN] the pinned page
+   * @return error code. 0 if no error
+   */
+  RC unpin(PageId pid) const;
+
+  /**
+   * bring a set of disk pages into the cache with one batch of reads,
+   * so that the following read() or pin() calls find them cached.
+   * all missing pages are read at the same time through AsyncIO.
+   * invalid pids and pages already cached are skipped, and the batch stops
+   * early when the cache has no free frame left.
+   * on a mapped file, the pages are only advised as needed soon.
+   * @param pids[IN] the pages to read
+   * @param count[IN] # pages in pids
+   * @return error code. 0 if no error
+   */
+  RC prefetch(const PageId* pids, int count) const;
   
   /**
    * write the memory buffer to the disk page.
+   * in write-back mode, the page is written to the cache and reaches
+   * the disk later.
    * if (pid >= endPid()), the file is expanded such that
    * endPid() becomes (pid + 1).
    * @param pid[IN] page to write to
-   * @param buffer[IN] the content to write
+   * @param buffer[IN] the content to write, getPageSize() bytes
    * @return error code. 0 if no error
    */
   RC write(PageId pid, const void *buffer);
+
+  /**
+   * find a page for new content: a free page (see freePage()), or a page at
+   * the end of the file. the page belongs to the caller until it is freed.
+   * pages that will be read together, such as sibling leaves, should be
+   * allocated with the page they follow as the hint: a free page right
+   * after the hint is preferred to any other.
+   * the disk space at the end of the file is reserved in extents of at
+   * least MIN_EXTENT_SIZE bytes (fallocate), so that the file grows in
+   * few large steps. the space not used is given back at close().
+   * @param pid[OUT] the page allocated
+   * @param hint[IN] the page the new one should follow. -1 for none
+   * @return error code. 0 if no error
+   */
+  RC allocate(PageId& pid, PageId hint = -1);
+
+  /**
+   * give a page back, so that allocate() can give it out again.
+   * the free pages are kept in the file when it is closed. a crash before
+   * the close leaks them, but never gives out a page in use.
+   * @param pid[IN] the page to free
+   * @return error code. 0 if no error
+   */
+  RC freePage(PageId pid);
+
+  /**
+   * @return # free pages of the file
+   */
+  int getFreePageCount() const { return freePages.size(); }
+
+  /**
+   * read several disk pages into their memory buffers.
+   * the pages missing from the cache are read with as few system calls as
+   * possible: the pages with consecutive ids are read by one preadv().
+   * a page may be listed more than once.
+   * @param pages[IN] the pages to read and the buffers to read them into
+   * @param count[IN] # pages in pages
+   * @return error code. 0 if no error
+   */
+  RC readv(const PageIO* pages, int count) const;
+
+  /**
+   * write several memory buffers to their disk pages, as if by write()
+   * for each of them in order. the pages with consecutive ids are written
+   * by one pwritev(), and the end pid and the cache are updated once.
+   * if a page is listed more than once, the last buffer wins.
+   * in write-back mode, the pages are written to the cache, and the
+   * consecutive pages are merged when they are flushed. a mapped file
+   * only copies the pages into the mapping, without a system call.
+   * @param pages[IN] the pages to write and their contents
+   * @param count[IN] # pages in pages
+   * @return error code. 0 if no error
+   */
+  RC writev(const PageIO* pages, int count);
     
   /**
    * note the +1 part. The last page id in the file is actually endPid()-1.
@@ -67,46 +340,314 @@ class PageFile {
   PageId endPid() const;
 
   /**
-   * @return the total # of disk reads
+   * @return true if the disk i/o of the file bypasses the operating system cache
+   */
+  bool isDirect() const { return direct; }
+
+  /**
+   * @return the total # of disk reads. accesses to mapped files are not counted
    */
-  static int getPageReadCount()  { return readCount; }
+  static long long getPageReadCount()  { return readCount.load(); }
   
   /**
-   * @return the total # of disk writes
+   * @return the total # of disk writes. accesses to mapped files are not counted
+   */
+  static long long getPageWriteCount() { return writeCount.load(); }
+
+  /**
+   * set the # pages the shared page cache can hold.
+   * call this when the process starts, before any file is read.
+   * @param pages[IN] # pages (frames) in the cache
+   * @return error code. 0 if no error
+   */
+  static RC setCacheSize(int pages);
+
+  /**
+   * @return # reads of this file served from the page cache
    */
-  static int getPageWriteCount() { return writeCount; }
+  int getCacheHitCount() const { return hitCount.load(); }
+
+  /**
+   * @return # reads of this file that missed the page cache
+   */
+  int getCacheMissCount() const { return missCount.load(); }
+
+  /**
+   * set how far ahead the file is read when it is read sequentially.
+   * when PageFile sees SEQUENTIAL_THRESHOLD pages read in order, it reads
+   * the next pages into the cache in one batch (see prefetch()), and keeps
+   * the window that far ahead of the reader as long as the reads stay in
+   * order. the window is limited to a fraction of the page cache.
+   * @param pages[IN] # pages to read ahead. 0 turns read-ahead off
+   */
+  void setReadAhead(int pages) { readAheadPages = (pages > 0) ? pages : 0; }
+
+  /**
+   * @return # pages the file is read ahead
+   */
+  int getReadAhead() const { return readAheadPages; }
+
+  /**
+   * @return # pages of this file read ahead of the reader
+   */
+  int getReadAheadCount() const { return readAheadCount.load(); }
+
+  /**
+   * @return # reads of this file served by a page read ahead.
+   *         reads of a mapped file are not counted
+   */
+  int getReadAheadHitCount() const { return readAheadHitCount.load(); }
+
+  /**
+   * tells the role of a page from its content, for the i/o statistics.
+   * @param pid[IN] the page
+   * @param page[IN] the content of the page
+   * @param size[IN] the page size of the file
+   * @return the role of the page
+   */
+  typedef PageRole (*PageClassifier)(PageId pid, const char* page, int size);
+
+  /**
+   * set how the pages of the file are told apart in its statistics.
+   * without a classifier, every page counts as a heap page.
+   * @param c[IN] the classifier. NULL for none
+   */
+  void setClassifier(PageClassifier c) { classifier = c; }
+
+  /**
+   * @return the i/o statistics of the file, kept by its name.
+   *         NULL if the file was never opened
+   */
+  IOStats* getStats() const { return stats; }
 
  protected:
+  friend class BufferPool;
+
   /**
-   * move the file cursor to the beginning of a page.
-   * this is an internal function not exposed to public.
-   * @param pid[IN] page to seek to
+   * read the disk page into the buffer, bypassing the cache.
+   * the part of the page beyond the end of the file reads as zeros.
+   * @param pid[IN] page to read
+   * @param buffer[OUT] the content of the page
    * @return error code. 0 if no error
    */
-  RC seek(PageId pid) const;
+  RC readPage(PageId pid, void* buffer) const;
+
+  /**
+   * write the buffer to the disk page, bypassing the cache.
+   * @param pid[IN] page to write to
+   * @param buffer[IN] the content to write
+   * @return error code. 0 if no error
+   */
+  RC writePage(PageId pid, const void* buffer);
+
+  /**
+   * read or write a run of pages with consecutive ids, starting at pid,
+   * with one vectored system call, bypassing the cache.
+   * the runs longer than IOV_MAX take more than one call.
+   * @param pid[IN] the first page of the run
+   * @param buffers[IN/OUT] the content of each page
+   * @param count[IN] # pages in the run
+   * @return error code. 0 if no error
+   */
+  RC readPages(PageId pid, char* const* buffers, int count) const;
+  RC writePages(PageId pid, char* const* buffers, int count);
+
+  /**
+   * read or write a run of pages of a compressed file.
+   * the pages stored next to each other are read with one pread(), and
+   * the pages that move to the end of the file are written with one
+   * pwrite(). the pages never written read as zeros.
+   * @param pid[IN] the first page of the run
+   * @param buffers[IN/OUT] the content of each page
+   * @param count[IN] # pages in the run
+   * @return error code. 0 if no error
+   */
+  RC readCompressed(PageId pid, char* const* buffers, int count) const;
+  RC writeCompressed(PageId pid, char* const* buffers, int count);
+
+  /**
+   * read or write the page map of a compressed file.
+   * the stored pages are synced before the map that points to them, and
+   * the map replaces the old one by rename(), so that a crash leaves one of
+   * the two.
+   * @return error code. 0 if no error
+   */
+  RC loadPageMap();
+  RC savePageMap();
+
+  /**
+   * find the page in the cache, reading it from the disk on a miss.
+   * the frame is pinned; the caller must release it with cache.unpinFrame().
+   * @param pid[IN] the page to fetch
+   * @param frame[OUT] the cache frame holding the page
+   * @return error code. 0 if no error
+   */
+  RC fetch(PageId pid, int& frame) const;
+
+  /**
+   * note a read of the page. when the reads so far are sequential,
+   * read the pages after it into the cache before they are asked for.
+   * @param pid[IN] the page being read
+   */
+  void readAhead(PageId pid) const;
+
+  /**
+   * make the mapping of a mapped file cover at least the given # pages.
+   * the mapping reserves more address space than the file needs, so that
+   * it rarely has to move when the file grows.
+   * @param pages[IN] # pages the mapping must cover
+   * @return error code. 0 if no error
+   */
+  RC remap(PageId pages);
+
+  /**
+   * read or write a page of a direct file through an aligned bounce buffer.
+   * the whole aligned block around the page is transferred, so this works
+   * when the buffer or the page is not aligned as direct i/o requires.
+   * @param offset[IN] the file offset of the page
+   * @param buffer[IN/OUT] the content of the page
+   * @param n[OUT] # bytes of the page found in the file (read only)
+   * @return error code. 0 if no error
+   */
+  RC bounceRead(off_t offset, void* buffer, ssize_t& n) const;
+  RC bounceWrite(off_t offset, const void* buffer);
+
+  /**
+   * read the header page of the file and set the page size from it.
+   * a file without the header has DEFAULT_PAGE_SIZE pages.
+   * @param head[OUT] the first trunk page of the free list. -1 for none
+   * @return error code. 0 if no error
+   */
+  RC readHeader(PageId& head);
+
+  /**
+   * write the header page of the file.
+   * @param size[IN] the page size of the file
+   * @param head[IN] the first trunk page of the free list. -1 for none
+   * @param count[IN] # free pages on the free list
+   * @return error code. 0 if no error
+   */
+  RC writeHeader(int size, PageId head = -1, int count = 0);
+
+  /**
+   * read the free list kept in the file into freePages.
+   * the free list is a chain of trunk pages, which are free pages
+   * themselves. each holds the next trunk page (+1, 0 for none), the # pids
+   * that follow, and the pids of free pages.
+   * @param head[IN] the first trunk page
+   * @return error code. 0 if no error
+   */
+  RC loadFreeList(PageId head);
+
+  /**
+   * write freePages to trunk pages and the header page.
+   * @return error code. 0 if no error
+   */
+  RC saveFreeList();
+
+  /**
+   * make the file at least the given # pages long, after a page beyond
+   * its end was written. the disk space is reserved as by reserve().
+   * @param pages[IN] # pages in the file
+   */
+  void growEnd(PageId pages);
+
+  /**
+   * reserve disk space for the file up to the given # pages, in extents.
+   * @param pages[IN] # pages the file will hold
+   */
+  void reserve(PageId pages);
+
+  /**
+   * attach the write-ahead log left over from a crash, if there is one.
+   * a writable file gets the committed pages of the log written back and
+   * the log removed. a read-only file keeps the log to read them from it.
+   * @param writable[IN] true if the file is open for writing
+   * @return error code. 0 if no error
+   */
+  RC recover(bool writable);
+
+  /**
+   * @param pid[IN] a page id
+   * @return the offset of the page in the file. the header page, if
+   *         present, comes first
+   */
+  off_t offsetOf(PageId pid) const { return (off_t)(pid + base) * pageSize; }
+
+  /**
+   * count an event on a page in the statistics of the file.
+   * @param c[IN] the event
+   * @param pid[IN] the page
+   * @param page[IN] the content of the page, to tell its role
+   * @param n[IN] # events
+   */
+  void note(IOStats::Counter c, PageId pid, const void* page, long long n = 1) const {
+    if (stats == NULL) return;
+    stats->count(classifier != NULL ? classifier(pid, (const char*)page, pageSize) : ROLE_HEAP, c, n);
+  }
 
  private:
   int     fd;     // file descriptor of the associated unix file
-  PageId  epid;   // (last page id + 1) of the file
+  std::atomic<PageId> epid;  // (last page id + 1) of the file. read without a lock
+  bool    writeBack;  // true if writes are held in the cache as dirty pages
+  char*   map;        // the mapping of the file in 'm' mode. NULL otherwise
+  size_t  mapLength;  // # bytes of address space reserved for the mapping
+  bool    direct;     // true if the file was opened with O_DIRECT
+  int     pageSize;   // the size of the pages of the file
+  PageId  base;       // # header pages before page 0. 0 for a file without header
+  AccessPattern pattern;  // the access pattern given to advise()
+  IOStats* stats;             // the i/o statistics of the file
+  PageLog* log;               // the write-ahead log. NULL if there is none
+  std::string logName;        // the name of the log file
+  int     groupCommitDelay;   // see setGroupCommit(). -1 for the default
+  std::set<PageId> freePages; // the pages allocate() can give out again
+  PageId  allocEnd;   // the first page at the end of the file not given out yet
+  PageId  reserved;   // # pages the file has disk space reserved for
+  PageClassifier classifier;  // tells the role of a page. NULL if all are heap pages
+
+  // where a page of a compressed file is stored
+  struct PageSlot {
+    long long offset;  // the offset of the stored page. 0 if never written
+    int length;        // # bytes stored. the page size if not compressed
+    int capacity;      // # bytes reserved for the page at the offset
+  };
+
+  bool    compressed;           // true if the pages are stored with PageCodec
+  std::vector<PageSlot> slots;  // the page map of a compressed file
+  off_t   dataEnd;              // where the next page moved to the end goes
+  bool    slotsDirty;           // true if the page map changed since it was saved
+  std::string mapName;          // the name of the page map file
+  mutable std::mutex slotLock;  // guards slots and dataEnd
+
+  // the minimum address space reserved for a mapped file
+  static const size_t MIN_MAP_LENGTH = 64 << 20;
+
+ public:
+  // the alignment of buffers, offsets and lengths in direct i/o.
+  // this covers the logical block size of every common device
+  static const int DIRECT_ALIGNMENT = 4096;
+
+ private:
+
+  mutable std::atomic<int> hitCount;   // # reads of this file served from the cache
+  mutable std::atomic<int> missCount;  // # reads of this file that went to the disk
 
   //
-  // the following set of members implement LRU caching 
+  // sequential read detection. the pages in [raStart, raEnd) were read ahead
   //
-  static const int CACHE_COUNT = 10;
-
-  static int cacheClock; // clock tick counter for LRU policy
+  int readAheadPages;                   // # pages to read ahead. 0 if off
+  mutable std::atomic<PageId> lastPid;  // the page read last
+  mutable std::atomic<int> seqRun;      // # pages read in order up to lastPid
+  mutable std::atomic<PageId> raStart;
+  mutable std::atomic<PageId> raEnd;
+  mutable std::atomic<int> readAheadCount;     // # pages read ahead
+  mutable std::atomic<int> readAheadHitCount;  // # reads served by them
 
-  // the actual cache data structure
-  static struct cacheStruct {
-    int    fd;              // file id of the cached page
-    PageId pid;             // page id of the cached page
-    int    lastAccessed;    // the last time the cached page was accessed
-                            //   (lastAccessed == 0) means that the buffer is empty
-    char buffer[PAGE_SIZE]; // the buffer used for caching
-  } readCache[CACHE_COUNT];
+  // the page cache shared by all PageFiles
+  static BufferPool cache;
 
-  static int readCount;  // total # of page reads 
-  static int writeCount; // total # of page writes 
+  static std::atomic<long long> readCount;  // total # of page reads 
+  static std::atomic<long long> writeCount; // total # of page writes 
 };
   
 #endif // PAGEFILE_H
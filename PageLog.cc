@@ -0,0 +1,348 @@
+/**
+ * Copyright (C) 2008 by The Regents of the University of California
+ * Redistribution of this file is permitted under the terms of the GNU
+ * Public License (GPL).
+ */
+
+#include "PageLog.h"
+#include "IOStats.h"
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+using std::map;
+using std::mutex;
+using std::string;
+using std::unique_lock;
+
+// "BLOG": the first word of the log file and of every frame
+static const int LOG_MAGIC = 0x474f4c42;
+
+//
+// the log file starts with this header
+//
+struct LogHeader {
+  int magic;     // LOG_MAGIC
+  int pageSize;  // the page size of the page file
+};
+
+//
+// every frame starts with this header. a page frame is followed by the
+// page. a commit frame has no page
+//
+struct FrameHeader {
+  int      magic;     // LOG_MAGIC
+  PageId   pid;       // the page. -1 in a commit frame
+  int      commit;    // 1 in a commit frame
+  unsigned checksum;  // of pid, commit and the page
+};
+
+//
+// the checksum of a frame (FNV-1a), which tells a frame torn by a crash
+//
+static unsigned checksum(const FrameHeader& h, const char* page, int size)
+{
+  unsigned sum = 2166136261u;
+  const char* p = (const char*) &h.pid;
+
+  for (unsigned i = 0; i < sizeof(h.pid) + sizeof(h.commit); i++) sum = (sum ^ (unsigned char)p[i]) * 16777619u;
+  for (int i = 0; i < size; i++) sum = (sum ^ (unsigned char)page[i]) * 16777619u;
+  return sum;
+}
+
+PageLog::PageLog()
+{
+  fd = -1;
+  pageSize = 0;
+  writable = false;
+  end = committed = synced = 0;
+  lastSync = 0;
+  syncing = false;
+  groupCommitDelay = DEFAULT_GROUP_COMMIT_DELAY;
+}
+
+PageLog::~PageLog()
+{
+  if (fd >= 0) close();
+}
+
+RC PageLog::open(const string& filename, int size, bool w)
+{
+  struct stat statbuf;
+  LogHeader   header;
+  FrameHeader frame;
+  off_t       offset;
+  std::vector<char> page(size);
+
+  if (fd >= 0) return RC_FILE_OPEN_FAILED;
+
+  if ((fd = ::open(filename.c_str(), w ? (O_RDWR|O_CREAT) : O_RDONLY, 0644)) < 0) {
+    fd = -1;
+    return RC_FILE_OPEN_FAILED;
+  }
+  name = filename;
+  pageSize = size;
+  writable = w;
+  index.clear();
+  pending.clear();
+
+  if (::fstat(fd, &statbuf) < 0) goto fail;
+
+  // a new log starts with its header
+  if (statbuf.st_size == 0) {
+    if (!writable) goto fail;
+    header.magic = LOG_MAGIC;
+    header.pageSize = pageSize;
+    if (::pwrite(fd, &header, sizeof(header), 0) != sizeof(header)) goto fail;
+    end = committed = synced = sizeof(header);
+    lastSync = IOStats::now();
+    return 0;
+  }
+
+  if (::pread(fd, &header, sizeof(header), 0) != sizeof(header) ||
+      header.magic != LOG_MAGIC || header.pageSize != pageSize) {
+    ::close(fd);
+    fd = -1;
+    return RC_INVALID_FILE_FORMAT;
+  }
+
+  // index the frames up to the last commit frame. the log ends at the
+  // first frame that is torn or missing
+  committed = sizeof(header);
+  for (offset = sizeof(header); ; ) {
+    if (::pread(fd, &frame, sizeof(frame), offset) != sizeof(frame)) break;
+    if (frame.magic != LOG_MAGIC) break;
+    int length = (frame.pid >= 0) ? pageSize : 0;
+    if (length > 0 && ::pread(fd, &page[0], length, offset + sizeof(frame)) != length) break;
+    if (checksum(frame, &page[0], length) != frame.checksum) break;
+
+    if (frame.pid >= 0) pending[frame.pid] = offset;
+    offset += sizeof(frame) + length;
+    if (frame.commit) {
+      for (map<PageId, off_t>::iterator it = pending.begin(); it != pending.end(); ++it) {
+        index[it->first] = it->second;
+      }
+      pending.clear();
+      committed = offset;
+    }
+  }
+  pending.clear();
+
+  // the frames of a transaction that did not commit are dropped
+  if (writable && statbuf.st_size > committed) {
+    if (::ftruncate(fd, committed) < 0) goto fail;
+  }
+  end = synced = committed;
+  lastSync = IOStats::now();
+  return 0;
+
+ fail:
+  ::close(fd);
+  fd = -1;
+  return RC_FILE_OPEN_FAILED;
+}
+
+RC PageLog::close()
+{
+  RC rc = 0;
+
+  if (fd < 0) return RC_FILE_CLOSE_FAILED;
+
+  if (writable && (rc = sync()) == 0 && index.empty() && pending.empty()) {
+    ::unlink(name.c_str());
+  }
+  if (::close(fd) < 0 && rc == 0) rc = RC_FILE_CLOSE_FAILED;
+
+  fd = -1;
+  index.clear();
+  pending.clear();
+  return rc;
+}
+
+RC PageLog::append(PageId pid, char* const* pages, int count)
+{
+  unique_lock<mutex> guard(lock);
+  struct iovec iov[IOV_MAX];
+
+  if (fd < 0 || !writable) return RC_FILE_WRITE_FAILED;
+
+  // each frame takes two entries: its header and the page
+  std::vector<FrameHeader> frames(count);
+  for (int i = 0; i < count; ) {
+    int n = count - i;
+    if (n > IOV_MAX / 2) n = IOV_MAX / 2;
+
+    for (int k = 0; k < n; k++) {
+      FrameHeader& f = frames[i + k];
+      f.magic = LOG_MAGIC;
+      f.pid = pid + i + k;
+      f.commit = 0;
+      f.checksum = checksum(f, pages[i + k], pageSize);
+      iov[2 * k].iov_base = &f;
+      iov[2 * k].iov_len = sizeof(f);
+      iov[2 * k + 1].iov_base = pages[i + k];
+      iov[2 * k + 1].iov_len = pageSize;
+    }
+
+    ssize_t length = (ssize_t) n * (sizeof(FrameHeader) + pageSize);
+    ssize_t written;
+    do {
+      written = ::pwritev(fd, iov, 2 * n, end);
+    } while (written < 0 && errno == EINTR);
+    if (written != length) return RC_FILE_WRITE_FAILED;
+
+    for (int k = 0; k < n; k++) {
+      pending[pid + i + k] = end + (off_t) k * (sizeof(FrameHeader) + pageSize);
+    }
+    end += length;
+    i += n;
+  }
+
+  return 0;
+}
+
+RC PageLog::commit()
+{
+  unique_lock<mutex> guard(lock);
+  FrameHeader f;
+
+  if (fd < 0 || !writable) return RC_FILE_WRITE_FAILED;
+
+  f.magic = LOG_MAGIC;
+  f.pid = -1;
+  f.commit = 1;
+  f.checksum = checksum(f, NULL, 0);
+  if (::pwrite(fd, &f, sizeof(f), end) != sizeof(f)) return RC_FILE_WRITE_FAILED;
+  end += sizeof(f);
+  committed = end;
+
+  for (map<PageId, off_t>::iterator it = pending.begin(); it != pending.end(); ++it) {
+    index[it->first] = it->second;
+  }
+  pending.clear();
+
+  return syncLocked(guard, committed, true);
+}
+
+RC PageLog::sync()
+{
+  unique_lock<mutex> guard(lock);
+
+  if (fd < 0) return RC_FILE_WRITE_FAILED;
+  return syncLocked(guard, end, false);
+}
+
+RC PageLog::syncLocked(unique_lock<mutex>& guard, off_t upto, bool group)
+{
+  // one thread syncs at a time, without the lock. its sync covers every
+  // frame appended before it starts, so the threads waiting for it often
+  // find their frames synced once it ends
+  while (writable && synced < upto) {
+    if (syncing) {
+      syncDone.wait(guard);
+      continue;
+    }
+    syncing = true;
+
+    // a commit waits out the delay, for the commits meanwhile to join it
+    if (group && groupCommitDelay > 0) {
+      long long wait = lastSync + groupCommitDelay * 1000LL - IOStats::now();
+      if (wait > 0) {
+        guard.unlock();
+        std::this_thread::sleep_for(std::chrono::nanoseconds(wait));
+        guard.lock();
+      }
+    }
+
+    off_t target = end;
+    guard.unlock();
+    int n = ::fdatasync(fd);
+    guard.lock();
+
+    syncing = false;
+    if (n == 0) {
+      if (target > synced) synced = target;
+      lastSync = IOStats::now();
+    }
+    syncDone.notify_all();
+    if (n < 0) return RC_FILE_WRITE_FAILED;
+  }
+  return 0;
+}
+
+RC PageLog::read(PageId pid, void* buffer, bool& found) const
+{
+  unique_lock<mutex> guard(lock);
+  map<PageId, off_t>::const_iterator it;
+
+  // the frame of the running transaction is newer than the committed one
+  found = false;
+  if ((it = pending.find(pid)) == pending.end() && (it = index.find(pid)) == index.end()) {
+    return 0;
+  }
+  found = true;
+
+  ssize_t n;
+  do {
+    n = ::pread(fd, buffer, pageSize, it->second + sizeof(FrameHeader));
+  } while (n < 0 && errno == EINTR);
+  if (n != pageSize) return RC_FILE_READ_FAILED;
+  return 0;
+}
+
+bool PageLog::contains(PageId pid) const
+{
+  unique_lock<mutex> guard(lock);
+
+  return pending.count(pid) > 0 || index.count(pid) > 0;
+}
+
+void PageLog::committedPages(std::vector<PageId>& pids) const
+{
+  unique_lock<mutex> guard(lock);
+
+  pids.clear();
+  for (map<PageId, off_t>::const_iterator it = index.begin(); it != index.end(); ++it) {
+    pids.push_back(it->first);
+  }
+}
+
+RC PageLog::reset()
+{
+  unique_lock<mutex> guard(lock);
+
+  if (fd < 0 || !writable || !pending.empty()) return RC_FILE_WRITE_FAILED;
+  while (syncing) syncDone.wait(guard);
+
+  // the page file is synced before, so the pages are safe without the log
+  if (::ftruncate(fd, sizeof(LogHeader)) < 0) return RC_FILE_WRITE_FAILED;
+  if (::fdatasync(fd) < 0) return RC_FILE_WRITE_FAILED;
+  index.clear();
+  end = committed = synced = sizeof(LogHeader);
+  lastSync = IOStats::now();
+  return 0;
+}
+
+PageId PageLog::endPid() const
+{
+  unique_lock<mutex> guard(lock);
+  PageId last = -1;
+
+  if (!index.empty()) last = index.rbegin()->first;
+  if (!pending.empty() && pending.rbegin()->first > last) last = pending.rbegin()->first;
+  return last + 1;
+}
+
+long long PageLog::size() const
+{
+  unique_lock<mutex> guard(lock);
+
+  return end - (off_t) sizeof(LogHeader);
+}
@@ -0,0 +1,165 @@
+/*
+ * Copyright (C) 2008 by The Regents of the University of California
+ * Redistribution of this file is permitted under the terms of the GNU
+ * Public License (GPL).
+ */
+
+#ifndef PAGELOG_H
+#define PAGELOG_H
+
+#include <string>
+#include <map>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <sys/types.h>
+#include "Bruinbase.h"
+
+typedef int PageId;
+
+/**
+ * The write-ahead log of a PageFile, kept in a file next to it.
+ * The log is a sequence of frames, each holding the new image of one page.
+ * A transaction is the frames written since the previous commit; its
+ * commit() appends a commit frame. Until a checkpoint copies them back,
+ * the latest images of the pages live in the log only, and reads of those
+ * pages are served from it. A crash loses at most the transactions whose
+ * commit frame was not synced, never part of one.
+ * The log has one writer at a time; reads may come from any thread.
+ */
+class PageLog {
+ public:
+  // a checkpoint is taken once the log grows past this many bytes
+  static const long long DEFAULT_CHECKPOINT_SIZE = 4 << 20;
+
+  // a sync waits until this many microseconds have passed since the last
+  // one, so that the commits meanwhile share it, unless
+  // BRUINBASE_GROUP_COMMIT_USEC says otherwise
+  static const int DEFAULT_GROUP_COMMIT_DELAY = 10000;
+
+  PageLog();
+  ~PageLog();
+
+  /**
+   * open the log of a page file, creating it if it does not exist.
+   * the committed frames already in the log are indexed, so that their
+   * pages are read from the log. the frames after the last commit frame
+   * are left over from a crash; a writable log drops them.
+   * @param filename[IN] the name of the log file
+   * @param pageSize[IN] the page size of the page file
+   * @param writable[IN] true if frames will be appended
+   * @return error code. 0 if no error
+   */
+  RC open(const std::string& filename, int pageSize, bool writable);
+
+  /**
+   * close the log. the log file is removed when it holds no frame.
+   * @return error code. 0 if no error
+   */
+  RC close();
+
+  /**
+   * append the images of a run of pages with consecutive ids.
+   * @param pid[IN] the first page of the run
+   * @param pages[IN] the content of each page
+   * @param count[IN] # pages in the run
+   * @return error code. 0 if no error
+   */
+  RC append(PageId pid, char* const* pages, int count);
+
+  /**
+   * append a commit frame, and return once it is synced to the disk.
+   * the commits share syncs: the first one waits out the group commit
+   * delay since the last sync, and its sync also covers the commits that
+   * came in meanwhile, which wait for it.
+   * @return error code. 0 if no error
+   */
+  RC commit();
+
+  /**
+   * sync every frame appended so far to the disk.
+   * @return error code. 0 if no error
+   */
+  RC sync();
+
+  /**
+   * read the latest image of a page from the log.
+   * @param pid[IN] the page to read
+   * @param buffer[OUT] the content of the page
+   * @param found[OUT] false if the log does not hold the page
+   * @return error code. 0 if no error
+   */
+  RC read(PageId pid, void* buffer, bool& found) const;
+
+  /**
+   * @param pid[IN] a page
+   * @return true if the latest image of the page is in the log
+   */
+  bool contains(PageId pid) const;
+
+  /**
+   * @param pids[OUT] the pages whose latest committed image is in the log,
+   *                  in pid order
+   */
+  void committedPages(std::vector<PageId>& pids) const;
+
+  /**
+   * empty the log, once its pages are copied back to the page file.
+   * call this right after commit(), when no frame is pending.
+   * @return error code. 0 if no error
+   */
+  RC reset();
+
+  /**
+   * @return the id of the last page in the log (+ 1). 0 if the log is empty
+   */
+  PageId endPid() const;
+
+  /**
+   * @return # bytes of frames in the log
+   */
+  long long size() const;
+
+  /**
+   * set how long commits wait for others to share their fsync.
+   * @param usec[IN] the delay in microseconds. 0 syncs every commit
+   */
+  void setGroupCommitDelay(int usec) { groupCommitDelay = (usec > 0) ? usec : 0; }
+
+  /**
+   * @return true if the log is open
+   */
+  bool isOpen() const { return fd >= 0; }
+
+  /**
+   * @return true if frames can be appended to the log
+   */
+  bool isWritable() const { return writable; }
+
+ private:
+  PageLog(const PageLog&);
+  PageLog& operator=(const PageLog&);
+
+  RC syncLocked(std::unique_lock<std::mutex>& guard, off_t upto, bool group);
+
+  int    fd;          // the log file
+  std::string name;   // the name of the log file
+  int    pageSize;    // the page size of the page file
+  bool   writable;    // false if the log is only read
+  off_t  end;         // the offset where the next frame goes
+  off_t  committed;   // the end of the last commit frame
+  off_t  synced;      // the offset up to which the log is on the disk
+  long long lastSync; // when the log was last synced, in nanoseconds
+  bool   syncing;     // true while a thread syncs the log
+  int    groupCommitDelay;  // in microseconds
+
+  // the offset of the latest frame of each page in the log. frames after
+  // the last commit are in pending until the commit
+  std::map<PageId, off_t> index;
+  std::map<PageId, off_t> pending;
+
+  mutable std::mutex lock;
+  std::condition_variable syncDone;  // signaled at the end of each sync
+};
+
+#endif /* PAGELOG_H */
@@ -10,9 +10,91 @@
 #include "Bruinbase.h"
 #include "RecordFile.h"
 #include <cstring>
+#include <cstdlib>
+#include <climits>
+#include <algorithm>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
 
 using std::string;
 
+//
+// the slotted page format
+//
+
+// "BRSP": the first word of a slotted page. a page of fixed slots starts
+// with its record count instead, which is never this large
+static const int SLOTTED_MAGIC = 0x50535242;
+
+// the kinds of slotted pages. row and PAX pages are the data pages
+static const short ROW_PAGE = 1;       // a slot directory and the records
+static const short OVERFLOW_PAGE = 2;  // a part of a long value
+static const short PAX_PAGE = 3;       // the keys, a slot directory and the values
+
+// every slotted page starts with this header.
+// in a row page, the slot directory follows it, and the records (the key
+// followed by the value) are stored from the end of the page down.
+// in a PAX page, the keys of the records follow it packed in an array,
+// then the slot directory, and the values are stored from the end of the
+// page down. new data pages are PAX pages, so that reading the keys does
+// not touch the values.
+// in an overflow page, the part of the value follows the header
+struct SlottedHeader {
+  int   magic;    // SLOTTED_MAGIC
+  short type;     // ROW_PAGE, PAX_PAGE or OVERFLOW_PAGE
+  short count;    // # slots of a data page. 0 for an overflow page
+  int   freeEnd;  // data page: the offset of the lowest record.
+                  // overflow page: # bytes of the value in the page
+  int   next;     // overflow page: the next page of the value (+1). 0 for none
+};
+
+// an entry of the slot directory
+struct Slot {
+  unsigned short offset;  // the offset of the record (row page) or value (PAX page)
+  unsigned short length;  // # bytes stored at the offset, with OVERFLOW_RECORD
+};
+
+// set in the slot of a record whose value is in overflow pages. an
+// OverflowRef takes the place of the value
+static const unsigned short OVERFLOW_RECORD = 0x8000;
+
+struct OverflowRef {
+  int    length;  // # bytes of the value
+  PageId first;   // the first overflow page
+};
+
+//
+// the zone map file: this header, followed by the key range of each page
+//
+
+// "BRZM": the first word of a zone map file
+static const int ZONE_MAGIC = 0x4d5a5242;
+
+struct ZoneHeader {
+  int      magic;  // ZONE_MAGIC
+  int      count;  // # pages in the map
+  RecordId end;    // the end record id of the file the map was saved with
+};
+
+// start an empty PAX page
+static void initDataPage(char* page, int pageSize);
+
+// read the header of a slotted page
+static void getHeader(const char* page, SlottedHeader& header);
+
+// true if the page holds records
+static bool isDataPage(const SlottedHeader& header);
+
+// read the n'th entry of the slot directory of a data page
+static void getSlot(const char* page, const SlottedHeader& header, int n, Slot& slot);
+
+// # bytes free between the slot directory and the values of a data page
+static int getFreeSpace(const char* page);
+
+// add a record to a PAX page that has room for it
+static void addRecord(char* page, int key, const char* data, int length, unsigned short flags);
+
 //
 // helper functions for page manipultation
 //
@@ -20,9 +102,6 @@ using std::string;
 // compute the pointer to the n'th slot in a page
 static char* slotPtr(char* page, int n);
 
-// read the record in the n'th slot in the page
-static void readSlot(const char* page, int n, int& key, std::string& value);
-
 // write the record to the n'th slot in the page
 static void writeSlot(char* page, int n, int key, const std::string& value);
 
@@ -107,20 +186,55 @@ RecordFile::RecordFile()
 {
   erid.pid = 0;
   erid.sid = 0;
+  recordsPerPage = RECORDS_PER_PAGE;
+  slotted = true;
+  zonesValid = zonesDirty = false;
 }
 
 RecordFile::RecordFile(const string& filename, char mode)
 {
+  erid.pid = 0;
+  erid.sid = 0;
+  recordsPerPage = RECORDS_PER_PAGE;
+  slotted = true;
+  zonesValid = zonesDirty = false;
   open(filename, mode);
 }
 
-RC RecordFile::open(const string& filename, char mode)
+// true if new tables are compressed unless the caller says otherwise
+static bool compressByDefault()
+{
+  const char* env = getenv("BRUINBASE_COMPRESS");
+  return env != NULL && atoi(env) != 0;
+}
+
+RC RecordFile::open(const string& filename, char mode, int pageSize, bool compress)
 {
   RC   rc;
-  char page[PageFile::PAGE_SIZE];
+  char page[PageFile::MAX_PAGE_SIZE];
+  SlottedHeader header;
 
   // open the page file
-  if ((rc = pf.open(filename, mode)) < 0) return rc;
+  if ((rc = pf.open(filename, mode, pageSize)) < 0) return rc;
+
+  // the pages of a table are held in the cache, so that a page filled by
+  // several appends reaches the disk once
+  if (strchr("wWdD", mode) != NULL && (rc = pf.setWriteBack(true)) < 0) {
+    pf.close();
+    return rc;
+  }
+
+  // the pages of a new file are compressed if asked for. a mapped file
+  // is only compressed when the caller asks for it, and then fails
+  if (pf.endPid() == 0 && (compress || (compressByDefault() && strchr("wWdD", mode) != NULL))) {
+    if ((rc = pf.setCompression(true)) < 0) {
+      pf.close();
+      return rc;
+    }
+  }
+
+  // the # slots in a page follows from the page size of the file
+  recordsPerPage = (pf.getPageSize() - sizeof(int)) / (sizeof(int) + MAX_VALUE_LENGTH);
   
   //
   // in the rest of this function, we set the end record id
@@ -130,10 +244,35 @@ RC RecordFile::open(const string& filename, char mode)
   erid.pid = pf.endPid();
 
   // if the end pid is zero, the file is empty.
-  // set the end record id to (0, 0).
+  // set the end record id to (0, 0). a new file is slotted
   if (erid.pid == 0) {
     erid.sid = 0;
-    return 0;
+    slotted = true;
+    return loadZones(filename, mode);
+  }
+
+  // the first page tells the format of the file
+  if ((rc = pf.read(0, page)) < 0) {
+    erid.pid = erid.sid = 0;
+    pf.close();
+    return rc;
+  }
+  getHeader(page, header);
+  slotted = (header.magic == SLOTTED_MAGIC);
+
+  // the end record id of a slotted file follows the last record of the
+  // last data page. the pages after it are overflow pages
+  if (slotted) {
+    do {
+      if ((rc = pf.read(--erid.pid, page)) < 0) {
+        erid.pid = erid.sid = 0;
+        pf.close();
+        return rc;
+      }
+      getHeader(page, header);
+    } while (!isDataPage(header) && erid.pid > 0);
+    erid.sid = header.count;
+    return loadZones(filename, mode);
   }
 
   // obtain # records in the last page to set sid of the end record id.
@@ -148,46 +287,91 @@ RC RecordFile::open(const string& filename, char mode)
 
   // get # records in the last page
   erid.sid = getRecordCount(page);
-  if (erid.sid >= RECORDS_PER_PAGE) {
+  if (erid.sid >= recordsPerPage) {
     // the last page is full. advance the end record id to the next page.
     erid.pid++;
     erid.sid = 0;
   }
   
-  return 0;
+  return loadZones(filename, mode);
 }
 
 RC RecordFile::close()
 {
+  RC rc;
+
+  // the zone map is saved after the pages it describes
+  rc = pf.close();
+  if (rc == 0 && zonesValid && zonesDirty) rc = saveZones();
+
   erid.pid = 0;
   erid.sid = 0;
+  recordsPerPage = RECORDS_PER_PAGE;
+  slotted = true;
+  zones.clear();
+  zonesValid = zonesDirty = false;
+
+  return rc;
+}
 
-  return pf.close();
+RC RecordFile::advise(PageFile::AccessPattern pattern)
+{
+  return pf.advise(pattern);
 }
 
 RC RecordFile::read(const RecordId& rid, int& key, string& value) const
 {
   RC   rc;
-  char page[PageFile::PAGE_SIZE];
-  
-  // check whether the rid is in the valid range
-  if (rid.pid < 0 || rid.pid > erid.pid) return RC_INVALID_RID;
-  if (rid.sid < 0 || rid.sid >= RecordFile::RECORDS_PER_PAGE) return RC_INVALID_RID;
-  if (rid >= erid) return RC_INVALID_RID;
-  
-  // read the page containing the record
-  if ((rc = pf.read(rid.pid, page)) < 0) return rc;
+  std::string_view view;
 
-  // read the record from the slot in the page
-  readSlot(page, rid.sid, key, value);
+  // pin the record in the cache, and copy its value out. a value read from
+  // overflow pages is already in the string
+  if ((rc = pin(rid, key, view, value)) < 0) return rc;
+  if (view.data() != value.data()) value.assign(view.data(), view.size());
+  unpin(rid);
 
   return 0;
 }
 
+RC RecordFile::prefetch(const std::vector<RecordId>& rids) const
+{
+  std::vector<PageId> pids;
+
+  // several records usually share a page. PageFile::prefetch() drops
+  // the duplicates
+  for (unsigned i = 0; i < rids.size(); i++) {
+    if (rids[i].pid >= 0 && rids[i] < erid) pids.push_back(rids[i].pid);
+  }
+  if (pids.empty()) return 0;
+
+  return pf.prefetch(&pids[0], pids.size());
+}
+
 RC RecordFile::append(int key, const std::string& value, RecordId& rid)
+{
+  return appendRecords(&key, &value, 1, &rid);
+}
+
+RC RecordFile::appendBatch(const std::vector<int>& keys, const std::vector<std::string>& values,
+                           std::vector<RecordId>& rids)
+{
+  if (keys.size() != values.size()) return RC_INVALID_ATTRIBUTE;
+
+  rids.resize(keys.size());
+  if (keys.empty()) return 0;
+  return appendRecords(&keys[0], &values[0], keys.size(), &rids[0]);
+}
+
+RC RecordFile::appendRecords(const int* keys, const string* values, int count, RecordId* rids)
 {
   RC   rc;
-  char page[PageFile::PAGE_SIZE];
+  char page[PageFile::MAX_PAGE_SIZE];
+  RecordId last = erid;  // the end record id as of the last page written
+  // the keys added to the page since it was last written. the zone map
+  // takes them once the page is written
+  KeyRange added = { INT_MAX, INT_MIN };
+
+  if (slotted) return appendSlotted(keys, values, count, rids);
 
   // unless we are writing to the the first slot of an empty page,
   // we have to read the page first
@@ -196,33 +380,511 @@ RC RecordFile::append(int key, const std::string& value, RecordId& rid)
   } else {
     // if this is the first slot of an empty page
     // we can simply initialize the page with zeros
-    memset(page, 0, PageFile::PAGE_SIZE);
+    memset(page, 0, pf.getPageSize());
+  }
+
+  for (int i = 0; i < count; i++) {
+    // write the record to the first empty slot 
+    writeSlot(page, erid.sid, keys[i], values[i]);
+
+    // the first four bytes in the page stores # records in the page.
+    // update this number.
+    setRecordCount(page, erid.sid + 1);
+
+    // we need to output the rid of the record slot
+    rids[i] = erid;
+    added.min = std::min(added.min, keys[i]);
+    added.max = std::max(added.max, keys[i]);
+
+    // advance the end record id by one to the next empty slot
+    next(erid);
+
+    // a full page is written once, and the next page starts empty
+    if (erid.sid == 0) {
+      if ((rc = pf.write(erid.pid - 1, page)) < 0) {
+        erid = last;
+        return rc;
+      }
+      widenZone(erid.pid - 1, added);
+      added.min = INT_MAX;
+      added.max = INT_MIN;
+      last = erid;
+      memset(page, 0, pf.getPageSize());
+    }
+  }
+
+  // write the last page, which is not full
+  if (erid != last) {
+    if ((rc = pf.write(erid.pid, page)) < 0) {
+      erid = last;
+      return rc;
+    }
+    widenZone(erid.pid, added);
+  }
+
+  return 0;
+}
+
+void RecordFile::next(RecordId& rid) const
+{
+  // the records of a data page are numbered from 0. the pages without
+  // records are skipped
+  if (slotted) {
+    rid.sid++;
+    while (rid < erid && rid.sid >= recordCount(rid.pid)) {
+      rid.pid++;
+      rid.sid = 0;
+    }
+    return;
+  }
+
+  // if the end of a page is reached, move to the next page
+  if (++rid.sid >= recordsPerPage) {
+    rid.pid++;
+    rid.sid = 0;
+  }
+}
+
+RC RecordFile::pin(const RecordId& rid, int& key, std::string_view& value, string& buffer) const
+{
+  RC   rc;
+  const char* page;
+  SlottedHeader header;
+  Slot slot;
+  OverflowRef ref;
+
+  // check whether the rid is in the valid range
+  if (rid.pid < 0 || rid.sid < 0 || rid >= erid) return RC_INVALID_RID;
+  if (!slotted && rid.sid >= recordsPerPage) return RC_INVALID_RID;
+
+  // pin the page containing the record in the cache
+  if ((rc = pf.pin(rid.pid, page)) < 0) return rc;
+
+  // the value of a fixed slot ends at its first 0
+  if (!slotted) {
+    const char* ptr = slotPtr(const_cast<char*>(page), rid.sid);
+    memcpy(&key, ptr, sizeof(int));
+    value = std::string_view(ptr + sizeof(int), strnlen(ptr + sizeof(int), MAX_VALUE_LENGTH));
+    return 0;
+  }
+
+  // an overflow page has no records
+  getHeader(page, header);
+  if (header.magic != SLOTTED_MAGIC || !isDataPage(header) || rid.sid >= header.count) {
+    pf.unpin(rid.pid);
+    return RC_INVALID_RID;
+  }
+
+  getSlot(page, header, rid.sid, slot);
+  const char* data = page + slot.offset;
+  int length = slot.length & ~OVERFLOW_RECORD;
+  if (slot.offset + length > pf.getPageSize() || (header.type == ROW_PAGE && length < (int) sizeof(int))) {
+    pf.unpin(rid.pid);
+    return RC_INVALID_FILE_FORMAT;
+  }
+
+  // the key of a row page is stored before the value
+  if (header.type == ROW_PAGE) {
+    memcpy(&key, data, sizeof(int));
+    data += sizeof(int);
+    length -= sizeof(int);
+  } else {
+    memcpy(&key, page + sizeof(header) + rid.sid * sizeof(int), sizeof(int));
+  }
+
+  // the value is in the cached page, or in its overflow pages
+  if (slot.length & OVERFLOW_RECORD) {
+    if (length != (int) sizeof(ref)) rc = RC_INVALID_FILE_FORMAT;
+    else {
+      memcpy(&ref, data, sizeof(ref));
+      rc = readOverflow(ref.first, ref.length, buffer);
+    }
+    if (rc < 0) {
+      pf.unpin(rid.pid);
+      return rc;
+    }
+    value = std::string_view(buffer);
+  } else {
+    value = std::string_view(data, length);
+  }
+
+  return 0;
+}
+
+RC RecordFile::unpin(const RecordId& rid) const
+{
+  return pf.unpin(rid.pid);
+}
+
+RC RecordFile::readKey(const RecordId& rid, int& key) const
+{
+  RC   rc;
+  const char* page;
+  SlottedHeader header;
+  Slot slot;
+
+  // check whether the rid is in the valid range
+  if (rid.pid < 0 || rid.sid < 0 || rid >= erid) return RC_INVALID_RID;
+  if (!slotted && rid.sid >= recordsPerPage) return RC_INVALID_RID;
+
+  if ((rc = pf.pin(rid.pid, page)) < 0) return rc;
+
+  // a file of fixed slots stores the key at the start of the slot
+  if (!slotted) {
+    memcpy(&key, slotPtr(const_cast<char*>(page), rid.sid), sizeof(int));
+    pf.unpin(rid.pid);
+    return 0;
   }
-    
-  // write the record to the first empty slot 
-  writeSlot(page, erid.sid, key, value);
 
-  // the first four bytes in the page stores # records in the page.
-  // update this number.
-  setRecordCount(page, erid.sid + 1);
+  getHeader(page, header);
+  if (header.magic != SLOTTED_MAGIC || !isDataPage(header) || rid.sid >= header.count) {
+    pf.unpin(rid.pid);
+    return RC_INVALID_RID;
+  }
 
-  // write the page to the disk
-  if ((rc = pf.write(erid.pid, page)) < 0) return rc;
-    
-  // we need to output the rid of the record slot
-  rid = erid;
+  // only the key array of a PAX page is read
+  if (header.type == PAX_PAGE) {
+    memcpy(&key, page + sizeof(header) + rid.sid * sizeof(int), sizeof(int));
+  } else {
+    getSlot(page, header, rid.sid, slot);
+    if (slot.offset + (int) sizeof(int) > pf.getPageSize()) {
+      pf.unpin(rid.pid);
+      return RC_INVALID_FILE_FORMAT;
+    }
+    memcpy(&key, page + slot.offset, sizeof(int));
+  }
+  pf.unpin(rid.pid);
 
-  // advance the end record id by one to the next empty slot
-  ++erid;
+  return 0;
+}
+
+RC RecordFile::appendSlotted(const int* keys, const string* values, int count, RecordId* rids)
+{
+  RC   rc = 0;
+  char page[PageFile::MAX_PAGE_SIZE];
+  SlottedHeader header;
+  OverflowRef ref;
+  RecordId last = erid;  // the end record id as of the last page written
+  KeyRange added = { INT_MAX, INT_MIN };  // the keys added since, for the zone map
+
+  // the first record of the file starts its first data page. otherwise
+  // the records go to the last data page
+  if (erid.sid == 0) {
+    if ((rc = pf.allocate(erid.pid)) < 0) return rc;
+    last = erid;
+    initDataPage(page, pf.getPageSize());
+  } else {
+    if ((rc = pf.read(erid.pid, page)) < 0) return rc;
+  }
+
+  for (int i = 0; i < count; i++) {
+    const char* data = values[i].data();
+    int  length = values[i].size();
+    unsigned short flags = 0;
+
+    // a long value goes to overflow pages, and the record points to them
+    if ((int) sizeof(int) + length > (pf.getPageSize() - (int) sizeof(SlottedHeader)) / 4) {
+      ref.length = length;
+      if ((rc = writeOverflow(values[i], erid.pid, ref.first)) < 0) break;
+      data = (const char*) &ref;
+      length = sizeof(ref);
+      flags = OVERFLOW_RECORD;
+    }
+
+    // a full page is written once, and followed by a new data page. so is
+    // a row page, which takes no new records
+    getHeader(page, header);
+    if (header.type != PAX_PAGE || getFreeSpace(page) < (int)(sizeof(Slot) + sizeof(int)) + length) {
+      PageId pid;
+      if (erid != last) {
+        if ((rc = pf.write(erid.pid, page)) < 0) break;
+        widenZone(erid.pid, added);
+        last = erid;
+      }
+      added.min = INT_MAX;
+      added.max = INT_MIN;
+      if ((rc = pf.allocate(pid, erid.pid)) < 0) break;
+      erid.pid = pid;
+      erid.sid = 0;
+      initDataPage(page, pf.getPageSize());
+    }
+
+    // add the record and its slot to the page
+    addRecord(page, keys[i], data, length, flags);
+
+    // we need to output the rid of the record slot
+    rids[i] = erid;
+    added.min = std::min(added.min, keys[i]);
+    added.max = std::max(added.max, keys[i]);
+    erid.sid++;
+  }
+
+  // write the last page, which is not full
+  if (rc == 0 && erid != last && (rc = pf.write(erid.pid, page)) == 0) widenZone(erid.pid, added);
+
+  // the records not written are dropped
+  if (rc < 0) erid = last;
+  return rc;
+}
 
+RC RecordFile::readOverflow(PageId first, int length, string& value) const
+{
+  RC   rc;
+  const char* page;
+  SlottedHeader header;
+  PageId pid = first;
+
+  value.clear();
+  value.reserve(length);
+
+  // a chain longer than the file is broken
+  for (int pages = 0; (int) value.size() < length; pages++) {
+    if (pid < 0 || pages >= pf.endPid()) return RC_INVALID_FILE_FORMAT;
+    if ((rc = pf.pin(pid, page)) < 0) return rc;
+
+    getHeader(page, header);
+    int n = header.freeEnd;
+    if (header.magic != SLOTTED_MAGIC || header.type != OVERFLOW_PAGE || n <= 0 ||
+        n > pf.getPageSize() - (int) sizeof(header) || (int) value.size() + n > length) {
+      pf.unpin(pid);
+      return RC_INVALID_FILE_FORMAT;
+    }
+    value.append(page + sizeof(header), n);
+    pf.unpin(pid);
+    pid = header.next - 1;
+  }
+
+  return 0;
+}
+
+RC RecordFile::writeOverflow(const string& value, PageId hint, PageId& first)
+{
+  RC  rc;
+  int perPage = pf.getPageSize() - sizeof(SlottedHeader);
+  int count = (value.size() + perPage - 1) / perPage;
+  std::vector<PageId> pids(count);
+  std::vector<char> pages((size_t) count * pf.getPageSize(), 0);
+  std::vector<PageIO> batch(count);
+
+  // the pages of a value are allocated one after another, so that they
+  // are read in one run
+  for (int i = 0; i < count; i++) {
+    if ((rc = pf.allocate(pids[i], (i == 0) ? hint : pids[i - 1])) < 0) return rc;
+  }
+
+  for (int i = 0; i < count; i++) {
+    char* page = &pages[(size_t) i * pf.getPageSize()];
+    SlottedHeader header;
+    int n = value.size() - (size_t) i * perPage;
+    if (n > perPage) n = perPage;
+
+    header.magic = SLOTTED_MAGIC;
+    header.type = OVERFLOW_PAGE;
+    header.count = 0;
+    header.freeEnd = n;
+    header.next = (i + 1 < count) ? pids[i + 1] + 1 : 0;
+    memcpy(page, &header, sizeof(header));
+    memcpy(page + sizeof(header), value.data() + (size_t) i * perPage, n);
+
+    batch[i].pid = pids[i];
+    batch[i].buffer = page;
+  }
+
+  // write the chain with one batch
+  if ((rc = pf.writev(&batch[0], count)) < 0) return rc;
+  first = pids[0];
   return 0;
 }
 
+int RecordFile::recordCount(PageId pid) const
+{
+  const char* page;
+  SlottedHeader header;
+
+  // the last data page is being filled. its count is in the end record id
+  if (pid == erid.pid) return erid.sid;
+
+  if (pf.pin(pid, page) < 0) return 0;
+  getHeader(page, header);
+  pf.unpin(pid);
+
+  return (header.magic == SLOTTED_MAGIC && isDataPage(header)) ? header.count : 0;
+}
+
 const RecordId& RecordFile::endRid() const
 {
   return erid;
 }
 
+void RecordFile::skipPages(RecordId& rid, int low, int high) const
+{
+  // a page is skipped as a whole, from its first record. a page without
+  // records (min > max) is skipped too
+  if (!zonesValid || rid.sid != 0) return;
+  while (rid < erid && rid.pid < (int) zones.size()) {
+    const KeyRange& zone = zones[rid.pid];
+    if (zone.min <= zone.max && zone.max >= low && zone.min <= high) break;
+    rid.pid++;
+  }
+
+  // the last page of a file of fixed slots may be partly filled
+  if (erid < rid) rid = erid;
+}
+
+RC RecordFile::loadZones(const string& filename, char mode)
+{
+  RC   rc;
+  ZoneHeader header;
+  int  zfd;
+  int  key;
+
+  zoneName = filename + ".zmap";
+  zones.clear();
+  zonesValid = zonesDirty = false;
+
+  // the map is used only if it was saved at the current end of the file
+  if ((zfd = ::open(zoneName.c_str(), O_RDONLY)) >= 0) {
+    ssize_t n = ::pread(zfd, &header, sizeof(header), 0);
+    if (n == sizeof(header) && header.magic == ZONE_MAGIC && header.end == erid &&
+        header.count >= 0 && header.count <= pf.endPid()) {
+      zones.resize(header.count);
+      size_t length = zones.size() * sizeof(KeyRange);
+      n = (length > 0) ? ::pread(zfd, &zones[0], length, sizeof(header)) : 0;
+      zonesValid = (n == (ssize_t) length);
+    }
+    ::close(zfd);
+  }
+  if (zonesValid) return 0;
+  zones.clear();
+
+  // otherwise it is built again from the keys, but only when the file is
+  // written. a reader does without it
+  if (strchr("wWmMdD", mode) == NULL) return 0;
+  for (RecordId rid = { 0, 0 }; rid < erid; next(rid)) {
+    if ((rc = readKey(rid, key)) < 0) {
+      zones.clear();
+      return 0;
+    }
+    widenZone(rid.pid, key);
+  }
+  zonesValid = true;
+  zonesDirty = true;
+
+  return 0;
+}
+
+RC RecordFile::saveZones()
+{
+  ZoneHeader header;
+  int    zfd;
+  string temp = zoneName + ".tmp";
+
+  if ((zfd = ::open(temp.c_str(), O_WRONLY|O_CREAT|O_TRUNC, 0644)) < 0) return RC_FILE_WRITE_FAILED;
+  header.magic = ZONE_MAGIC;
+  header.count = zones.size();
+  header.end = erid;
+
+  size_t length = zones.size() * sizeof(KeyRange);
+  if (::pwrite(zfd, &header, sizeof(header), 0) != sizeof(header) ||
+      (length > 0 && ::pwrite(zfd, &zones[0], length, sizeof(header)) != (ssize_t) length) ||
+      ::fsync(zfd) < 0) {
+    ::close(zfd);
+    ::unlink(temp.c_str());
+    return RC_FILE_WRITE_FAILED;
+  }
+  ::close(zfd);
+
+  if (::rename(temp.c_str(), zoneName.c_str()) < 0) return RC_FILE_WRITE_FAILED;
+  zonesDirty = false;
+  return 0;
+}
+
+void RecordFile::widenZone(PageId pid, int key)
+{
+  KeyRange keys = { key, key };
+  widenZone(pid, keys);
+}
+
+void RecordFile::widenZone(PageId pid, const KeyRange& keys)
+{
+  if (keys.min > keys.max) return;
+  if (pid >= (int) zones.size()) {
+    KeyRange empty = { INT_MAX, INT_MIN };
+    zones.resize(pid + 1, empty);
+  }
+  if (keys.min < zones[pid].min) zones[pid].min = keys.min;
+  if (keys.max > zones[pid].max) zones[pid].max = keys.max;
+  zonesDirty = true;
+}
+
+static void initDataPage(char* page, int pageSize)
+{
+  SlottedHeader header;
+
+  memset(page, 0, pageSize);
+  header.magic = SLOTTED_MAGIC;
+  header.type = PAX_PAGE;
+  header.count = 0;
+  header.freeEnd = pageSize;
+  header.next = 0;
+  memcpy(page, &header, sizeof(header));
+}
+
+static void getHeader(const char* page, SlottedHeader& header)
+{
+  memcpy(&header, page, sizeof(header));
+}
+
+static bool isDataPage(const SlottedHeader& header)
+{
+  return header.type == ROW_PAGE || header.type == PAX_PAGE;
+}
+
+// the offset of the slot directory of a data page
+static int slotsOffset(const SlottedHeader& header)
+{
+  return sizeof(header) + ((header.type == PAX_PAGE) ? header.count * sizeof(int) : 0);
+}
+
+static void getSlot(const char* page, const SlottedHeader& header, int n, Slot& slot)
+{
+  memcpy(&slot, page + slotsOffset(header) + n * sizeof(Slot), sizeof(slot));
+}
+
+static int getFreeSpace(const char* page)
+{
+  SlottedHeader header;
+
+  getHeader(page, header);
+  return header.freeEnd - (int)(slotsOffset(header) + header.count * sizeof(Slot));
+}
+
+static void addRecord(char* page, int key, const char* data, int length, unsigned short flags)
+{
+  SlottedHeader header;
+  Slot slot;
+  char* slots;
+
+  // the slot directory moves up to make room for the new key at the end
+  // of the key array
+  getHeader(page, header);
+  slots = page + slotsOffset(header);
+  memmove(slots + sizeof(int), slots, header.count * sizeof(Slot));
+  memcpy(slots, &key, sizeof(int));
+  slots += sizeof(int);
+
+  // the value goes right below the lowest one, and its slot after the
+  // last slot
+  header.freeEnd -= length;
+  slot.offset = header.freeEnd;
+  slot.length = length | flags;
+  memcpy(page + header.freeEnd, data, length);
+  memcpy(slots + header.count * sizeof(Slot), &slot, sizeof(slot));
+
+  header.count++;
+  memcpy(page, &header, sizeof(header));
+}
+
 static int getRecordCount(const char* page)
 {
   int count;
@@ -247,18 +909,6 @@ static char* slotPtr(char* page, int n)
   return (page+sizeof(int)) + (sizeof(int)+RecordFile::MAX_VALUE_LENGTH)*n;
 }
 
-static void readSlot(const char* page, int n, int& key, std::string& value)
-{
-  // compute the location of the record
-  char *ptr = slotPtr(const_cast<char*>(page), n);
-
-  // read the key 
-  memcpy(&key, ptr, sizeof(int));
-
-  // read the value
-  value.assign(ptr + sizeof(int));
-}
-
 static void writeSlot(char* page, int n, int key, const std::string& value)
 {
   // compute the location of the record
@@ -11,6 +11,8 @@
 #define RECORDFILE_H
 
 #include <string>
+#include <string_view>
+#include <vector>
 #include "PageFile.h"
 
 /**
@@ -26,7 +28,8 @@ typedef struct {
 // helper functions for RecordId
 // 
 
-// RecordId iterators
+// RecordId iterators. these assume RecordFile::RECORDS_PER_PAGE slots per
+// page; use RecordFile::next() for a file with another page size
 RecordId& operator++ (RecordId& rid);
 RecordId  operator++ (RecordId& rid, int);
 
@@ -39,16 +42,26 @@ bool operator== (const RecordId& r1, const RecordId& r2);
 bool operator!= (const RecordId& r1, const RecordId& r2);
 
 /**
- * read/write a record to a file
+ * read/write a record to a file.
+ * a new file is stored in slotted pages: each data page has a directory of
+ * slots, one per record, and the records themselves, of any length. the
+ * sid of a record is its slot in the directory, so the # records of a page
+ * depends on their length. a data page keeps the keys of its records
+ * packed together, apart from the values (PAX), so that readKey() reads
+ * the keys only. a record longer than a quarter of a page keeps
+ * its value in a chain of overflow pages, which hold no records.
+ * files written before the slotted format have RECORDS_PER_PAGE fixed
+ * slots per page, whose values are cut at MAX_VALUE_LENGTH - 1 bytes, and
+ * keep that format.
  */
 class RecordFile {
  public:
 
-  // maximum length of the value field
+  // maximum length of the value field in a file of fixed slots
   static const int MAX_VALUE_LENGTH = 100;  
 
-  // number of record slots per page
-  static const int RECORDS_PER_PAGE = (PageFile::PAGE_SIZE - sizeof(int))/ (sizeof(int) + MAX_VALUE_LENGTH);  
+  // number of fixed record slots per page of the default page size
+  static const int RECORDS_PER_PAGE = (PageFile::DEFAULT_PAGE_SIZE - sizeof(int))/ (sizeof(int) + MAX_VALUE_LENGTH);  
     // Note that we subtract sizeof(int) from PAGE_SIZE because the first
     // four bytes in the page is used to store # records in the page.
 
@@ -56,13 +69,20 @@ class RecordFile {
   RecordFile(const std::string& filename, char mode);
   
   /**
-   * open a file in read or write mode.
-   * when opened in 'w' mode, if the file does not exist, it is created.
+   * open a file in read, write, memory-mapped or direct mode.
+   * when opened in 'w', 'm' or 'd' mode, if the file does not exist, it is created.
    * @param filename[IN] the name of the file to open
-   * @param mode[IN] 'r' for read, 'w' for write
+   * @param mode[IN] 'r' for read, 'w' for write, 'm' for memory-mapped,
+   *                 'd' for direct
+   * @param pageSize[IN] the page size of a new file. 0 for the default
+   *                 (see PageFile::open())
+   * @param compress[IN] true to store the pages of a new file compressed
+   *                 (see PageFile::setCompression()). a new file opened in
+   *                 'w' or 'd' mode is also compressed when the environment
+   *                 variable BRUINBASE_COMPRESS is set to 1
    * @return error code. 0 if no error
    */
-  RC open(const std::string& filename, char mode);
+  RC open(const std::string& filename, char mode, int pageSize = 0, bool compress = false);
 
   /**
    * close the file.
@@ -70,6 +90,13 @@ class RecordFile {
    */
   RC close();
 
+  /**
+   * tell the operating system how the file is about to be accessed.
+   * @param pattern[IN] sequential for table scans, random for index lookups
+   * @return error code. 0 if no error
+   */
+  RC advise(PageFile::AccessPattern pattern);
+
   /**
    * read a record from the file. note that every record is a (key, value) pair.
    * @param rid[IN] the id of the record to read
@@ -79,6 +106,45 @@ class RecordFile {
    */
   RC read(const RecordId& rid, int& key, std::string& value) const;
 
+  /**
+   * read a record without copying it. the value points into the page of
+   * the record, which stays pinned in the cache until unpin(rid).
+   * a value kept in overflow pages is copied to buffer, and the value
+   * points there. a scan should pass the same buffer for every record, so
+   * that it is allocated once.
+   * @param rid[IN] the id of the record to read
+   * @param key[OUT] the record key
+   * @param value[OUT] the record value, valid until unpin(rid)
+   * @param buffer[IN/OUT] where a value from overflow pages is kept
+   * @return error code. 0 if no error. on an error, nothing stays pinned
+   */
+  RC pin(const RecordId& rid, int& key, std::string_view& value, std::string& buffer) const;
+
+  /**
+   * release a record pinned by pin().
+   * @param rid[IN] the pinned record
+   * @return error code. 0 if no error
+   */
+  RC unpin(const RecordId& rid) const;
+
+  /**
+   * read the key of a record only. the value is neither copied nor read
+   * from its overflow pages. use this when a query needs no value.
+   * @param rid[IN] the id of the record to read
+   * @param key[OUT] the record key
+   * @return error code. 0 if no error
+   */
+  RC readKey(const RecordId& rid, int& key) const;
+
+  /**
+   * read the pages holding a set of records into the page cache with one
+   * batch of reads, so that reading the records afterwards does not wait
+   * for the disk one page at a time.
+   * @param rids[IN] the records about to be read
+   * @return error code. 0 if no error
+   */
+  RC prefetch(const std::vector<RecordId>& rids) const;
+
   /**
    * append a new record at the end of the file.
    * note that RecordFile does not have write() function.
@@ -90,6 +156,48 @@ class RecordFile {
    */
   RC append(int key, const std::string& value, RecordId& rid);
 
+  /**
+   * append several records at the end of the file, as if by append() for
+   * each of them in order. each page is filled in memory and written once,
+   * instead of once per record.
+   * @param keys[IN] the record keys
+   * @param values[IN] the record values. values[i] goes with keys[i]
+   * @param rids[OUT] the location of each stored record
+   * @return error code. 0 if no error
+   */
+  RC appendBatch(const std::vector<int>& keys, const std::vector<std::string>& values,
+                 std::vector<RecordId>& rids);
+
+  /**
+   * move the record id to the next record of the file.
+   * in a slotted file, this reads the # records of the page.
+   * @param rid[IN/OUT] the record id to advance
+   */
+  void next(RecordId& rid) const;
+
+  /**
+   * skip the pages that hold no key in [low, high], as told by the zone
+   * map of the file: the smallest and largest key of each page, kept in
+   * the file <filename>.zmap. a scan calls this with each record id it
+   * reaches; only a record id at the first record of a page is moved.
+   * a file opened in 'r' mode whose zone map is missing or older than the
+   * file skips no page.
+   * @param rid[IN/OUT] the record id to advance
+   * @param low[IN] the smallest key the scan looks for
+   * @param high[IN] the largest key the scan looks for
+   */
+  void skipPages(RecordId& rid, int low, int high) const;
+
+  /**
+   * @return # record slots in a page of a file of fixed slots
+   */
+  int getRecordsPerPage() const { return recordsPerPage; }
+
+  /**
+   * @return true if the file is stored in slotted pages
+   */
+  bool isSlotted() const { return slotted; }
+
   /**
    * note the +1 part. The rid of the last record is endRid()-1.
    * @return (last record id + 1) of the RecordFile
@@ -97,8 +205,86 @@ class RecordFile {
   const RecordId& endRid() const;
 
  private:
+  /**
+   * append count records, filling each page in memory.
+   * if a page cannot be written, the records not written yet are dropped.
+   * @param keys[IN] the record keys
+   * @param values[IN] the record values
+   * @param count[IN] # records
+   * @param rids[OUT] the location of each stored record
+   * @return error code. 0 if no error
+   */
+  RC appendRecords(const int* keys, const std::string* values, int count, RecordId* rids);
+
+  /**
+   * append records to a slotted file.
+   */
+  RC appendSlotted(const int* keys, const std::string* values, int count, RecordId* rids);
+
+  /**
+   * read or write a value kept in overflow pages.
+   * @param first[IN/OUT] the first overflow page of the value
+   * @param length[IN] # bytes of the value
+   * @param value[IN/OUT] the value
+   * @param hint[IN] the page the overflow pages should follow
+   * @return error code. 0 if no error
+   */
+  RC readOverflow(PageId first, int length, std::string& value) const;
+  RC writeOverflow(const std::string& value, PageId hint, PageId& first);
+
+  /**
+   * @param pid[IN] a page of a slotted file
+   * @return # records in the page. 0 for an overflow page
+   */
+  int recordCount(PageId pid) const;
+
+  /**
+   * load the zone map of the file. a map that is missing or does not end
+   * at the end record id of the file is built again from the keys, when
+   * the file is opened for writing.
+   * @param filename[IN] the name of the file
+   * @param mode[IN] the mode the file is opened in
+   * @return error code. 0 if no error
+   */
+  RC loadZones(const std::string& filename, char mode);
+
+  /**
+   * save the zone map of the file, replacing the old one.
+   * @return error code. 0 if no error
+   */
+  RC saveZones();
+
+  /**
+   * widen the key range of a page to include a key.
+   * @param pid[IN] the page
+   * @param key[IN] the key of a record in the page
+   */
+  void widenZone(PageId pid, int key);
+
+  // the smallest and largest key of a page. min > max for a page
+  // without records
+  struct KeyRange {
+    int min;
+    int max;
+  };
+
+  /**
+   * widen the key range of a page to include a range of keys. an empty
+   * range leaves it as it is.
+   * @param pid[IN] the page
+   * @param keys[IN] the keys of records written to the page
+   */
+  void widenZone(PageId pid, const KeyRange& keys);
+
   PageFile pf;     // the PageFile used to store the records
   RecordId erid;   // the last record id of the file + 1
+  int recordsPerPage;  // # record slots in a page of a file of fixed slots
+  bool slotted;    // true if the file is stored in slotted pages
+
+  std::vector<KeyRange> zones;  // the key range of each page
+  bool zonesValid; // false if the zone map does not cover every record
+  bool zonesDirty; // true if the zone map changed since it was saved
+  std::string zoneName;  // the name of the zone map file
 };
 
 #endif // RECORDFILE_H
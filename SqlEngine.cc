@@ -12,11 +12,15 @@
 #include <cstdlib>
 #include <iostream>
 #include <fstream>
+#include <algorithm>
+#include <iterator>
+#include <queue>
 #include "Bruinbase.h"
 #include "SqlEngine.h"
 #include "BTreeIndex.h"
 #include "BTreeNode.h"
 #include <limits.h>
+#include <unistd.h>
 
 using namespace std;
 
@@ -24,6 +28,309 @@ using namespace std;
 extern FILE* sqlin;
 int sqlparse(void);
 
+// compare a key with the value of a condition: < 0, 0 or > 0. unlike their
+// difference, this does not overflow for keys far apart
+static int compareKey(int key, int value)
+{
+  return (key > value) - (key < value);
+}
+
+// the range [low, high] of keys the key conditions allow. the range is
+// empty when low > high. <> does not narrow it
+static void keyRange(const vector<SelCond>& cond, long long& low, long long& high)
+{
+  low = INT_MIN;
+  high = INT_MAX;
+  for (unsigned i = 0; i < cond.size(); i++) {
+    if (cond[i].attr != 1) continue;
+    long long v = atoi(cond[i].value);
+    switch (cond[i].comp) {
+      case SelCond::EQ:
+        low = max(low, v);
+        high = min(high, v);
+        break;
+      case SelCond::GT:
+        low = max(low, v + 1);
+        break;
+      case SelCond::GE:
+        low = max(low, v);
+        break;
+      case SelCond::LT:
+        high = min(high, v - 1);
+        break;
+      case SelCond::LE:
+        high = min(high, v);
+        break;
+      default:
+        break;
+    }
+  }
+}
+
+// the range [low, high] of value index keys the value conditions allow.
+// a key is a prefix of the values, so the range holds all the values that
+// meet the conditions, and some that do not. return false if no condition
+// narrows the range
+static bool valueRange(const vector<SelCond>& cond, ValueKey& low, ValueKey& high)
+{
+  bool narrowed = false;
+  low = KeyTraits<ValueKey>::lowest();
+  high = KeyTraits<ValueKey>::highest();
+  for (unsigned i = 0; i < cond.size(); i++) {
+    if (cond[i].attr != 2 || cond[i].comp == SelCond::NE) continue;
+    ValueKey v(cond[i].value);
+    if (cond[i].comp != SelCond::LT && cond[i].comp != SelCond::LE &&
+        KeyTraits<ValueKey>::compare(v, low) > 0) low = v;
+    if (cond[i].comp != SelCond::GT && cond[i].comp != SelCond::GE &&
+        KeyTraits<ValueKey>::compare(v, high) < 0) high = v;
+    narrowed = true;
+  }
+  return narrowed;
+}
+
+// add the RecordIds of the index entries with keys in [low, high] to rids
+template<typename Key>
+static RC collectRids(BasicBTreeIndex<Key>& index, const Key& low, const Key& high,
+                      vector<RecordId>& rids)
+{
+  IndexCursor cursor;
+  Key key;
+  RecordId rid;
+  RC rc;
+
+  if (KeyTraits<Key>::compare(low, high) > 0) return 0;
+  index.locate(low, cursor);
+  // the last leaf points to page 0, the index header
+  while (cursor.pid != 0) {
+    if ((rc = index.readForward(cursor, key, rid)) < 0) return rc;
+    if (KeyTraits<Key>::compare(key, high) > 0) break;
+    rids.push_back(rid);
+    if (cursor.eid > index.GetKeycount(cursor.pid)) {
+      cursor.eid = 1;
+      cursor.pid = index.GetNextpid(cursor.pid);
+    }
+  }
+  return 0;
+}
+
+// true if the tuple meets all the conditions
+static bool meetsConds(const vector<SelCond>& cond, int key, string_view value)
+{
+  for (unsigned i = 0; i < cond.size(); i++) {
+    int diff = (cond[i].attr == 1) ? compareKey(key, atoi(cond[i].value))
+                                   : value.compare(cond[i].value);
+    switch (cond[i].comp) {
+      case SelCond::EQ: if (diff != 0) return false; break;
+      case SelCond::NE: if (diff == 0) return false; break;
+      case SelCond::GT: if (diff <= 0) return false; break;
+      case SelCond::LT: if (diff >= 0) return false; break;
+      case SelCond::GE: if (diff < 0) return false; break;
+      case SelCond::LE: if (diff > 0) return false; break;
+    }
+  }
+  return true;
+}
+
+// orders index entries by key, and entries with equal keys by record
+template<typename Key>
+struct EntryLess {
+  bool operator()(const pair<Key, RecordId>& a, const pair<Key, RecordId>& b) const {
+    int c = KeyTraits<Key>::compare(a.first, b.first);
+    return c < 0 || (c == 0 && a.second < b.second);
+  }
+};
+
+// orders the runs of an EntrySorter by their next entries, the least on top
+template<typename Key>
+struct RunGreater {
+  bool operator()(const pair<pair<Key, RecordId>, unsigned>& a,
+                  const pair<pair<Key, RecordId>, unsigned>& b) const {
+    return EntryLess<Key>()(b.first, a.first);
+  }
+};
+
+// sorts the index entries of a load, for BTreeIndex::bulkLoad(). the
+// entries are sorted LOAD_BUFFER at a time in memory, and each full
+// buffer is spilled as a sorted run to a temporary file. next() merges
+// the runs, so the whole index is still built bottom up however many
+// entries there are
+template<typename Key>
+class EntrySorter : public IndexEntryStream<Key> {
+ public:
+  // the run files are named after prefix, and removed once opened
+  EntrySorter(const string& prefix) : prefix(prefix), pos(0) {}
+
+  ~EntrySorter()
+  {
+    for (unsigned i = 0; i < runs.size(); i++) fclose(runs[i]);
+  }
+
+  // add an entry, and spill the buffer once it is full
+  RC add(const Key& key, const RecordId& rid)
+  {
+    entries.push_back(make_pair(key, rid));
+    if (entries.size() < (unsigned) SqlEngine::LOAD_BUFFER) return 0;
+    return spill();
+  }
+
+  // sort the entries left in the buffer, and start the merge. the buffer
+  // is the last run
+  RC finish()
+  {
+    RC rc;
+
+    sort(entries.begin(), entries.end(), EntryLess<Key>());
+    for (unsigned i = 0; i < runs.size(); i++) {
+      if (fseek(runs[i], 0, SEEK_SET) < 0) return RC_FILE_SEEK_FAILED;
+    }
+    for (unsigned i = 0; i <= runs.size(); i++) {
+      if ((rc = pushRun(i)) < 0) return rc;
+    }
+    return 0;
+  }
+
+  RC next(Key& key, RecordId& rid)
+  {
+    if (heads.empty()) return RC_END_OF_TREE;
+    key = heads.top().first.first;
+    rid = heads.top().first.second;
+    unsigned run = heads.top().second;
+    heads.pop();
+    return pushRun(run);
+  }
+
+ private:
+  static const int ENTRY_SIZE = KeyTraits<Key>::WIDTH + sizeof(RecordId);
+
+  // write the sorted buffer to a new run file
+  RC spill()
+  {
+    char entry[ENTRY_SIZE];
+    char name[32];
+
+    snprintf(name, sizeof(name), ".run%u", (unsigned) runs.size());
+    FILE* f = fopen((prefix + name).c_str(), "w+b");
+    if (f == NULL) return RC_FILE_OPEN_FAILED;
+    // the open file outlives its name, and goes away with the sorter
+    unlink((prefix + name).c_str());
+    runs.push_back(f);
+    setvbuf(f, NULL, _IOFBF, 1 << 16);
+
+    sort(entries.begin(), entries.end(), EntryLess<Key>());
+    for (unsigned i = 0; i < entries.size(); i++) {
+      KeyTraits<Key>::write(entry, entries[i].first);
+      memcpy(entry + KeyTraits<Key>::WIDTH, &entries[i].second, sizeof(RecordId));
+      if (fwrite(entry, ENTRY_SIZE, 1, f) != 1) return RC_FILE_WRITE_FAILED;
+    }
+    entries.clear();
+    return 0;
+  }
+
+  // put the next entry of a run on the heap, if the run has one. the
+  // run after the files is the buffer
+  RC pushRun(unsigned run)
+  {
+    char entry[ENTRY_SIZE];
+    pair<Key, RecordId> e;
+
+    if (run == runs.size()) {
+      if (pos == entries.size()) return 0;
+      e = entries[pos++];
+    } else {
+      if (fread(entry, ENTRY_SIZE, 1, runs[run]) != 1) {
+        return ferror(runs[run]) ? RC_FILE_READ_FAILED : 0;
+      }
+      e.first = KeyTraits<Key>::read(entry);
+      memcpy(&e.second, entry + KeyTraits<Key>::WIDTH, sizeof(RecordId));
+    }
+    heads.push(make_pair(e, run));
+    return 0;
+  }
+
+  string prefix;
+  vector<pair<Key, RecordId> > entries;
+  // the next entry of the buffer to merge
+  unsigned pos;
+  vector<FILE*> runs;
+  priority_queue<pair<pair<Key, RecordId>, unsigned>,
+                 vector<pair<pair<Key, RecordId>, unsigned> >, RunGreater<Key> > heads;
+};
+
+/*
+ * Run a select with a condition on the value column through the value
+ * index of the table. The value index gives the records whose values
+ * may meet the conditions; with conditions on the key column too, the key
+ * index, if keyindex is not NULL, narrows them down further. The records
+ * are then read in the order of the table, and checked against all the
+ * conditions.
+ */
+static RC selectByValue(int attr, const string& table, const vector<SelCond>& cond,
+                        ValueIndex& valueindex, BTreeIndex* keyindex)
+{
+  RecordFile rf;
+  RC rc;
+  int key;
+  string_view value;
+  string buffer;
+  int count = 0;
+  vector<RecordId> rids;
+  ValueKey vlow, vhigh;
+  long long low, high;
+
+  valueRange(cond, vlow, vhigh);
+  if ((rc = collectRids(valueindex, vlow, vhigh, rids)) < 0) return rc;
+  sort(rids.begin(), rids.end());
+
+  // keep the records the key index has too
+  keyRange(cond, low, high);
+  if (keyindex != NULL && (low > INT_MIN || high < INT_MAX)) {
+    vector<RecordId> keyrids;
+    if (low <= high && (rc = collectRids(*keyindex, (int) low, (int) high, keyrids)) < 0) return rc;
+    sort(keyrids.begin(), keyrids.end());
+    vector<RecordId> both;
+    set_intersection(rids.begin(), rids.end(), keyrids.begin(), keyrids.end(), back_inserter(both));
+    rids.swap(both);
+  }
+
+  if ((rc = rf.open(table + ".tbl", 'r')) < 0) {
+    fprintf(stderr, "Error: table %s does not exist\n", table.c_str());
+    return rc;
+  }
+  for (unsigned i = 0; i < rids.size(); i++) {
+    // read the pages of the next records in one batch
+    if (i % SqlEngine::PREFETCH_BATCH == 0) {
+      unsigned end = min((unsigned) rids.size(), i + SqlEngine::PREFETCH_BATCH);
+      rf.prefetch(vector<RecordId>(rids.begin() + i, rids.begin() + end));
+    }
+    if ((rc = rf.pin(rids[i], key, value, buffer)) < 0) {
+      fprintf(stderr, "Error: while reading a tuple from table %s\n", table.c_str());
+      rf.close();
+      return rc;
+    }
+    value = value.substr(0, value.find('\0'));
+    if (meetsConds(cond, key, value)) {
+      count++;
+      switch (attr) {
+        case 1:  // SELECT key
+          fprintf(stdout, "%d\n", key);
+          break;
+        case 2:  // SELECT value
+          fprintf(stdout, "%.*s\n", (int) value.size(), value.data());
+          break;
+        case 3:  // SELECT *
+          fprintf(stdout, "%d '%.*s'\n", key, (int) value.size(), value.data());
+          break;
+      }
+    }
+    rf.unpin(rids[i]);
+  }
+  if (attr == 4) {
+    fprintf(stdout, "%d\n", count);
+  }
+  rf.close();
+  return 0;
+}
+
 
 RC SqlEngine::run(FILE* commandline)
 {
@@ -40,8 +347,13 @@ RC SqlEngine::run(FILE* commandline)
 RC SqlEngine::select(int attr, const string& table, const vector<SelCond>& cond)
 {
     vector<SelCond> sortedcond;
-    vector<SelCond>::iterator it;
-    it = sortedcond.begin();
+    
+    // the value column is read only when the query prints or compares it.
+    // otherwise only the keys of the records are read
+    bool needValue = (attr == 2 || attr == 3);
+    for (unsigned i = 0; i < cond.size(); i++) {
+        if (cond[i].attr == 2) needValue = true;
+    }
     
     // sort the condition vetor
     int condcount = 0;
@@ -49,9 +361,8 @@ RC SqlEngine::select(int attr, const string& table, const vector<SelCond>& cond)
     {
         if(cond[i].attr == 1 && cond[i].comp != SelCond::NE)
         {
-            sortedcond.insert(it, cond[i]);
+            sortedcond.insert(sortedcond.begin(), cond[i]);
             condcount++;
-            it = sortedcond.begin();
         }
         else
         {
@@ -60,19 +371,34 @@ RC SqlEngine::select(int attr, const string& table, const vector<SelCond>& cond)
     }
     
     
+    // a condition on the value column is looked up in the value index, if
+    // the table has one. an equality on the key leaves fewer records to
+    // read, so it goes to the key index instead when there is one
+    // the key index is opened once, for whichever of the two runs
     BTreeIndex indexfile;
+    bool keyindexed = (condcount > 0) && (indexfile.open(table+".idx", 'r')>=0);
+    ValueKey vlow, vhigh;
+    ValueIndex valueindex;
+    long long klow, khigh;
+    keyRange(cond, klow, khigh);
+    if (valueRange(cond, vlow, vhigh) && !(klow >= khigh && keyindexed) &&
+        valueindex.open(table + ".vdx", 'r') == 0) {
+        return selectByValue(attr, table, cond, valueindex, keyindexed ? &indexfile : NULL);
+    }
     
+
     IndexCursor initial_cursor;
     initial_cursor.pid = 1;
     initial_cursor.eid = 1;
     
+    // without an upper bound the scan runs to the end of the last leaf
     IndexCursor end_cursor;
-    end_cursor.pid = indexfile.GetLfEpid();
-    end_cursor.eid = indexfile.GetKeycount(end_cursor.pid);
+    end_cursor.pid = 0;
+    end_cursor.eid = 1;
     int leftvalue = INT_MIN;
     int rightvalue = INT_MAX;
     
-    if((condcount > 0) && (indexfile.open(table+".idx", 'r')>=0))
+    if(keyindexed)
     {
         for (int i = 0; i < condcount; i++)
         {
@@ -125,35 +451,66 @@ RC SqlEngine::select(int attr, const string& table, const vector<SelCond>& cond)
                 }
             }
         }
-        int num;
+        int num = 0;
         int   diff;
         int key;
         RecordId rid;
         RC rc;
-        string value;
+        string_view value;  // points into the pinned page of the record
+        string buffer;      // holds a value read from overflow pages
+        bool pinned = false;
         RecordFile rf;
         if ((rc = rf.open(table + ".tbl", 'r')) < 0) {
             fprintf(stderr, "Error: table %s does not exist\n", table.c_str());
             return rc;
         }
+        // the index hands out record ids in key order, not in page order
+        rf.advise(PageFile::ACCESS_RANDOM);
         
-        while(initial_cursor.pid != end_cursor.pid || initial_cursor.eid != end_cursor.eid)
+        // look PREFETCH_BATCH entries ahead in the index and read the
+        // pages they point to in one batch, instead of one page at a time
+        IndexCursor ahead = initial_cursor;
+        vector<int> aheadkeys;
+        vector<RecordId> aheadrids;
+        int prefetched = 0;
+        
+        // the next node pointer of the last leaf is 0, the index header page.
+        // a scan without an upper bound ends there
+        while(initial_cursor.pid != 0 &&
+              (initial_cursor.pid != end_cursor.pid || initial_cursor.eid != end_cursor.eid))
         {
-            indexfile.readForward(initial_cursor,key,rid);
+            if (needValue && prefetched == 0)
+            {
+                indexfile.readForwardBatch(ahead, end_cursor, PREFETCH_BATCH, aheadkeys, aheadrids);
+                rf.prefetch(aheadrids);
+                prefetched = aheadrids.size();
+            }
+            if (prefetched > 0) prefetched--;
             
-            if ((rc = rf.read(rid, key, value)) < 0) {
-                fprintf(stderr, "Error: while reading a tuple from table %s\n", table.c_str());
+            if ((rc = indexfile.readForward(initial_cursor,key,rid)) < 0) {
+                fprintf(stderr, "Error: while reading the index of table %s\n", table.c_str());
                 goto exit_select;
             }
             
+            // the index has the key. the table is read for the value only,
+            // in place in its page until the tuple is done
+            if (needValue) {
+                if ((rc = rf.pin(rid, key, value, buffer)) < 0) {
+                    fprintf(stderr, "Error: while reading a tuple from table %s\n", table.c_str());
+                    goto exit_select;
+                }
+                pinned = true;
+                value = value.substr(0, value.find('\0'));
+            }
+            
             for (unsigned i = 1; i < sortedcond.size(); i++) {
                 // compute the difference between the tuple value and the condition value
                 switch (sortedcond[i].attr) {
                     case 1:
-                        diff = key - atoi(sortedcond[i].value);
+                        diff = compareKey(key, atoi(sortedcond[i].value));
                         break;
                     case 2:
-                        diff = strcmp(value.c_str(), sortedcond[i].value);
+                        diff = value.compare(sortedcond[i].value);
                         break;
                 }
                 
@@ -189,15 +546,19 @@ RC SqlEngine::select(int attr, const string& table, const vector<SelCond>& cond)
                     fprintf(stdout, "%d\n", key);
                     break;
                 case 2:  // SELECT value
-                    fprintf(stdout, "%s\n", value.c_str());
+                    fprintf(stdout, "%.*s\n", (int) value.size(), value.data());
                     break;
                 case 3:  // SELECT *
-                    fprintf(stdout, "%d '%s'\n", key, value.c_str());
+                    fprintf(stdout, "%d '%.*s'\n", key, (int) value.size(), value.data());
                     break;
             }
             
             // move to the next tuple
         next_tuple:
+            if (pinned) {
+                rf.unpin(rid);
+                pinned = false;
+            }
             if(initial_cursor.eid > indexfile.GetKeycount(initial_cursor.pid))
             {
                 initial_cursor.eid = 1;
@@ -211,6 +572,7 @@ RC SqlEngine::select(int attr, const string& table, const vector<SelCond>& cond)
         rc = 0;
         
     exit_select:
+        if (pinned) rf.unpin(rid);
         rf.close();
         return rc;
         
@@ -223,10 +585,22 @@ RC SqlEngine::select(int attr, const string& table, const vector<SelCond>& cond)
         
         RC     rc;
         int    key;
-        string value;
+        string_view value;  // points into the pinned page of the record
+        string buffer;      // holds a value read from overflow pages
+        bool   pinned = false;
         int    count;
         int    diff;
         
+        // the range of keys the conditions allow. the pages of the table
+        // whose keys all fall outside it are skipped
+        long long low, high;
+        keyRange(cond, low, high);
+        if (low > high) {
+            // no key meets the conditions
+            low = INT_MAX;
+            high = INT_MIN;
+        }
+        
         // open the table file
         if ((rc = rf.open(table + ".tbl", 'r')) < 0) {
             fprintf(stderr, "Error: table %s does not exist\n", table.c_str());
@@ -234,24 +608,32 @@ RC SqlEngine::select(int attr, const string& table, const vector<SelCond>& cond)
         }
         
         // scan the table file from the beginning
+        rf.advise(PageFile::ACCESS_SEQUENTIAL);
         rid.pid = rid.sid = 0;
+        rf.skipPages(rid, low, high);
         count = 0;
         while (rid < rf.endRid()) {
-            // read the tuple
-            if ((rc = rf.read(rid, key, value)) < 0) {
+            // read the key only, or pin the tuple and look at its value in
+            // place, so that a tuple failing the conditions is never copied
+            rc = needValue ? rf.pin(rid, key, value, buffer) : rf.readKey(rid, key);
+            if (rc < 0) {
                 fprintf(stderr, "Error: while reading a tuple from table %s\n", table.c_str());
                 goto exit1_select;
             }
+            if (needValue) {
+                pinned = true;
+                value = value.substr(0, value.find('\0'));
+            }
             
             // check the conditions on the tuple
             for (unsigned i = 0; i < cond.size(); i++) {
                 // compute the difference between the tuple value and the condition value
                 switch (cond[i].attr) {
                     case 1:
-                        diff = key - atoi(cond[i].value);
+                        diff = compareKey(key, atoi(cond[i].value));
                         break;
                     case 2:
-                        diff = strcmp(value.c_str(), cond[i].value);
+                        diff = value.compare(cond[i].value);
                         break;
                 }
                 
@@ -288,16 +670,21 @@ RC SqlEngine::select(int attr, const string& table, const vector<SelCond>& cond)
                     fprintf(stdout, "%d\n", key);
                     break;
                 case 2:  // SELECT value
-                    fprintf(stdout, "%s\n", value.c_str());
+                    fprintf(stdout, "%.*s\n", (int) value.size(), value.data());
                     break;
                 case 3:  // SELECT *
-                    fprintf(stdout, "%d '%s'\n", key, value.c_str());
+                    fprintf(stdout, "%d '%.*s'\n", key, (int) value.size(), value.data());
                     break;
             }
             
             // move to the next tuple
         next1_tuple:
-            ++rid;
+            if (pinned) {
+                rf.unpin(rid);
+                pinned = false;
+            }
+            rf.next(rid);
+            rf.skipPages(rid, low, high);
         }
         
         // print matching tuple count if "select count(*)"
@@ -308,6 +695,7 @@ RC SqlEngine::select(int attr, const string& table, const vector<SelCond>& cond)
         
         // close the table file and return
     exit1_select:
+        if (pinned) rf.unpin(rid);
         rf.close();
         return rc;
     }
@@ -315,11 +703,10 @@ RC SqlEngine::select(int attr, const string& table, const vector<SelCond>& cond)
 }
 
 
-RC SqlEngine::load(const string& table, const string& loadfile, bool index)
+RC SqlEngine::load(const string& table, const string& loadfile, bool index, bool valueIndex)
 {
     /* your code here */
     RecordFile rf;
-    RecordId  rid;
     RC rc;
     
     int key;
@@ -334,36 +721,89 @@ RC SqlEngine::load(const string& table, const string& loadfile, bool index)
     string line;
     if(in)
     {
-        if(index)
+        BTreeIndex  tableindex;
+        ValueIndex  valueindex;
+        if(index && (rc = tableindex.open(table+ ".idx" ,'w')) < 0)
         {
-            BTreeIndex  tableindex;
-            tableindex.open(table+ ".idx" ,'w');
-            while(getline(in,line))
-            {
-                parseLoadLine(line,key,value);
-                rf.append(key,value,rid);
-                tableindex.insert(key,rid);
-            }
-            tableindex.close();
+            fprintf(stderr, "Error: cannot open the index of table %s\n", table.c_str());
+            goto exit_load;
         }
-        else
+        if(valueIndex && (rc = valueindex.open(table+ ".vdx" ,'w')) < 0)
+        {
+            fprintf(stderr, "Error: cannot open the value index of table %s\n", table.c_str());
+            goto exit_load;
+        }
+        
+        // the records are appended LOAD_BATCH at a time, so that each page
+        // of the table is written once
+        vector<int> keys;
+        vector<string> values;
+        vector<RecordId> rids;
+        // the index entries, sorted for the bulk loads at the end
+        EntrySorter<int> keyentries(table + ".idx");
+        EntrySorter<ValueKey> valueentries(table + ".vdx");
+        bool more = true;
+        while(more)
         {
-            while(getline(in,line))
+            keys.clear();
+            values.clear();
+            while(keys.size() < (unsigned) LOAD_BATCH && (more = (bool) getline(in,line)))
             {
                 parseLoadLine(line,key,value);
-                rf.append(key,value,rid);
+                keys.push_back(key);
+                values.push_back(value);
+            }
+            if(keys.empty()) break;
+            
+            if((rc = rf.appendBatch(keys,values,rids)) < 0)
+            {
+                fprintf(stderr, "Error: while loading table %s\n", table.c_str());
+                goto exit_load;
+            }
+            if(index)
+            {
+                for(unsigned i = 0; i < keys.size() && rc >= 0; i++) rc = keyentries.add(keys[i],rids[i]);
+                if(rc < 0)
+                {
+                    fprintf(stderr, "Error: while building the index of table %s\n", table.c_str());
+                    goto exit_load;
+                }
+            }
+            if(valueIndex)
+            {
+                // the value as it is read back from the table, up to a 0 byte
+                for(unsigned i = 0; i < values.size() && rc >= 0; i++) rc = valueentries.add(ValueKey(values[i].c_str()),rids[i]);
+                if(rc < 0)
+                {
+                    fprintf(stderr, "Error: while building the value index of table %s\n", table.c_str());
+                    goto exit_load;
+                }
             }
         }
         
+        if(index && ((rc = keyentries.finish()) < 0 || (rc = tableindex.bulkLoad(keyentries)) < 0 || (rc = tableindex.close()) < 0))
+        {
+            fprintf(stderr, "Error: while building the index of table %s\n", table.c_str());
+            goto exit_load;
+        }
+        if(valueIndex && ((rc = valueentries.finish()) < 0 || (rc = valueindex.bulkLoad(valueentries)) < 0 || (rc = valueindex.close()) < 0))
+        {
+            fprintf(stderr, "Error: while building the value index of table %s\n", table.c_str());
+            goto exit_load;
+        }
     }
     else
     {
         fprintf(stderr, "Open loadfile failed!\n");
+        rc = RC_FILE_OPEN_FAILED;
+        goto exit_load;
     }
+    rc = 0;
     
+    exit_load:
     in.close();
     rf.close();
-    return 0;
+    return rc;
 }
 
 RC SqlEngine::parseLoadLine(const string& line, int& key, string& value)
@@ -28,6 +28,16 @@ struct SelCond {
  */
 class SqlEngine {
  public:
+
+  // # index entries whose table pages are read in one batch by an index scan
+  static const int PREFETCH_BATCH = 64;
+
+  // # records of a load file appended to the table at a time
+  static const int LOAD_BATCH = 1024;
+
+  // # index entries of a load sorted in memory at a time. the entries of
+  // a larger load are sorted in runs on disk, and merged into the index
+  static const int LOAD_BUFFER = 1 << 20;
     
   /**
    * takes the user commands from commandline and executes them.
@@ -55,9 +65,12 @@ class SqlEngine {
    * @param table[IN] the table name in the LOAD command
    * @param loadfile[IN] the file name of the load file
    * @param index[IN] true if "WITH INDEX" option was specified
+   * @param valueIndex[IN] true to build an index on the value column too,
+   *                       with "WITH INDEX value". select() uses it for the
+   *                       conditions on the value column
    * @return error code. 0 if no error
    */
-  static RC load(const std::string& table, const std::string& loadfile, bool index);
+  static RC load(const std::string& table, const std::string& loadfile, bool index, bool valueIndex = false);
 
   /**
    * parse a line from the load file into the (key, value) pair.
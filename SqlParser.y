@@ -8,6 +8,7 @@
 #include "Bruinbase.h"
 #include "SqlEngine.h" 
 #include "PageFile.h"
+#include "IOStats.h"
 
 int  sqllex(void);  
 void sqlerror(const char *str) { fprintf(stderr, "Error: %s\n", str); }
@@ -17,7 +18,7 @@ static void runSelect(int attr, const char* table, const std::vector<SelCond>& c
 {
   struct tms tmsbuf;
   clock_t btime, etime;
-  int     bpagecnt, epagecnt;
+  long long bpagecnt, epagecnt;
 
   btime = times(&tmsbuf);
   bpagecnt = PageFile::getPageReadCount();
@@ -25,7 +26,7 @@ static void runSelect(int attr, const char* table, const std::vector<SelCond>& c
   etime = times(&tmsbuf);
   epagecnt = PageFile::getPageReadCount();
 
-  fprintf(stderr, "  -- %.3f seconds to run the select command. Read %d pages\n", ((float)(etime - btime))/sysconf(_SC_CLK_TCK), epagecnt - bpagecnt);
+  fprintf(stderr, "  -- %.3f seconds to run the select command. Read %lld pages\n", ((float)(etime - btime))/sysconf(_SC_CLK_TCK), epagecnt - bpagecnt);
 }
 
 %}
@@ -56,6 +57,7 @@ commands:
 command:
         load_command { fprintf(stdout, "Bruinbase> "); }
 	| select_command { fprintf(stdout, "Bruinbase> "); }
+	| stats_command { fprintf(stdout, "Bruinbase> "); }
 	| quit_command
 	| error LF { fprintf(stdout, "Bruinbase> "); }
 	| LF { fprintf(stdout, "Bruinbase> "); }
@@ -65,6 +67,24 @@ quit_command:
 	QUIT { return 0; }
 	;
 
+stats_command:
+	ID ID LF {
+	  // SHOW STATS prints the i/o statistics of every file, RESET STATS
+	  // sets them to zero. the words are not keywords of the lexer
+	  if (strcmp($2, "stats") != 0) {
+	    fprintf(stderr, "Error: unknown command %s %s\n", $1, $2);
+	  } else if (strcmp($1, "show") == 0) {
+	    IOStats::dump(stdout);
+	  } else if (strcmp($1, "reset") == 0) {
+	    IOStats::resetAll();
+	  } else {
+	    fprintf(stderr, "Error: unknown command %s %s\n", $1, $2);
+	  }
+	  free($1);
+	  free($2);
+	}
+	;
+
 load_command:
 	LOAD table FROM STRING LF { 
 	  SqlEngine::load(std::string($2), std::string($4), false); 
@@ -76,6 +96,19 @@ load_command:
 	  free($2);
 	  free($4);
 	}
+	| LOAD table FROM STRING WITH INDEX ID LF { 
+	  // WITH INDEX value indexes the value column as well as the key
+	  if (strcasecmp($7, "value") == 0) {
+	    SqlEngine::load(std::string($2), std::string($4), true, true); 
+	  } else if (strcasecmp($7, "key") == 0) {
+	    SqlEngine::load(std::string($2), std::string($4), true); 
+	  } else {
+	    fprintf(stderr, "Error: cannot index column %s\n", $7);
+	  }
+	  free($2);
+	  free($4);
+	  free($7);
+	}
 	;
 
 select_command:
@@ -0,0 +1,141 @@
+/*
+ * Copyright (C) 2008 by The Regents of the University of California
+ * Redistribution of this file is permitted under the terms of the GNU
+ * Public License (GPL).
+ */
+
+/*
+ * Batched appends: appendBatch() stores the records as append() would,
+ * in slotted files and in files of fixed slots, with record ids that
+ * follow each other and pages that come out the same; a batch whose keys
+ * and values differ in number is refused and appends nothing.
+ */
+
+#include "RecordFile.h"
+#include "Check.h"
+#include <cstring>
+#include <fcntl.h>
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+static const int RECORDS = 2500;
+
+static string valueOf(int i)
+{
+  int length = (i % 53 == 0) ? 3000 + i : (i * 7) % 90;
+  string value(length, ' ');
+
+  for (int k = 0; k < length; k++) value[k] = 'a' + (i * 31 + k) % 26;
+  return value;
+}
+
+// a file of fixed slots, written before the slotted format, with two
+// records in its one page
+static int writeLegacy(const char* filename)
+{
+  char page[PageFile::DEFAULT_PAGE_SIZE];
+  int count = 2;
+
+  memset(page, 0, sizeof(page));
+  memcpy(page, &count, sizeof(int));
+  for (int i = 0; i < count; i++) {
+    char* slot = page + sizeof(int) + i * (sizeof(int) + RecordFile::MAX_VALUE_LENGTH);
+    int key = -1 - i;
+    memcpy(slot, &key, sizeof(int));
+    strcpy(slot + sizeof(int), "legacy");
+  }
+  int fd = ::open(filename, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  CHECK(fd >= 0);
+  CHECK(::write(fd, page, sizeof(page)) == (ssize_t) sizeof(page));
+  ::close(fd);
+  return 0;
+}
+
+// append the records one at a time to one file, and in batches of
+// growing size to the other, then compare the files
+static int checkFiles(const char* single, const char* batched, bool slotted)
+{
+  RecordFile a, b;
+  RecordId rid;
+  vector<RecordId> rids;
+  vector<int> keys;
+  vector<string> values;
+  int key;
+  string value;
+
+  CHECK(a.open(single, 'w') == 0);
+  CHECK(b.open(batched, 'w') == 0);
+  CHECK(a.isSlotted() == slotted && b.isSlotted() == slotted);
+  RecordId first = a.endRid();
+
+  vector<RecordId> expected(RECORDS);
+  for (int i = 0; i < RECORDS; i++) CHECK(a.append(i, valueOf(i), expected[i]) == 0);
+
+  CHECK(b.appendBatch(keys, values, rids) == 0 && rids.empty());
+  for (int i = 0, size = 1; i < RECORDS; i += size, size *= 2) {
+    keys.clear();
+    values.clear();
+    for (int k = i; k < i + size && k < RECORDS; k++) {
+      keys.push_back(k);
+      values.push_back(valueOf(k));
+    }
+    CHECK(b.appendBatch(keys, values, rids) == 0);
+    CHECK(rids.size() == keys.size());
+    for (unsigned k = 0; k < rids.size(); k++) CHECK(rids[k] == expected[i + k]);
+  }
+
+  // keys and values that do not pair up
+  keys.push_back(0);
+  CHECK(b.appendBatch(keys, values, rids) == RC_INVALID_ATTRIBUTE);
+  CHECK(b.endRid() == a.endRid());
+  CHECK(a.close() == 0);
+  CHECK(b.close() == 0);
+
+  // the records follow each other, and read back the same from both
+  CHECK(a.open(single, 'r') == 0);
+  CHECK(b.open(batched, 'r') == 0);
+  CHECK(b.endRid() == a.endRid());
+  rid = first;
+  for (int i = 0; i < RECORDS; i++) {
+    CHECK(rid == expected[i]);
+    CHECK(b.read(rid, key, value) == 0 && key == i);
+    CHECK(value == (slotted ? valueOf(i) : valueOf(i).substr(0, RecordFile::MAX_VALUE_LENGTH - 1)));
+    string other;
+    CHECK(a.read(rid, key, other) == 0 && key == i && other == value);
+    b.next(rid);
+  }
+  CHECK(rid == b.endRid());
+  CHECK(a.close() == 0);
+  CHECK(b.close() == 0);
+
+  // page for page, the files are the same
+  PageFile pa, pb;
+  char pageA[PageFile::MAX_PAGE_SIZE];
+  char pageB[PageFile::MAX_PAGE_SIZE];
+  CHECK(pa.open(single, 'r') == 0);
+  CHECK(pb.open(batched, 'r') == 0);
+  CHECK(pa.endPid() == pb.endPid());
+  for (PageId pid = 0; pid < pa.endPid(); pid++) {
+    CHECK(pa.read(pid, pageA) == 0 && pb.read(pid, pageB) == 0);
+    CHECK(memcmp(pageA, pageB, pa.getPageSize()) == 0);
+  }
+  CHECK(pa.close() == 0);
+  CHECK(pb.close() == 0);
+  return 0;
+}
+
+int main()
+{
+  if (enterScratchDir() != 0) return 1;
+
+  if (checkFiles("single.tbl", "batched.tbl", true) != 0) return 1;
+
+  if (writeLegacy("single.old") != 0 || writeLegacy("batched.old") != 0) return 1;
+  if (checkFiles("single.old", "batched.old", false) != 0) return 1;
+
+  printf("AppendBatchTest: ok\n");
+  return 0;
+}
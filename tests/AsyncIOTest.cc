@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2008 by The Regents of the University of California
+ * Redistribution of this file is permitted under the terms of the GNU
+ * Public License (GPL).
+ */
+
+/*
+ * Batched reads: a batch larger than the queue depth reads every block
+ * into its buffer, a read past the end of the file reads nothing, and a
+ * read of a bad file fails alone. The pages a PageFile prefetches are
+ * then read from the cache.
+ */
+
+#include "AsyncIO.h"
+#include "PageFile.h"
+#include "Check.h"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <vector>
+
+static const int BLOCK = 512;
+static const int BLOCKS = 3 * AsyncIO::QUEUE_DEPTH + 5;
+static const int PAGES = 100;
+
+// fill a block with a pattern of its number
+static void fill(char* block, int size, int n)
+{
+  for (int i = 0; i < size; i++) block[i] = (char) (n * 7 + i);
+}
+
+int main()
+{
+  char block[BLOCK];
+
+  if (enterScratchDir() != 0) return 1;
+
+  int fd = ::open("blocks", O_RDWR | O_CREAT, 0644);
+  CHECK(fd >= 0);
+  for (int n = 0; n < BLOCKS; n++) {
+    fill(block, BLOCK, n);
+    CHECK(::pwrite(fd, block, BLOCK, (off_t) n * BLOCK) == BLOCK);
+  }
+
+  // the blocks in reverse order, then one past the end and one of a
+  // closed file
+  std::vector<IORequest> reqs(BLOCKS + 2);
+  std::vector<char> buffers((size_t) (BLOCKS + 2) * BLOCK);
+  for (int i = 0; i < BLOCKS + 2; i++) {
+    reqs[i].fd = fd;
+    reqs[i].buffer = &buffers[(size_t) i * BLOCK];
+    reqs[i].length = BLOCK;
+    reqs[i].offset = (off_t) (BLOCKS - 1 - i) * BLOCK;
+    reqs[i].result = -1;
+  }
+  reqs[BLOCKS].offset = (off_t) BLOCKS * BLOCK;
+  reqs[BLOCKS + 1].fd = 1000;
+  CHECK(AsyncIO::engine().readBatch(&reqs[0], BLOCKS + 2) == 0);
+  for (int i = 0; i < BLOCKS; i++) {
+    fill(block, BLOCK, BLOCKS - 1 - i);
+    CHECK(reqs[i].result == BLOCK);
+    CHECK(memcmp(reqs[i].buffer, block, BLOCK) == 0);
+  }
+  CHECK(reqs[BLOCKS].result == 0);
+  CHECK(reqs[BLOCKS + 1].result == -EBADF);
+  ::close(fd);
+
+  // the pages prefetched in one batch are read from the cache
+  PageFile pf;
+  char page[PageFile::MAX_PAGE_SIZE];
+  char expected[PageFile::MAX_PAGE_SIZE];
+  PageId pids[PAGES];
+  CHECK(PageFile::setCacheSize(4 * PAGES) == 0);
+  CHECK(pf.open("async.pf", 'w') == 0);
+  for (PageId pid = 0; pid < PAGES; pid++) {
+    fill(page, pf.getPageSize(), pid);
+    CHECK(pf.write(pid, page) == 0);
+    pids[pid] = PAGES - 1 - pid;
+  }
+  CHECK(pf.close() == 0);
+  CHECK(pf.open("async.pf", 'r') == 0);
+  CHECK(pf.prefetch(pids, PAGES) == 0);
+  int misses = pf.getCacheMissCount();
+  for (PageId pid = 0; pid < PAGES; pid++) {
+    fill(expected, pf.getPageSize(), pid);
+    CHECK(pf.read(pid, page) == 0);
+    CHECK(memcmp(page, expected, pf.getPageSize()) == 0);
+  }
+  CHECK(pf.getCacheMissCount() == misses);
+  CHECK(pf.close() == 0);
+
+  printf("AsyncIOTest: ok\n");
+  return 0;
+}
@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2008 by The Regents of the University of California
+ * Redistribution of this file is permitted under the terms of the GNU
+ * Public License (GPL).
+ */
+
+/*
+ * The page cache: a page read again while it is cached is a hit, the
+ * pages of two files with the same pids are told apart, and a cache much
+ * smaller than the files keeps serving the right pages as it replaces
+ * them.
+ */
+
+#include "PageFile.h"
+#include "Check.h"
+#include <cstring>
+
+static const int CACHE_PAGES = 64;
+static const int PAGES = 200;
+
+// fill a page with a pattern of its file and pid
+static void fill(char* page, int size, int file, PageId pid)
+{
+  for (int i = 0; i < size; i++) page[i] = (char) (file * 101 + pid * 7 + i);
+}
+
+static int checkPage(PageFile& pf, int file, PageId pid)
+{
+  char page[PageFile::MAX_PAGE_SIZE];
+  char expected[PageFile::MAX_PAGE_SIZE];
+
+  fill(expected, pf.getPageSize(), file, pid);
+  CHECK(pf.read(pid, page) == 0);
+  CHECK(memcmp(page, expected, pf.getPageSize()) == 0);
+  return 0;
+}
+
+int main()
+{
+  PageFile files[2];
+  char page[PageFile::MAX_PAGE_SIZE];
+
+  if (enterScratchDir() != 0) return 1;
+  CHECK(PageFile::setCacheSize(0) == RC_INVALID_CACHE_SIZE);
+  CHECK(PageFile::setCacheSize(CACHE_PAGES) == 0);
+
+  CHECK(files[0].open("a.pf", 'w') == 0);
+  CHECK(files[1].open("b.pf", 'w') == 0);
+  for (int f = 0; f < 2; f++) {
+    // read-ahead would fill the cache behind the reader's back
+    files[f].setReadAhead(0);
+    for (PageId pid = 0; pid < PAGES; pid++) {
+      fill(page, files[f].getPageSize(), f, pid);
+      CHECK(files[f].write(pid, page) == 0);
+    }
+  }
+
+  // a page read twice is read from the disk once. the same pid of the
+  // other file is another page
+  int hits = files[0].getCacheHitCount();
+  int misses = files[0].getCacheMissCount();
+  if (checkPage(files[0], 0, 5) != 0) return 1;
+  if (checkPage(files[0], 0, 5) != 0) return 1;
+  CHECK(files[0].getCacheMissCount() <= misses + 1);
+  CHECK(files[0].getCacheHitCount() == hits + 1);
+  if (checkPage(files[1], 1, 5) != 0) return 1;
+
+  // both files, several times the cache, read in turns
+  for (int round = 0; round < 3; round++) {
+    for (PageId pid = 0; pid < PAGES; pid++) {
+      if (checkPage(files[pid % 2], pid % 2, (pid * 37 + round) % PAGES) != 0) return 1;
+    }
+  }
+
+  // the page read at the start has been replaced since
+  misses = files[0].getCacheMissCount();
+  for (PageId pid = 0; pid < PAGES; pid++) {
+    if (checkPage(files[1], 1, pid) != 0) return 1;
+  }
+  if (checkPage(files[0], 0, 5) != 0) return 1;
+  CHECK(files[0].getCacheMissCount() == misses + 1);
+
+  CHECK(files[0].close() == 0);
+  CHECK(files[1].close() == 0);
+
+  printf("BufferPoolTest: ok\n");
+  return 0;
+}
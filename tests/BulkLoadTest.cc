@@ -0,0 +1,237 @@
+/*
+ * Copyright (C) 2008 by The Regents of the University of California
+ * Redistribution of this file is permitted under the terms of the GNU
+ * Public License (GPL).
+ */
+
+/*
+ * Bulk loading: an index built by bulkLoad() holds the same entries as one
+ * built by insert(), for int and string keys at several fill levels, and
+ * takes the inserts that follow the load. A load from a stream holds
+ * every pair of the stream, in order, and a stream that fails part way
+ * leaves an empty index that takes inserts.
+ */
+
+#include "BTreeIndex.h"
+#include "Check.h"
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <utility>
+#include <vector>
+
+using std::pair;
+using std::string;
+using std::vector;
+
+static const int ENTRIES = 12000;
+
+// orders the entries by key, then by RecordId
+template<typename Key>
+struct EntryLess {
+  bool operator()(const pair<Key, RecordId>& a, const pair<Key, RecordId>& b) const {
+    int c = KeyTraits<Key>::compare(a.first, b.first);
+    return c < 0 || (c == 0 && a.second < b.second);
+  }
+};
+
+static int makeKey(unsigned seed, int) { return (int) (seed % 5000) - 2500; }
+
+static ValueKey makeKey(unsigned seed, ValueKey)
+{
+  char value[32];
+  snprintf(value, sizeof(value), "value-%u", seed % 3000);
+  return ValueKey(value);
+}
+
+// random entries with many duplicate keys
+template<typename Key>
+static void makeEntries(int count, unsigned seed, vector<pair<Key, RecordId> >& entries)
+{
+  for (int i = 0; i < count; i++) {
+    seed = seed * 1103515245 + 12345;
+    RecordId rid = { i / 10, i % 10 };
+    entries.push_back(std::make_pair(makeKey(seed >> 8, Key()), rid));
+  }
+}
+
+// every entry of the index, in the order of its leaves
+template<typename Key>
+static int scan(BasicBTreeIndex<Key>& index, vector<pair<Key, RecordId> >& found)
+{
+  IndexCursor cursor;
+  Key key;
+  RecordId rid;
+
+  found.clear();
+  index.locate(KeyTraits<Key>::lowest(), cursor);
+  // the last leaf points to page 0, the index header
+  while (cursor.pid != 0) {
+    if (cursor.eid > index.GetKeycount(cursor.pid)) {
+      cursor.eid = 1;
+      cursor.pid = index.GetNextpid(cursor.pid);
+      continue;
+    }
+    CHECK(index.readForward(cursor, key, rid) == 0);
+    CHECK(found.empty() || KeyTraits<Key>::compare(found.back().first, key) <= 0);
+    found.push_back(std::make_pair(key, rid));
+  }
+  std::sort(found.begin(), found.end(), EntryLess<Key>());
+  return 0;
+}
+
+// check that the two indexes hold the same entries, and find each key
+template<typename Key>
+static int checkSame(const string& loaded, const string& inserted, const vector<pair<Key, RecordId> >& entries)
+{
+  BasicBTreeIndex<Key> a, b;
+  vector<pair<Key, RecordId> > foundA, foundB;
+  IndexCursor cursor;
+  Key key;
+  RecordId rid;
+
+  CHECK(a.open(loaded, 'r') == 0);
+  CHECK(b.open(inserted, 'r') == 0);
+  if (scan(a, foundA) != 0 || scan(b, foundB) != 0) return 1;
+  CHECK(foundA.size() == entries.size() && foundB.size() == entries.size());
+  for (unsigned i = 0; i < entries.size(); i++) {
+    CHECK(KeyTraits<Key>::compare(foundA[i].first, foundB[i].first) == 0);
+    CHECK(foundA[i].second == foundB[i].second);
+  }
+  for (unsigned i = 0; i < entries.size(); i += 5) {
+    CHECK(a.locate(entries[i].first, cursor) == 0);
+    CHECK(a.readForward(cursor, key, rid) == 0);
+    CHECK(KeyTraits<Key>::compare(key, entries[i].first) == 0);
+  }
+  CHECK(a.close() == 0);
+  CHECK(b.close() == 0);
+  return 0;
+}
+
+template<typename Key>
+static int checkLoad(int fillPercent)
+{
+  vector<pair<Key, RecordId> > entries;
+  vector<pair<Key, RecordId> > more;
+  vector<Key> keys;
+  vector<RecordId> rids;
+  BasicBTreeIndex<Key> loaded, inserted;
+
+  makeEntries<Key>(ENTRIES, fillPercent, entries);
+  makeEntries<Key>(ENTRIES / 4, fillPercent + 1, more);
+
+  CHECK(inserted.open("inserted.idx", 'w') == 0);
+  for (unsigned i = 0; i < entries.size(); i++) CHECK(inserted.insert(entries[i].first, entries[i].second) == 0);
+  CHECK(inserted.close() == 0);
+
+  std::sort(entries.begin(), entries.end(), EntryLess<Key>());
+  for (unsigned i = 0; i < entries.size(); i++) {
+    keys.push_back(entries[i].first);
+    rids.push_back(entries[i].second);
+  }
+
+  // the keys must come sorted
+  CHECK(loaded.open("loaded.idx", 'w') == 0);
+  if (keys.size() > 1) {
+    std::swap(keys[0], keys.back());
+    CHECK(loaded.bulkLoad(keys, rids, fillPercent) == RC_INVALID_ATTRIBUTE);
+    std::swap(keys[0], keys.back());
+  }
+  CHECK(loaded.bulkLoad(keys, rids, fillPercent) == 0);
+  CHECK(loaded.close() == 0);
+  if (checkSame<Key>("loaded.idx", "inserted.idx", entries) != 0) return 1;
+
+  // the index takes inserts after the load, and a second load on top of
+  // it is inserted entry by entry
+  CHECK(loaded.open("loaded.idx", 'w') == 0);
+  CHECK(inserted.open("inserted.idx", 'w') == 0);
+  for (unsigned i = 0; i < more.size() / 2; i++) {
+    CHECK(loaded.insert(more[i].first, more[i].second) == 0);
+    CHECK(inserted.insert(more[i].first, more[i].second) == 0);
+  }
+  vector<pair<Key, RecordId> > rest(more.begin() + more.size() / 2, more.end());
+  std::sort(rest.begin(), rest.end(), EntryLess<Key>());
+  keys.clear();
+  rids.clear();
+  for (unsigned i = 0; i < rest.size(); i++) {
+    keys.push_back(rest[i].first);
+    rids.push_back(rest[i].second);
+    CHECK(inserted.insert(rest[i].first, rest[i].second) == 0);
+  }
+  CHECK(loaded.bulkLoad(keys, rids, fillPercent) == 0);
+  CHECK(loaded.close() == 0);
+  CHECK(inserted.close() == 0);
+
+  entries.insert(entries.end(), more.begin(), more.end());
+  std::sort(entries.begin(), entries.end(), EntryLess<Key>());
+  if (checkSame<Key>("loaded.idx", "inserted.idx", entries) != 0) return 1;
+
+  CHECK(unlink("loaded.idx") == 0 && unlink("inserted.idx") == 0);
+  return 0;
+}
+
+// the pairs (i / 3, {i, 0}) for i below count, one at a time. the pair
+// at unsorted has key 0, out of order
+struct CountingStream : public IndexEntryStream<int> {
+  int i, count, unsorted;
+  CountingStream(int count, int unsorted = -1) : i(0), count(count), unsorted(unsorted) {}
+  RC next(int& key, RecordId& rid)
+  {
+    if (i == count) return RC_END_OF_TREE;
+    key = (i == unsorted) ? 0 : i / 3;
+    rid.pid = i++;
+    rid.sid = 0;
+    return 0;
+  }
+};
+
+static int checkStream()
+{
+  vector<pair<int, RecordId> > found;
+  CountingStream stream(ENTRIES * 4);
+  BTreeIndex index;
+
+  CHECK(index.open("stream.idx", 'w') == 0);
+  CHECK(index.bulkLoad(stream) == 0);
+  CHECK(index.close() == 0);
+  CHECK(index.open("stream.idx", 'r') == 0);
+  if (scan<int>(index, found) != 0) return 1;
+  CHECK(index.close() == 0);
+  CHECK(found.size() == (unsigned) stream.count);
+  for (unsigned i = 0; i < found.size(); i++) {
+    CHECK(found[i].first == (int) i / 3 && found[i].second.pid == (int) i);
+  }
+
+  CountingStream unsorted(ENTRIES * 4, ENTRIES * 3);
+  RecordId rid = { 1, 2 };
+  CHECK(index.open("failed.idx", 'w') == 0);
+  CHECK(index.bulkLoad(unsorted) == RC_INVALID_ATTRIBUTE);
+  CHECK(index.close() == 0);
+  CHECK(index.open("failed.idx", 'w') == 0);
+  if (scan<int>(index, found) != 0) return 1;
+  CHECK(found.empty());
+  CHECK(index.insert(7, rid) == 0);
+  CHECK(index.close() == 0);
+  CHECK(index.open("failed.idx", 'r') == 0);
+  if (scan<int>(index, found) != 0) return 1;
+  CHECK(index.close() == 0);
+  CHECK(found.size() == 1 && found[0].first == 7 && found[0].second.pid == 1);
+
+  CHECK(unlink("stream.idx") == 0 && unlink("failed.idx") == 0);
+  return 0;
+}
+
+int main()
+{
+  static const int fills[] = { 50, BTreeIndex::DEFAULT_FILL_PERCENT, 100 };
+
+  if (enterScratchDir() != 0) return 1;
+  for (int i = 0; i < 3; i++) {
+    if (checkLoad<int>(fills[i]) != 0) return 1;
+    if (checkLoad<ValueKey>(fills[i]) != 0) return 1;
+  }
+  if (checkStream() != 0) return 1;
+
+  printf("BulkLoadTest: ok\n");
+  return 0;
+}
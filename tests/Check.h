@@ -0,0 +1,44 @@
+/*
+ * Copyright (C) 2008 by The Regents of the University of California
+ * Redistribution of this file is permitted under the terms of the GNU
+ * Public License (GPL).
+ */
+
+#ifndef CHECK_H
+#define CHECK_H
+
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+
+/**
+ * The checks of the tests. A test is a program that returns 0 when all of
+ * its checks pass; "make test" runs them all.
+ */
+
+// fail the test, from main() or a function returning int, unless cond holds
+#define CHECK(cond)                                                     \
+  do {                                                                  \
+    if (!(cond)) {                                                      \
+      fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+      return 1;                                                         \
+    }                                                                   \
+  } while (0)
+
+/**
+ * move to a new empty directory, so that the files of a test do not meet
+ * those of another one.
+ * @return 0 if no error
+ */
+inline int enterScratchDir()
+{
+  char dir[] = "/tmp/bruinbase-test-XXXXXX";
+
+  if (mkdtemp(dir) == NULL || chdir(dir) < 0) {
+    perror("scratch directory");
+    return 1;
+  }
+  return 0;
+}
+
+#endif /* CHECK_H */
@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2008 by The Regents of the University of California
+ * Redistribution of this file is permitted under the terms of the GNU
+ * Public License (GPL).
+ */
+
+/*
+ * Concurrent readers: several threads read and pin the pages of one
+ * PageFile at once, through a cache much smaller than the file, and each
+ * of them gets the right content every time.
+ */
+
+#include "PageFile.h"
+#include "Check.h"
+#include <atomic>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+static const int CACHE_PAGES = 16;
+static const int PAGES = 256;
+static const int THREADS = 8;
+static const int READS = 4000;
+
+static std::atomic<int> failures(0);
+
+// fill a page with a pattern of the page
+static void fill(char* page, int size, PageId pid)
+{
+  for (int i = 0; i < size; i++) page[i] = (char) (pid * 7 + i);
+}
+
+// read pages in a sequence of the thread's own, every other one pinned
+static void reader(const PageFile* pf, unsigned seed)
+{
+  char page[PageFile::MAX_PAGE_SIZE];
+  char expected[PageFile::MAX_PAGE_SIZE];
+  const char* pinned;
+  int size = pf->getPageSize();
+
+  for (int i = 0; i < READS; i++) {
+    seed = seed * 1103515245 + 12345;
+    PageId pid = (seed >> 8) % PAGES;
+    fill(expected, size, pid);
+    if (i % 2 == 0) {
+      if (pf->read(pid, page) < 0 || memcmp(page, expected, size) != 0) failures++;
+    } else if (pf->pin(pid, pinned) < 0) {
+      failures++;
+    } else {
+      if (memcmp(pinned, expected, size) != 0) failures++;
+      pf->unpin(pid);
+    }
+  }
+}
+
+int main()
+{
+  PageFile pf;
+  char page[PageFile::MAX_PAGE_SIZE];
+  std::vector<std::thread> threads;
+
+  if (enterScratchDir() != 0) return 1;
+  CHECK(PageFile::setCacheSize(CACHE_PAGES) == 0);
+
+  CHECK(pf.open("conc.pf", 'w') == 0);
+  for (PageId pid = 0; pid < PAGES; pid++) {
+    fill(page, pf.getPageSize(), pid);
+    CHECK(pf.write(pid, page) == 0);
+  }
+  CHECK(pf.close() == 0);
+
+  CHECK(pf.open("conc.pf", 'r') == 0);
+  for (int t = 0; t < THREADS; t++) threads.push_back(std::thread(reader, &pf, t + 1));
+  for (int t = 0; t < THREADS; t++) threads[t].join();
+  CHECK(failures == 0);
+  CHECK(pf.getCacheHitCount() + pf.getCacheMissCount() >= THREADS * READS);
+  CHECK(pf.close() == 0);
+
+  printf("ConcurrentReadTest: ok\n");
+  return 0;
+}
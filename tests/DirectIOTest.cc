@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2008 by The Regents of the University of California
+ * Redistribution of this file is permitted under the terms of the GNU
+ * Public License (GPL).
+ */
+
+/*
+ * Direct i/o: the pages of a file opened in 'd' mode round-trip through
+ * buffers of any alignment, at every page size, and read back in a later
+ * open whether or not the file system took O_DIRECT.
+ */
+
+#include "PageFile.h"
+#include "Check.h"
+#include <cstring>
+
+static const int PAGES = 64;
+
+// fill a page with a pattern of the page and the round that wrote it
+static void fill(char* page, int size, PageId pid, int round)
+{
+  for (int i = 0; i < size; i++) page[i] = (char) (pid * 7 + round * 13 + i);
+}
+
+static int checkSize(int size)
+{
+  PageFile pf;
+  // one byte off the start, so that the buffers are not aligned
+  char storage[PageFile::MAX_PAGE_SIZE + 1];
+  char* page = storage + 1;
+  char expected[PageFile::MAX_PAGE_SIZE];
+
+  unlink("direct.pf");
+  CHECK(pf.open("direct.pf", 'd', size) == 0);
+  CHECK(pf.getPageSize() == size);
+  for (PageId pid = 0; pid < PAGES; pid++) {
+    fill(page, size, pid, 1);
+    CHECK(pf.write(pid, page) == 0);
+  }
+  CHECK(pf.flush() == 0);
+  for (PageId pid = 0; pid < PAGES; pid += 2) {
+    fill(page, size, pid, 2);
+    CHECK(pf.write(pid, page) == 0);
+  }
+  CHECK(pf.close() == 0);
+
+  for (int pass = 0; pass < 2; pass++) {
+    CHECK(pf.open("direct.pf", pass == 0 ? 'd' : 'r') == 0);
+    CHECK(pf.getPageSize() == size && pf.endPid() == PAGES);
+    for (PageId pid = 0; pid < PAGES; pid++) {
+      fill(expected, size, pid, (pid % 2 == 0) ? 2 : 1);
+      CHECK(pf.read(pid, page) == 0);
+      CHECK(memcmp(page, expected, size) == 0);
+    }
+    CHECK(pf.close() == 0);
+  }
+  return 0;
+}
+
+int main()
+{
+  if (enterScratchDir() != 0) return 1;
+  CHECK(PageFile::setCacheSize(PAGES / 4) == 0);
+
+  for (int size = PageFile::MIN_PAGE_SIZE; size <= PageFile::MAX_PAGE_SIZE; size *= 4) {
+    if (checkSize(size) != 0) return 1;
+  }
+
+  printf("DirectIOTest: ok\n");
+  return 0;
+}
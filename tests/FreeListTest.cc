@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2008 by The Regents of the University of California
+ * Redistribution of this file is permitted under the terms of the GNU
+ * Public License (GPL).
+ */
+
+/*
+ * The free list of a page file: freed pages are given out again, the one
+ * right after a hint first; the list, however many trunk pages it takes,
+ * is kept in the file across a close, while the pages in use keep their
+ * content; and the space reserved past the end is given back.
+ */
+
+#include "PageFile.h"
+#include "Check.h"
+#include <cstring>
+#include <set>
+#include <sys/stat.h>
+
+static const int PAGES = 1000;
+
+// fill a page with a pattern of the page
+static void fill(char* page, int size, PageId pid)
+{
+  for (int i = 0; i < size; i++) page[i] = (char) (pid * 7 + i);
+}
+
+int main()
+{
+  PageFile pf;
+  PageId pid;
+  char page[PageFile::MAX_PAGE_SIZE];
+  char expected[PageFile::MAX_PAGE_SIZE];
+  std::set<PageId> freed;
+  struct stat statbuf;
+
+  if (enterScratchDir() != 0) return 1;
+
+  // a new file gives out the pages at its end, in order
+  CHECK(pf.open("free.pf", 'w', 1024) == 0);
+  for (PageId i = 0; i < PAGES; i++) {
+    CHECK(pf.allocate(pid) == 0 && pid == i);
+    fill(page, pf.getPageSize(), pid);
+    CHECK(pf.write(pid, page) == 0);
+  }
+  CHECK(pf.getFreePageCount() == 0);
+  CHECK(pf.freePage(-1) == RC_INVALID_PID);
+  CHECK(pf.freePage(PAGES + 10) == RC_INVALID_PID);
+
+  // free every odd page, more than one trunk page holds
+  for (PageId i = 1; i < PAGES; i += 2) {
+    CHECK(pf.freePage(i) == 0);
+    freed.insert(i);
+  }
+  CHECK(pf.getFreePageCount() == PAGES / 2);
+
+  // without a hint the first free page is given out; with one, the free
+  // page right after it, or a new page when none is near
+  CHECK(pf.allocate(pid) == 0 && pid == 1);
+  CHECK(pf.allocate(pid, 100) == 0 && pid == 101);
+  CHECK(pf.allocate(pid, PAGES - 1) == 0 && pid == PAGES);
+  fill(page, pf.getPageSize(), pid);
+  CHECK(pf.write(pid, page) == 0);
+  freed.erase(1);
+  freed.erase(101);
+  CHECK(pf.getFreePageCount() == (int) freed.size());
+
+  // a page given out at the end but never written is not kept
+  CHECK(pf.allocate(pid) == 0 && pid == 3);
+  CHECK(pf.freePage(3) == 0);
+  CHECK(pf.allocate(pid, PAGES) == 0 && pid == PAGES + 1);
+  CHECK(pf.freePage(pid) == 0);
+  CHECK(pf.close() == 0);
+
+  CHECK(stat("free.pf", &statbuf) == 0);
+  CHECK(statbuf.st_size == (off_t) (PAGES + 2) * 1024);
+
+  // the list is read back, and the pages in use still hold their content
+  CHECK(pf.open("free.pf", 'w') == 0);
+  CHECK(pf.getFreePageCount() == (int) freed.size());
+  for (PageId i = 0; i < PAGES; i += 2) {
+    fill(expected, pf.getPageSize(), i);
+    CHECK(pf.read(i, page) == 0);
+    CHECK(memcmp(page, expected, pf.getPageSize()) == 0);
+  }
+  for (std::set<PageId>::iterator it = freed.begin(); it != freed.end(); ++it) {
+    CHECK(pf.allocate(pid) == 0 && pid == *it);
+  }
+  CHECK(pf.getFreePageCount() == 0);
+  CHECK(pf.allocate(pid) == 0 && pid == PAGES + 1);
+  CHECK(pf.close() == 0);
+
+  // a list that was taken empty stays empty
+  CHECK(pf.open("free.pf", 'w') == 0);
+  CHECK(pf.getFreePageCount() == 0);
+  CHECK(pf.close() == 0);
+
+  printf("FreeListTest: ok\n");
+  return 0;
+}
@@ -0,0 +1,160 @@
+/*
+ * Copyright (C) 2008 by The Regents of the University of California
+ * Redistribution of this file is permitted under the terms of the GNU
+ * Public License (GPL).
+ */
+
+/*
+ * I/O statistics: the reads, writes, cache hits and misses, evictions and
+ * disk i/o of a file are counted by the role of each page, add up over
+ * every open of the file, and are timed; an index tells its leaf and
+ * interior nodes apart; resetAll() sets every count back to zero.
+ */
+
+#include "BTreeIndex.h"
+#include "IOStats.h"
+#include "Check.h"
+#include <cstring>
+
+static const int PAGES = 64;
+static const int CACHE_PAGES = 16;
+static const int KEYS = 20000;
+
+// fill a page with a pattern of the page
+static void fill(char* page, int size, PageId pid)
+{
+  for (int i = 0; i < size; i++) page[i] = (char) (pid * 7 + i);
+}
+
+static long long total(const IOStats* stats, IOStats::Counter c)
+{
+  long long n = 0;
+  for (int r = 0; r < ROLE_COUNT; r++) n += stats->get((PageRole) r, c);
+  return n;
+}
+
+static long long timed(const IOStats* stats, IOStats::Op op)
+{
+  long long n = 0;
+  for (int b = 0; b < IOStats::HISTOGRAM_BUCKETS; b++) n += stats->getLatency(op, b);
+  return n;
+}
+
+static int readPages(PageFile& pf)
+{
+  char page[PageFile::MAX_PAGE_SIZE];
+  char expected[PageFile::MAX_PAGE_SIZE];
+
+  for (PageId pid = 0; pid < PAGES; pid++) {
+    fill(expected, pf.getPageSize(), pid);
+    CHECK(pf.read(pid, page) == 0);
+    CHECK(memcmp(page, expected, pf.getPageSize()) == 0);
+  }
+  return 0;
+}
+
+static int checkPageFile()
+{
+  PageFile pf;
+  char page[PageFile::MAX_PAGE_SIZE];
+  IOStats* stats = IOStats::forFile("stats.pf");
+
+  CHECK(IOStats::forFile("stats.pf") == stats);
+  CHECK(PageFile::setCacheSize(4 * PAGES) == 0);
+
+  // a new file writes its header, then every page once
+  CHECK(pf.open("stats.pf", 'w') == 0);
+  for (PageId pid = 0; pid < PAGES; pid++) {
+    fill(page, pf.getPageSize(), pid);
+    CHECK(pf.write(pid, page) == 0);
+  }
+  CHECK(pf.close() == 0);
+  CHECK(stats->get(ROLE_HEAP, IOStats::WRITES) == PAGES);
+  CHECK(stats->get(ROLE_HEAP, IOStats::DISK_WRITES) == PAGES);
+  CHECK(stats->get(ROLE_HEADER, IOStats::DISK_WRITES) >= 1);
+  CHECK(total(stats, IOStats::READS) == 0);
+  CHECK(timed(stats, IOStats::OP_WRITE) >= PAGES);
+
+  // the first read of each page misses, the second one hits
+  CHECK(PageFile::setCacheSize(4 * PAGES) == 0);
+  CHECK(pf.open("stats.pf", 'r') == 0);
+  pf.setReadAhead(0);
+  if (readPages(pf) != 0) return 1;
+  if (readPages(pf) != 0) return 1;
+  CHECK(pf.close() == 0);
+  CHECK(stats->get(ROLE_HEAP, IOStats::READS) == 2 * PAGES);
+  CHECK(stats->get(ROLE_HEAP, IOStats::MISSES) == PAGES);
+  CHECK(stats->get(ROLE_HEAP, IOStats::HITS) == PAGES);
+  CHECK(stats->get(ROLE_HEAP, IOStats::DISK_READS) == PAGES);
+  CHECK(stats->get(ROLE_HEADER, IOStats::DISK_READS) >= 1);
+  CHECK(timed(stats, IOStats::OP_READ) >= PAGES);
+
+  // a cache smaller than the file evicts its pages, and the counts add
+  // up over both opens
+  CHECK(PageFile::setCacheSize(CACHE_PAGES) == 0);
+  CHECK(pf.open("stats.pf", 'r') == 0);
+  pf.setReadAhead(0);
+  if (readPages(pf) != 0) return 1;
+  CHECK(pf.close() == 0);
+  CHECK(stats->get(ROLE_HEAP, IOStats::READS) == 3 * PAGES);
+  CHECK(stats->get(ROLE_HEAP, IOStats::MISSES) == 2 * PAGES);
+  CHECK(stats->get(ROLE_HEAP, IOStats::EVICTIONS) >= PAGES - CACHE_PAGES);
+  CHECK(stats->get(ROLE_HEAP, IOStats::WRITES) == PAGES);
+
+  IOStats::resetAll();
+  for (int c = 0; c < IOStats::COUNTER_COUNT; c++) {
+    CHECK(total(stats, (IOStats::Counter) c) == 0);
+  }
+  CHECK(timed(stats, IOStats::OP_READ) == 0 && timed(stats, IOStats::OP_WRITE) == 0);
+  return 0;
+}
+
+static int checkIndex()
+{
+  BTreeIndex index;
+  IndexCursor cursor;
+  RecordId rid;
+  int key;
+  IOStats* stats = IOStats::forFile("stats.idx");
+
+  CHECK(PageFile::setCacheSize(CACHE_PAGES) == 0);
+  CHECK(index.open("stats.idx", 'w') == 0);
+  for (int i = 0; i < KEYS; i++) {
+    rid.pid = i;
+    rid.sid = 0;
+    CHECK(index.insert((i * 7919) % KEYS, rid) == 0);
+  }
+  CHECK(index.close() == 0);
+
+  // the index has leaves and interior nodes, and no heap pages
+  CHECK(stats->get(ROLE_LEAF, IOStats::WRITES) > 0);
+  CHECK(stats->get(ROLE_INTERIOR, IOStats::WRITES) > 0);
+  CHECK(stats->get(ROLE_HEAP, IOStats::WRITES) == 0);
+  CHECK(stats->get(ROLE_HEAP, IOStats::READS) == 0);
+
+  // a lookup reads interior nodes on the way down to a leaf
+  IOStats::resetAll();
+  CHECK(index.open("stats.idx", 'r') == 0);
+  for (int i = 0; i < KEYS; i += 101) {
+    CHECK(index.locate(i, cursor) == 0);
+    CHECK(index.readForward(cursor, key, rid) == 0);
+    CHECK(key == i);
+  }
+  CHECK(index.close() == 0);
+  CHECK(stats->get(ROLE_LEAF, IOStats::READS) > 0);
+  CHECK(stats->get(ROLE_INTERIOR, IOStats::READS) > 0);
+  CHECK(stats->get(ROLE_LEAF, IOStats::WRITES) == 0);
+  CHECK(stats->get(ROLE_INTERIOR, IOStats::WRITES) == 0);
+  return 0;
+}
+
+int main()
+{
+  if (enterScratchDir() != 0) return 1;
+
+  if (checkPageFile() != 0) return 1;
+  if (checkIndex() != 0) return 1;
+
+  printf("IOStatsTest: ok\n");
+  return 0;
+}
@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2008 by The Regents of the University of California
+ * Redistribution of this file is permitted under the terms of the GNU
+ * Public License (GPL).
+ */
+
+/*
+ * Key search: KeySearch::lowerBound() and upperBound() agree with
+ * std::lower_bound() and std::upper_bound() on sorted arrays of every
+ * length a node may have, with and without duplicates, unaligned, and
+ * for keys below, between, on and above the ones in the array.
+ */
+
+#include "KeySearch.h"
+#include "Check.h"
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <vector>
+
+using std::vector;
+
+static const int MAX_COUNT = 600;
+static const int ROUNDS = 20;
+
+static int checkKey(const int* keys, int count, int key)
+{
+  int lower = std::lower_bound(keys, keys + count, key) - keys;
+  int upper = std::upper_bound(keys, keys + count, key) - keys;
+
+  CHECK(KeySearch::lowerBound(keys, count, key) == lower);
+  CHECK(KeySearch::upperBound(keys, count, key) == upper);
+  return 0;
+}
+
+// search an array for each of its keys, the keys next to them, and the
+// extremes
+static int checkArray(const int* keys, int count)
+{
+  if (checkKey(keys, count, INT_MIN) != 0) return 1;
+  if (checkKey(keys, count, INT_MAX) != 0) return 1;
+  for (int i = 0; i < count; i++) {
+    if (checkKey(keys, count, keys[i]) != 0) return 1;
+    if (keys[i] > INT_MIN && checkKey(keys, count, keys[i] - 1) != 0) return 1;
+    if (keys[i] < INT_MAX && checkKey(keys, count, keys[i] + 1) != 0) return 1;
+  }
+  return 0;
+}
+
+int main()
+{
+  // one int more, so that an array may start off its alignment
+  vector<int> storage(MAX_COUNT + 1);
+
+  srand(11);
+  for (int count = 0; count <= MAX_COUNT; count += (count < 70) ? 1 : 37) {
+    for (int round = 0; round < ROUNDS; round++) {
+      int* keys = &storage[round % 2];
+      // few distinct keys in some rounds, so that many are the same
+      int spread = (round % 4 == 0) ? 3 : 1000000;
+      for (int i = 0; i < count; i++) keys[i] = rand() % spread - spread / 2;
+      if (round == ROUNDS - 1) {
+        for (int i = 0; i < count; i++) keys[i] = (i % 2 == 0) ? INT_MIN : INT_MAX;
+      }
+      std::sort(keys, keys + count);
+      if (checkArray(keys, count) != 0) return 1;
+    }
+  }
+
+  printf("KeySearchTest: ok\n");
+  return 0;
+}
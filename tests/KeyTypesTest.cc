@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2008 by The Regents of the University of California
+ * Redistribution of this file is permitted under the terms of the GNU
+ * Public License (GPL).
+ */
+
+/*
+ * Index key types: an index of 64-bit keys orders and finds keys beyond
+ * the range of an int, and an index of string keys orders and finds
+ * strings, strings that share the prefix of a key among them; each key
+ * type reads back across a reopen, and an index file opened with another
+ * key type than it was created with is refused.
+ */
+
+#include "BTreeIndex.h"
+#include "Check.h"
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+static const int KEYS = 6000;
+
+static bool keyLess(const int64_t& a, const int64_t& b) { return a < b; }
+static bool keyLess(const ValueKey& a, const ValueKey& b) { return memcmp(a.bytes, b.bytes, sizeof(a.bytes)) < 0; }
+static bool keyEqual(const int64_t& a, const int64_t& b) { return a == b; }
+static bool keyEqual(const ValueKey& a, const ValueKey& b) { return memcmp(a.bytes, b.bytes, sizeof(a.bytes)) == 0; }
+
+// insert the keys, the i-th one with record id (i, 0), then find each of
+// them after a reopen, and scan them all in order
+template<typename Key>
+static int checkKeys(const char* filename, const vector<Key>& keys)
+{
+  BasicBTreeIndex<Key> index;
+  IndexCursor cursor;
+  RecordId rid;
+  Key key;
+
+  unlink(filename);
+  CHECK(index.open(filename, 'w') == 0);
+  for (unsigned i = 0; i < keys.size(); i++) {
+    rid.pid = i;
+    rid.sid = 0;
+    CHECK(index.insert(keys[i], rid) == 0);
+  }
+  CHECK(index.close() == 0);
+
+  CHECK(index.open(filename, 'r') == 0);
+  for (unsigned i = 0; i < keys.size(); i += 7) {
+    CHECK(index.locate(keys[i], cursor) == 0);
+    CHECK(index.readForward(cursor, key, rid) == 0);
+    CHECK(keyEqual(key, keys[i]));
+  }
+
+  vector<Key> sorted(keys);
+  std::sort(sorted.begin(), sorted.end(), (bool (*)(const Key&, const Key&)) keyLess);
+
+  // the leaves are read in batches, along the leaf chain
+  IndexCursor end = { -1, -1 };
+  vector<Key> batch;
+  vector<RecordId> rids;
+  unsigned n = 0;
+  index.locate(KeyTraits<Key>::lowest(), cursor);
+  do {
+    CHECK(index.readForwardBatch(cursor, end, 100, batch, rids) == 0);
+    for (unsigned k = 0; k < batch.size(); k++, n++) {
+      CHECK(n < sorted.size() && keyEqual(batch[k], sorted[n]));
+      CHECK(rids[k].pid >= 0 && rids[k].pid < (int) keys.size());
+      CHECK(keyEqual(keys[rids[k].pid], batch[k]));
+    }
+  } while (!batch.empty());
+  CHECK(n == sorted.size());
+  CHECK(index.close() == 0);
+  return 0;
+}
+
+int main()
+{
+  vector<int64_t> wide;
+  vector<ValueKey> strings;
+  BTreeIndex index;
+  BTreeIndex64 index64;
+  ValueIndex valueIndex;
+
+  if (enterScratchDir() != 0) return 1;
+  srand(5);
+
+  // keys past both ends of an int, and ones that are equal as ints
+  for (int i = 0; i < KEYS; i++) {
+    int64_t key = ((int64_t) (rand() % 100000) << 32) + i;
+    wide.push_back((i % 2 == 0) ? key : -key);
+  }
+  wide.push_back(INT64_MAX);
+  wide.push_back(INT64_MIN + 1);
+  if (checkKeys("wide.idx", wide) != 0) return 1;
+
+  // strings of every length up to past the key, and strings with a
+  // common prefix longer than the key, which share a key
+  for (int i = 0; i < KEYS; i++) {
+    char value[64];
+    if (i % 3 == 0) snprintf(value, sizeof(value), "a-long-common-prefix-%d", i);
+    else snprintf(value, sizeof(value), "%x", rand());
+    strings.push_back(ValueKey(value));
+  }
+  strings.push_back(ValueKey(""));
+  CHECK(keyEqual(strings[0], ValueKey("a-long-common-prefix-99")));
+  if (checkKeys("strings.idx", strings) != 0) return 1;
+
+  // an index opens with the key type it was created with only
+  CHECK(index.open("int.idx", 'w') == 0);
+  CHECK(index.close() == 0);
+  CHECK(index64.open("int.idx", 'r') == RC_INVALID_FILE_FORMAT);
+  CHECK(valueIndex.open("int.idx", 'w') == RC_INVALID_FILE_FORMAT);
+  CHECK(index.open("wide.idx", 'r') == RC_INVALID_FILE_FORMAT);
+  CHECK(valueIndex.open("wide.idx", 'r') == RC_INVALID_FILE_FORMAT);
+  CHECK(index64.open("strings.idx", 'r') == RC_INVALID_FILE_FORMAT);
+  CHECK(index.open("int.idx", 'r') == 0);
+  CHECK(index.close() == 0);
+
+  printf("KeyTypesTest: ok\n");
+  return 0;
+}
@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2008 by The Regents of the University of California
+ * Redistribution of this file is permitted under the terms of the GNU
+ * Public License (GPL).
+ */
+
+/*
+ * Memory-mapped files: the pages written to a file opened in 'm' mode
+ * read back through the mapping as the file grows, are on the disk for
+ * a reader that opens the file normally, and a table and an index opened
+ * in 'm' mode work like in 'w' mode.
+ */
+
+#include "BTreeIndex.h"
+#include "RecordFile.h"
+#include "Check.h"
+#include <cstring>
+#include <string>
+
+static const int PAGES = 300;
+static const int RECORDS = 2000;
+
+// fill a page with a pattern of the page and the round that wrote it
+static void fill(char* page, int size, PageId pid, int round)
+{
+  for (int i = 0; i < size; i++) page[i] = (char) (pid * 7 + round * 13 + i);
+}
+
+static int checkPages(char mode, int round)
+{
+  PageFile pf;
+  char page[PageFile::MAX_PAGE_SIZE];
+  char expected[PageFile::MAX_PAGE_SIZE];
+  const char* pinned;
+
+  CHECK(pf.open("map.pf", mode) == 0);
+  CHECK(pf.endPid() == PAGES);
+  for (PageId pid = 0; pid < PAGES; pid++) {
+    fill(expected, pf.getPageSize(), pid, round);
+    CHECK(pf.read(pid, page) == 0);
+    CHECK(memcmp(page, expected, pf.getPageSize()) == 0);
+    CHECK(pf.pin(pid, pinned) == 0);
+    CHECK(memcmp(pinned, expected, pf.getPageSize()) == 0);
+    CHECK(pf.unpin(pid) == 0);
+  }
+  CHECK(pf.close() == 0);
+  return 0;
+}
+
+int main()
+{
+  PageFile pf;
+  char page[PageFile::MAX_PAGE_SIZE];
+  char expected[PageFile::MAX_PAGE_SIZE];
+
+  if (enterScratchDir() != 0) return 1;
+
+  // the file grows page by page, and is read as it grows
+  CHECK(pf.open("map.pf", 'm') == 0);
+  for (PageId pid = 0; pid < PAGES; pid++) {
+    fill(page, pf.getPageSize(), pid, 1);
+    CHECK(pf.write(pid, page) == 0);
+    CHECK(pf.read(pid / 2, page) == 0);
+  }
+  CHECK(pf.close() == 0);
+  if (checkPages('r', 1) != 0) return 1;
+  if (checkPages('m', 1) != 0) return 1;
+
+  // pages rewritten through the mapping replace the old ones
+  CHECK(pf.open("map.pf", 'm') == 0);
+  for (PageId pid = 0; pid < PAGES; pid += 3) {
+    fill(page, pf.getPageSize(), pid, 2);
+    CHECK(pf.write(pid, page) == 0);
+  }
+  for (PageId pid = 0; pid < PAGES; pid += 3) {
+    fill(expected, pf.getPageSize(), pid, 2);
+    CHECK(pf.read(pid, page) == 0);
+    CHECK(memcmp(page, expected, pf.getPageSize()) == 0);
+  }
+  CHECK(pf.close() == 0);
+
+  // a table and an index in 'm' mode
+  RecordFile rf;
+  BTreeIndex index;
+  RecordId rid;
+  IndexCursor cursor;
+  int key;
+  std::string value;
+  CHECK(rf.open("map.tbl", 'm') == 0);
+  CHECK(index.open("map.idx", 'm') == 0);
+  for (int i = 0; i < RECORDS; i++) {
+    CHECK(rf.append(i, "value " + std::to_string(i), rid) == 0);
+    CHECK(index.insert(i, rid) == 0);
+  }
+  CHECK(index.close() == 0);
+  CHECK(rf.close() == 0);
+  CHECK(rf.open("map.tbl", 'r') == 0);
+  CHECK(index.open("map.idx", 'r') == 0);
+  for (int i = 0; i < RECORDS; i += 7) {
+    CHECK(index.locate(i, cursor) == 0);
+    CHECK(index.readForward(cursor, key, rid) == 0 && key == i);
+    CHECK(rf.read(rid, key, value) == 0);
+    CHECK(key == i && value == "value " + std::to_string(i));
+  }
+  CHECK(index.close() == 0);
+  CHECK(rf.close() == 0);
+
+  printf("MmapTest: ok\n");
+  return 0;
+}
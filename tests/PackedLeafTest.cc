@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) 2008 by The Regents of the University of California
+ * Redistribution of this file is permitted under the terms of the GNU
+ * Public License (GPL).
+ */
+
+/*
+ * Packed leaves: an index with packed leaves takes fewer pages than one
+ * without, and locate() and readForward() find the same entries in both,
+ * across splits, duplicate keys and a reopen.
+ */
+
+#include "BTreeIndex.h"
+#include "Check.h"
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+using std::pair;
+using std::vector;
+
+static const int ENTRIES = 20000;
+
+// the entries, in the order they are inserted: clustered keys with
+// duplicates, and RecordIds of a table loaded in key order
+static void makeEntries(vector<pair<int, RecordId> >& entries)
+{
+  unsigned seed = 1;
+
+  for (int i = 0; i < ENTRIES; i++) {
+    seed = seed * 1103515245 + 12345;
+    int key = (int) ((seed >> 8) % (ENTRIES * 4)) - ENTRIES;
+    RecordId rid = { key / 8 + ENTRIES, (int) (seed >> 24) % 8 };
+    entries.push_back(std::make_pair(key, rid));
+  }
+}
+
+// every entry of the index, in the order of its leaves
+static int scan(BTreeIndex& index, vector<pair<int, RecordId> >& found)
+{
+  IndexCursor cursor;
+  int key;
+  RecordId rid;
+
+  found.clear();
+  index.locate(INT32_MIN, cursor);
+  // the last leaf points to page 0, the index header
+  while (cursor.pid != 0) {
+    if (cursor.eid > index.GetKeycount(cursor.pid)) {
+      cursor.eid = 1;
+      cursor.pid = index.GetNextpid(cursor.pid);
+      continue;
+    }
+    CHECK(index.readForward(cursor, key, rid) == 0);
+    CHECK(found.empty() || found.back().first <= key);
+    found.push_back(std::make_pair(key, rid));
+  }
+  return 0;
+}
+
+// check the index holds the entries, and nothing else
+static int checkIndex(BTreeIndex& index, const vector<pair<int, RecordId> >& sorted)
+{
+  vector<pair<int, RecordId> > found;
+  IndexCursor cursor;
+  int key;
+  RecordId rid;
+
+  if (scan(index, found) != 0) return 1;
+  CHECK(found.size() == sorted.size());
+  std::sort(found.begin(), found.end());
+  for (unsigned i = 0; i < sorted.size(); i++) {
+    CHECK(found[i].first == sorted[i].first && found[i].second == sorted[i].second);
+  }
+
+  // each key is found, and a missing key leads to the next larger one
+  for (unsigned i = 0; i < sorted.size(); i += 7) {
+    CHECK(index.locate(sorted[i].first, cursor) == 0);
+    CHECK(index.readForward(cursor, key, rid) == 0 && key == sorted[i].first);
+  }
+  for (unsigned i = 0; i + 1 < sorted.size(); i++) {
+    if (sorted[i].first + 1 >= sorted[i + 1].first) continue;
+    CHECK(index.locate(sorted[i].first + 1, cursor) == RC_NO_SUCH_RECORD);
+    if (cursor.eid > index.GetKeycount(cursor.pid)) {
+      cursor.eid = 1;
+      cursor.pid = index.GetNextpid(cursor.pid);
+    }
+    CHECK(index.readForward(cursor, key, rid) == 0 && key == sorted[i + 1].first);
+  }
+  return 0;
+}
+
+int main()
+{
+  vector<pair<int, RecordId> > entries;
+  BTreeIndex packed;
+  BTreeIndex plain;
+
+  if (enterScratchDir() != 0) return 1;
+  makeEntries(entries);
+
+  // the plain index is not packed by default
+  unsetenv("BRUINBASE_PACK_INDEX");
+
+  CHECK(packed.open("packed.idx", 'w', 0, true) == 0);
+  CHECK(plain.open("plain.idx", 'w', 0, false) == 0);
+  for (unsigned i = 0; i < entries.size(); i++) {
+    CHECK(packed.insert(entries[i].first, entries[i].second) == 0);
+    CHECK(plain.insert(entries[i].first, entries[i].second) == 0);
+  }
+  CHECK(packed.close() == 0);
+  CHECK(plain.close() == 0);
+
+  vector<pair<int, RecordId> > sorted(entries);
+  std::sort(sorted.begin(), sorted.end());
+
+  CHECK(packed.open("packed.idx", 'r') == 0);
+  CHECK(plain.open("plain.idx", 'r') == 0);
+  if (checkIndex(packed, sorted) != 0) return 1;
+  if (checkIndex(plain, sorted) != 0) return 1;
+
+  // the packed leaves hold more entries each
+  CHECK(packed.pf.endPid() < plain.pf.endPid());
+  CHECK(packed.close() == 0);
+  CHECK(plain.close() == 0);
+
+  printf("PackedLeafTest: ok\n");
+  return 0;
+}
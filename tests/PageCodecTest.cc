@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2008 by The Regents of the University of California
+ * Redistribution of this file is permitted under the terms of the GNU
+ * Public License (GPL).
+ */
+
+/*
+ * Compressed pages: the codec decodes what it encodes, and a compressed
+ * page file reads back the pages written to it, across a reopen and after
+ * a page is rewritten larger than its space.
+ */
+
+#include "PageCodec.h"
+#include "PageFile.h"
+#include "Check.h"
+#include <cstring>
+#include <sys/stat.h>
+
+static const int PAGES = 200;
+
+// a page of a kind: 0 all zeros, 1 a repeated record, 2 noise
+static void fill(char* page, int size, int kind, unsigned seed)
+{
+  for (int i = 0; i < size; i++) {
+    switch (kind) {
+    case 0: page[i] = 0; break;
+    case 1: page[i] = "key=123,value='abc';"[i % 20] + (char) (seed % 3); break;
+    default: seed = seed * 1103515245 + 12345; page[i] = (char) (seed >> 16); break;
+    }
+  }
+}
+
+static int checkCodec()
+{
+  char page[PageFile::MAX_PAGE_SIZE];
+  char packed[2 * PageFile::MAX_PAGE_SIZE];
+  char unpacked[PageFile::MAX_PAGE_SIZE];
+
+  for (int size = PageFile::MIN_PAGE_SIZE; size <= PageFile::MAX_PAGE_SIZE; size *= 2) {
+    for (int kind = 0; kind < 3; kind++) {
+      fill(page, size, kind, size + kind);
+      int length = PageCodec::compress(page, size, packed, sizeof(packed));
+      CHECK(length > 0);
+      if (kind < 2) CHECK(length < size / 4);
+      CHECK(PageCodec::decompress(packed, length, unpacked, size) == 0);
+      CHECK(memcmp(page, unpacked, size) == 0);
+
+      // a page that does not fit in the space given is not compressed
+      CHECK(PageCodec::compress(page, size, packed, 8) == 0);
+    }
+  }
+  return 0;
+}
+
+static int checkPages(PageFile& pf, int round)
+{
+  char page[PageFile::MAX_PAGE_SIZE];
+  char expected[PageFile::MAX_PAGE_SIZE];
+
+  for (PageId pid = 0; pid < PAGES; pid++) {
+    int kind = (pid % 10 == 0 && round > 0) ? 2 : pid % 2;
+    fill(expected, pf.getPageSize(), kind, pid);
+    CHECK(pf.read(pid, page) == 0);
+    CHECK(memcmp(page, expected, pf.getPageSize()) == 0);
+  }
+  return 0;
+}
+
+static int checkFile()
+{
+  PageFile pf;
+  char page[PageFile::MAX_PAGE_SIZE];
+  struct stat statbuf;
+
+  CHECK(pf.open("codec.pf", 'w') == 0);
+  CHECK(pf.setCompression(true) == 0);
+  for (PageId pid = 0; pid < PAGES; pid++) {
+    fill(page, pf.getPageSize(), pid % 2, pid);
+    CHECK(pf.write(pid, page) == 0);
+  }
+  CHECK(pf.close() == 0);
+
+  // the pages take much less room than uncompressed
+  CHECK(stat("codec.pf", &statbuf) == 0);
+  CHECK(statbuf.st_size < (off_t) PAGES * pf.getPageSize() / 4);
+
+  CHECK(pf.open("codec.pf", 'r') == 0);
+  CHECK(pf.isCompressed());
+  if (checkPages(pf, 0) != 0) return 1;
+  CHECK(pf.close() == 0);
+
+  // a page rewritten with noise no longer fits its space, and moves
+  CHECK(pf.open("codec.pf", 'w') == 0);
+  for (PageId pid = 0; pid < PAGES; pid += 10) {
+    fill(page, pf.getPageSize(), 2, pid);
+    CHECK(pf.write(pid, page) == 0);
+  }
+  CHECK(pf.close() == 0);
+
+  CHECK(pf.open("codec.pf", 'r') == 0);
+  if (checkPages(pf, 1) != 0) return 1;
+  CHECK(pf.close() == 0);
+  return 0;
+}
+
+int main()
+{
+  if (enterScratchDir() != 0) return 1;
+  if (checkCodec() != 0) return 1;
+  if (checkFile() != 0) return 1;
+
+  printf("PageCodecTest: ok\n");
+  return 0;
+}
@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2008 by The Regents of the University of California
+ * Redistribution of this file is permitted under the terms of the GNU
+ * Public License (GPL).
+ */
+
+/*
+ * The write-ahead log of a page file: the committed pages of a process
+ * that crashes are recovered when the file is opened again, and the pages
+ * written after the last commit are not.
+ */
+
+#include "PageFile.h"
+#include "Check.h"
+#include <cstring>
+#include <sys/wait.h>
+
+static const int PAGES = 64;
+
+// fill a page with a pattern of the page and the round that wrote it
+static void fill(char* page, int size, PageId pid, int round)
+{
+  for (int i = 0; i < size; i++) page[i] = (char) (pid * 7 + round * 13 + i);
+}
+
+// write the pages twice, commit only the first round, and crash
+static void crash()
+{
+  PageFile pf;
+  char page[PageFile::MAX_PAGE_SIZE];
+
+  if (pf.open("log.pf", 'w') < 0 || pf.setLogging(true) < 0) _exit(1);
+  for (PageId pid = 0; pid < PAGES; pid++) {
+    fill(page, pf.getPageSize(), pid, 1);
+    if (pf.write(pid, page) < 0) _exit(1);
+  }
+  if (pf.commit() < 0) _exit(1);
+
+  // the second round reaches the log, without a commit frame
+  for (PageId pid = 0; pid < PAGES; pid += 2) {
+    fill(page, pf.getPageSize(), pid, 2);
+    if (pf.write(pid, page) < 0) _exit(1);
+  }
+  if (pf.flush() < 0) _exit(1);
+  _exit(0);
+}
+
+// check that the file holds the pages of the first round
+static int checkPages(char mode)
+{
+  PageFile pf;
+  char page[PageFile::MAX_PAGE_SIZE];
+  char expected[PageFile::MAX_PAGE_SIZE];
+
+  CHECK(pf.open("log.pf", mode) == 0);
+  CHECK(pf.endPid() == PAGES);
+  for (PageId pid = 0; pid < PAGES; pid++) {
+    fill(expected, pf.getPageSize(), pid, 1);
+    CHECK(pf.read(pid, page) == 0);
+    CHECK(memcmp(page, expected, pf.getPageSize()) == 0);
+  }
+  CHECK(pf.close() == 0);
+  return 0;
+}
+
+int main()
+{
+  int status;
+
+  if (enterScratchDir() != 0) return 1;
+
+  pid_t child = fork();
+  CHECK(child >= 0);
+  if (child == 0) crash();
+  CHECK(waitpid(child, &status, 0) == child);
+  CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+  CHECK(access("log.pf.wal", F_OK) == 0);
+
+  // a reader reads the committed pages from the log. a writer copies
+  // them back to the file, and empties the log
+  if (checkPages('r') != 0) return 1;
+  if (checkPages('w') != 0) return 1;
+  if (checkPages('r') != 0) return 1;
+
+  printf("PageLogTest: ok\n");
+  return 0;
+}
@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2008 by The Regents of the University of California
+ * Redistribution of this file is permitted under the terms of the GNU
+ * Public License (GPL).
+ */
+
+/*
+ * Page sizes: a new file takes the page size it is given, or the one of
+ * BRUINBASE_PAGE_SIZE, and keeps it when opened again; an invalid size is
+ * refused; a file without the header page has DEFAULT_PAGE_SIZE pages;
+ * and an index works the same at every page size.
+ */
+
+#include "BTreeIndex.h"
+#include "Check.h"
+#include <cstring>
+#include <fcntl.h>
+
+static const int PAGES = 20;
+static const int KEYS = 5000;
+
+// fill a page with a pattern of the page
+static void fill(char* page, int size, PageId pid)
+{
+  for (int i = 0; i < size; i++) page[i] = (char) (pid * 7 + i);
+}
+
+// build an index of the keys, and find each of them after a reopen
+static int checkIndex(int size)
+{
+  BTreeIndex index;
+  IndexCursor cursor;
+  RecordId rid;
+  int key;
+
+  unlink("size.idx");
+  CHECK(index.open("size.idx", 'w', size) == 0);
+  for (int i = 0; i < KEYS; i++) {
+    rid.pid = i;
+    rid.sid = 0;
+    CHECK(index.insert((i * 7919) % KEYS, rid) == 0);
+  }
+  CHECK(index.close() == 0);
+
+  CHECK(index.open("size.idx", 'r') == 0);
+  for (int i = 0; i < KEYS; i += 13) {
+    CHECK(index.locate(i, cursor) == 0);
+    CHECK(index.readForward(cursor, key, rid) == 0);
+    CHECK(key == i && (rid.pid * 7919) % KEYS == i);
+  }
+  CHECK(index.close() == 0);
+  return 0;
+}
+
+int main()
+{
+  PageFile pf;
+  BTreeIndex index;
+  char page[PageFile::MAX_PAGE_SIZE];
+  char expected[PageFile::MAX_PAGE_SIZE];
+
+  if (enterScratchDir() != 0) return 1;
+  unsetenv("BRUINBASE_PAGE_SIZE");
+
+  CHECK(PageFile::isValidPageSize(4096));
+  CHECK(!PageFile::isValidPageSize(PageFile::MIN_PAGE_SIZE / 2));
+  CHECK(!PageFile::isValidPageSize(2 * PageFile::MAX_PAGE_SIZE));
+  CHECK(!PageFile::isValidPageSize(3000));
+
+  // an invalid size creates no file
+  CHECK(pf.open("bad.pf", 'w', 3000) == RC_INVALID_PAGE_SIZE);
+  CHECK(index.open("bad.idx", 'w', 3000) == RC_INVALID_PAGE_SIZE);
+  CHECK(access("bad.pf", F_OK) < 0 && access("bad.idx", F_OK) < 0);
+
+  // the size of a file is the one it was created with
+  CHECK(pf.open("sized.pf", 'w', 4096) == 0);
+  CHECK(pf.getPageSize() == 4096);
+  for (PageId pid = 0; pid < PAGES; pid++) {
+    fill(page, 4096, pid);
+    CHECK(pf.write(pid, page) == 0);
+  }
+  CHECK(pf.close() == 0);
+  CHECK(pf.open("sized.pf", 'w', 8192) == 0);
+  CHECK(pf.getPageSize() == 4096 && pf.endPid() == PAGES);
+  for (PageId pid = 0; pid < PAGES; pid++) {
+    fill(expected, 4096, pid);
+    CHECK(pf.read(pid, page) == 0);
+    CHECK(memcmp(page, expected, 4096) == 0);
+  }
+  CHECK(pf.close() == 0);
+
+  // the environment sets the size of a new file
+  setenv("BRUINBASE_PAGE_SIZE", "16384", 1);
+  CHECK(pf.open("env.pf", 'w') == 0);
+  CHECK(pf.getPageSize() == 16384);
+  CHECK(pf.close() == 0);
+  unsetenv("BRUINBASE_PAGE_SIZE");
+
+  // a file written before the header page existed
+  int fd = ::open("legacy.pf", O_RDWR | O_CREAT, 0644);
+  CHECK(fd >= 0);
+  for (PageId pid = 0; pid < PAGES; pid++) {
+    fill(page, PageFile::DEFAULT_PAGE_SIZE, pid);
+    CHECK(::write(fd, page, PageFile::DEFAULT_PAGE_SIZE) == PageFile::DEFAULT_PAGE_SIZE);
+  }
+  ::close(fd);
+  CHECK(pf.open("legacy.pf", 'r') == 0);
+  CHECK(pf.getPageSize() == PageFile::DEFAULT_PAGE_SIZE && pf.endPid() == PAGES);
+  for (PageId pid = 0; pid < PAGES; pid++) {
+    fill(expected, PageFile::DEFAULT_PAGE_SIZE, pid);
+    CHECK(pf.read(pid, page) == 0);
+    CHECK(memcmp(page, expected, PageFile::DEFAULT_PAGE_SIZE) == 0);
+  }
+  CHECK(pf.close() == 0);
+
+  for (int size = PageFile::MIN_PAGE_SIZE; size <= PageFile::MAX_PAGE_SIZE; size *= 2) {
+    if (checkIndex(size) != 0) return 1;
+  }
+
+  printf("PageSizeTest: ok\n");
+  return 0;
+}
@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2008 by The Regents of the University of California
+ * Redistribution of this file is permitted under the terms of the GNU
+ * Public License (GPL).
+ */
+
+/*
+ * The PAX layout of data pages: the keys of the records of a page are
+ * stored together in one array, apart from the values; readKey() reads
+ * the data page only, even for a record whose value is in overflow pages,
+ * and the keys and values read back across many pages and a reopen.
+ */
+
+#include "RecordFile.h"
+#include "Check.h"
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+static const int RECORDS = 3000;
+static const int LONG_EVERY = 97;
+
+// keys that cannot be mistaken for the bytes of a value
+static int keyOf(int i)
+{
+  return 0x5a000000 + i * 3;
+}
+
+static string valueOf(int i)
+{
+  int length = (i % LONG_EVERY == 0) ? 5000 + i : i % 40;
+  string value(length, ' ');
+
+  for (int k = 0; k < length; k++) value[k] = 'a' + (i * 31 + k) % 26;
+  return value;
+}
+
+static int checkRecords(RecordFile& rf, const vector<RecordId>& rids)
+{
+  int key;
+  string value;
+
+  for (int i = 0; i < RECORDS; i++) {
+    CHECK(rf.readKey(rids[i], key) == 0 && key == keyOf(i));
+    CHECK(rf.read(rids[i], key, value) == 0);
+    CHECK(key == keyOf(i) && value == valueOf(i));
+  }
+  return 0;
+}
+
+int main()
+{
+  RecordFile rf;
+  PageFile pf;
+  vector<RecordId> rids(RECORDS);
+  std::map<PageId, vector<int> > pageKeys;
+  char page[PageFile::MAX_PAGE_SIZE];
+  int key;
+  string value;
+
+  if (enterScratchDir() != 0) return 1;
+
+  CHECK(rf.open("pax.tbl", 'w') == 0);
+  for (int i = 0; i < RECORDS; i++) {
+    CHECK(rf.append(keyOf(i), valueOf(i), rids[i]) == 0);
+    pageKeys[rids[i].pid].push_back(keyOf(i));
+  }
+  if (checkRecords(rf, rids) != 0) return 1;
+  CHECK(rf.close() == 0);
+  CHECK(pageKeys.size() > 10);
+
+  // the keys of each data page lie in one array, in slot order
+  CHECK(pf.open("pax.tbl", 'r') == 0);
+  for (std::map<PageId, vector<int> >::iterator it = pageKeys.begin(); it != pageKeys.end(); ++it) {
+    const vector<int>& keys = it->second;
+    CHECK(pf.read(it->first, page) == 0);
+    CHECK(memmem(page, pf.getPageSize(), &keys[0], keys.size() * sizeof(int)) != NULL);
+  }
+  CHECK(pf.close() == 0);
+
+  CHECK(rf.open("pax.tbl", 'r') == 0);
+  if (checkRecords(rf, rids) != 0) return 1;
+
+  // the key of a long record is read from its data page alone; the record
+  // needs its overflow pages too
+  CHECK(PageFile::setCacheSize(64) == 0);
+  long long reads = PageFile::getPageReadCount();
+  CHECK(rf.readKey(rids[LONG_EVERY], key) == 0 && key == keyOf(LONG_EVERY));
+  CHECK(PageFile::getPageReadCount() == reads + 1);
+  CHECK(rf.read(rids[LONG_EVERY], key, value) == 0 && value == valueOf(LONG_EVERY));
+  CHECK(PageFile::getPageReadCount() > reads + 2);
+  CHECK(rf.close() == 0);
+
+  printf("PaxTest: ok\n");
+  return 0;
+}
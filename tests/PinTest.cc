@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2008 by The Regents of the University of California
+ * Redistribution of this file is permitted under the terms of the GNU
+ * Public License (GPL).
+ */
+
+/*
+ * Pinned pages: a pin hands out the cached page itself, a page changed
+ * through pinMutable() reaches the disk, and pinned pages are never
+ * evicted, so a cache with every frame pinned takes no other page.
+ */
+
+#include "PageFile.h"
+#include "Check.h"
+#include <cstring>
+
+static const int CACHE_PAGES = 8;
+static const int PAGES = 32;
+
+// fill a page with a pattern of the page and the round that wrote it
+static void fill(char* page, int size, PageId pid, int round)
+{
+  for (int i = 0; i < size; i++) page[i] = (char) (pid * 7 + round * 13 + i);
+}
+
+int main()
+{
+  PageFile pf;
+  char page[PageFile::MAX_PAGE_SIZE];
+  char expected[PageFile::MAX_PAGE_SIZE];
+  const char* pinned[CACHE_PAGES];
+  const char* again;
+  char* frame;
+
+  if (enterScratchDir() != 0) return 1;
+  CHECK(PageFile::setCacheSize(CACHE_PAGES) == 0);
+
+  CHECK(pf.open("pin.pf", 'w') == 0);
+  pf.setReadAhead(0);
+  int size = pf.getPageSize();
+  for (PageId pid = 0; pid < PAGES; pid++) {
+    fill(page, size, pid, 1);
+    CHECK(pf.write(pid, page) == 0);
+  }
+
+  // two pins of a page share the cached copy
+  CHECK(pf.pin(3, pinned[0]) == 0);
+  CHECK(pf.pin(3, again) == 0);
+  CHECK(again == pinned[0]);
+  fill(expected, size, 3, 1);
+  CHECK(memcmp(pinned[0], expected, size) == 0);
+  CHECK(pf.unpin(3) == 0);
+  CHECK(pf.unpin(3) == 0);
+
+  // a page changed in place is read back changed, and is written out
+  CHECK(pf.pinMutable(4, frame) == 0);
+  fill(frame, size, 4, 2);
+  CHECK(pf.unpin(4) == 0);
+  fill(expected, size, 4, 2);
+  CHECK(pf.read(4, page) == 0);
+  CHECK(memcmp(page, expected, size) == 0);
+
+  // with every frame pinned, another page finds no room. once a pin is
+  // released, the page takes its frame
+  for (int i = 0; i < CACHE_PAGES; i++) CHECK(pf.pin(i + 10, pinned[i]) == 0);
+  CHECK(pf.read(PAGES - 1, page) == RC_CACHE_FULL);
+  for (int i = 0; i < CACHE_PAGES; i++) {
+    fill(expected, size, i + 10, 1);
+    CHECK(memcmp(pinned[i], expected, size) == 0);
+  }
+  CHECK(pf.unpin(10) == 0);
+  fill(expected, size, PAGES - 1, 1);
+  CHECK(pf.read(PAGES - 1, page) == 0);
+  CHECK(memcmp(page, expected, size) == 0);
+  for (int i = 1; i < CACHE_PAGES; i++) CHECK(pf.unpin(i + 10) == 0);
+  CHECK(pf.close() == 0);
+
+  CHECK(pf.open("pin.pf", 'r') == 0);
+  fill(expected, size, 4, 2);
+  CHECK(pf.read(4, page) == 0);
+  CHECK(memcmp(page, expected, size) == 0);
+  CHECK(pf.close() == 0);
+
+  printf("PinTest: ok\n");
+  return 0;
+}
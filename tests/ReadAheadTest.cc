@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2008 by The Regents of the University of California
+ * Redistribution of this file is permitted under the terms of the GNU
+ * Public License (GPL).
+ */
+
+/*
+ * Read-ahead: a file read page after page is read ahead of the reader,
+ * and the reader then finds nearly every page in the cache; a file read
+ * out of order, or with read-ahead off, is not read ahead.
+ */
+
+#include "PageFile.h"
+#include "Check.h"
+#include <cstring>
+
+static const int PAGES = 400;
+
+// fill a page with a pattern of the page
+static void fill(char* page, int size, PageId pid)
+{
+  for (int i = 0; i < size; i++) page[i] = (char) (pid * 7 + i);
+}
+
+static int readPage(PageFile& pf, PageId pid)
+{
+  char page[PageFile::MAX_PAGE_SIZE];
+  char expected[PageFile::MAX_PAGE_SIZE];
+
+  fill(expected, pf.getPageSize(), pid);
+  CHECK(pf.read(pid, page) == 0);
+  CHECK(memcmp(page, expected, pf.getPageSize()) == 0);
+  return 0;
+}
+
+int main()
+{
+  PageFile pf;
+  char page[PageFile::MAX_PAGE_SIZE];
+
+  if (enterScratchDir() != 0) return 1;
+  CHECK(PageFile::setCacheSize(1024) == 0);
+
+  CHECK(pf.open("ahead.pf", 'w') == 0);
+  for (PageId pid = 0; pid < PAGES; pid++) {
+    fill(page, pf.getPageSize(), pid);
+    CHECK(pf.write(pid, page) == 0);
+  }
+  CHECK(pf.close() == 0);
+
+  // in order: all but the first few pages are read ahead
+  CHECK(pf.open("ahead.pf", 'r') == 0);
+  CHECK(pf.getReadAhead() == PageFile::DEFAULT_READ_AHEAD);
+  for (PageId pid = 0; pid < PAGES; pid++) {
+    if (readPage(pf, pid) != 0) return 1;
+  }
+  CHECK(pf.getReadAheadCount() >= PAGES - 2 * PageFile::SEQUENTIAL_THRESHOLD);
+  CHECK(pf.getReadAheadHitCount() >= PAGES - 2 * PageFile::SEQUENTIAL_THRESHOLD);
+  CHECK(pf.getCacheMissCount() <= 2 * PageFile::SEQUENTIAL_THRESHOLD);
+  CHECK(pf.close() == 0);
+  CHECK(PageFile::setCacheSize(1024) == 0);
+
+  // out of order: nothing is read ahead
+  CHECK(pf.open("ahead.pf", 'r') == 0);
+  for (int i = 0; i < PAGES; i++) {
+    if (readPage(pf, (i * 151) % PAGES) != 0) return 1;
+  }
+  CHECK(pf.getReadAheadCount() == 0);
+  CHECK(pf.close() == 0);
+  CHECK(PageFile::setCacheSize(1024) == 0);
+
+  // read-ahead turned off
+  CHECK(pf.open("ahead.pf", 'r') == 0);
+  pf.setReadAhead(0);
+  for (PageId pid = 0; pid < PAGES; pid++) {
+    if (readPage(pf, pid) != 0) return 1;
+  }
+  CHECK(pf.getReadAheadCount() == 0);
+  CHECK(pf.getCacheMissCount() == PAGES);
+  CHECK(pf.close() == 0);
+
+  printf("ReadAheadTest: ok\n");
+  return 0;
+}
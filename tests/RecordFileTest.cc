@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2008 by The Regents of the University of California
+ * Redistribution of this file is permitted under the terms of the GNU
+ * Public License (GPL).
+ */
+
+/*
+ * Records with values in overflow chains: a value longer than a quarter of
+ * a page goes to overflow pages, and reads back whole, whether it is read,
+ * pinned or skipped by readKey(), among short records and across a reopen.
+ */
+
+#include "RecordFile.h"
+#include "Check.h"
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+static const int RECORDS = 300;
+
+// the value of the i-th record: short, or up to several pages long
+static string valueOf(int i)
+{
+  static const int lengths[] = { 5, 300, 1, 1500, 0, 70000, 40, 4096 };
+  int length = lengths[i % 8] + i;
+  string value(length, ' ');
+
+  for (int k = 0; k < length; k++) value[k] = 'a' + (i * 31 + k) % 26;
+  return value;
+}
+
+static int checkRecords(RecordFile& rf, const vector<RecordId>& rids)
+{
+  int key;
+  string value;
+  string buffer;
+  std::string_view view;
+
+  for (int i = 0; i < RECORDS; i++) {
+    CHECK(rf.read(rids[i], key, value) == 0);
+    CHECK(key == i && value == valueOf(i));
+    CHECK(rf.pin(rids[i], key, view, buffer) == 0);
+    CHECK(key == i && view == valueOf(i));
+    CHECK(rf.unpin(rids[i]) == 0);
+    CHECK(rf.readKey(rids[i], key) == 0 && key == i);
+  }
+
+  // a scan meets the records in order, and no overflow page
+  RecordId rid;
+  int count = 0;
+  rid.pid = rid.sid = 0;
+  while (rid < rf.endRid()) {
+    CHECK(count < RECORDS && rid == rids[count]);
+    CHECK(rf.readKey(rid, key) == 0 && key == count);
+    count++;
+    rf.next(rid);
+  }
+  CHECK(count == RECORDS);
+  return 0;
+}
+
+int main()
+{
+  RecordFile rf;
+  vector<RecordId> rids(RECORDS);
+  vector<int> keys;
+  vector<string> values;
+  vector<RecordId> batch;
+
+  if (enterScratchDir() != 0) return 1;
+
+  // half of the records one at a time, the other half in one batch
+  CHECK(rf.open("overflow.tbl", 'w') == 0);
+  CHECK(rf.isSlotted());
+  for (int i = 0; i < RECORDS / 2; i++) CHECK(rf.append(i, valueOf(i), rids[i]) == 0);
+  for (int i = RECORDS / 2; i < RECORDS; i++) {
+    keys.push_back(i);
+    values.push_back(valueOf(i));
+  }
+  CHECK(rf.appendBatch(keys, values, batch) == 0);
+  CHECK(batch.size() == keys.size());
+  for (unsigned i = 0; i < batch.size(); i++) rids[RECORDS / 2 + i] = batch[i];
+  if (checkRecords(rf, rids) != 0) return 1;
+  CHECK(rf.close() == 0);
+
+  CHECK(rf.open("overflow.tbl", 'r') == 0);
+  if (checkRecords(rf, rids) != 0) return 1;
+  CHECK(rf.close() == 0);
+
+  printf("RecordFileTest: ok\n");
+  return 0;
+}
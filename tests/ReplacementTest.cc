@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2008 by The Regents of the University of California
+ * Redistribution of this file is permitted under the terms of the GNU
+ * Public License (GPL).
+ */
+
+/*
+ * Scan resistance of the page cache: pages read again soon after they
+ * were evicted are kept as hot, and neither a scan of many pages read
+ * once nor a scan advised as sequential pushes them out.
+ */
+
+#include "PageFile.h"
+#include "Check.h"
+#include <cstring>
+
+static const int CACHE_PAGES = 64;
+static const int HOT_PAGES = 8;
+static const int SCAN_PAGES = 10 * CACHE_PAGES;
+
+// fill a page with a pattern of the page
+static void fill(char* page, int size, PageId pid)
+{
+  for (int i = 0; i < size; i++) page[i] = (char) (pid * 7 + i);
+}
+
+static int readPages(PageFile& pf, PageId first, int count)
+{
+  char page[PageFile::MAX_PAGE_SIZE];
+  char expected[PageFile::MAX_PAGE_SIZE];
+
+  for (PageId pid = first; pid < first + count; pid++) {
+    fill(expected, pf.getPageSize(), pid);
+    CHECK(pf.read(pid, page) == 0);
+    CHECK(memcmp(page, expected, pf.getPageSize()) == 0);
+  }
+  return 0;
+}
+
+// read the hot pages, which must all be in the cache
+static int checkHot(PageFile& hot)
+{
+  int hits = hot.getCacheHitCount();
+  int misses = hot.getCacheMissCount();
+  if (readPages(hot, 0, HOT_PAGES) != 0) return 1;
+  CHECK(hot.getCacheHitCount() == hits + HOT_PAGES);
+  CHECK(hot.getCacheMissCount() == misses);
+  return 0;
+}
+
+int main()
+{
+  PageFile hot, scan;
+  char page[PageFile::MAX_PAGE_SIZE];
+
+  if (enterScratchDir() != 0) return 1;
+  CHECK(PageFile::setCacheSize(CACHE_PAGES) == 0);
+
+  CHECK(hot.open("hot.pf", 'w') == 0);
+  CHECK(scan.open("scan.pf", 'w') == 0);
+  for (PageId pid = 0; pid < SCAN_PAGES; pid++) {
+    fill(page, hot.getPageSize(), pid);
+    if (pid < HOT_PAGES) CHECK(hot.write(pid, page) == 0);
+    CHECK(scan.write(pid, page) == 0);
+  }
+  hot.setReadAhead(0);
+  scan.setReadAhead(0);
+  // start from an empty cache
+  CHECK(PageFile::setCacheSize(CACHE_PAGES) == 0);
+
+  // the hot pages are read, pushed out by a cache's worth of other pages,
+  // and read again while the cache still remembers them
+  if (readPages(hot, 0, HOT_PAGES) != 0) return 1;
+  if (readPages(scan, 0, CACHE_PAGES) != 0) return 1;
+  if (readPages(hot, 0, HOT_PAGES) != 0) return 1;
+  if (checkHot(hot) != 0) return 1;
+
+  // a scan of pages read once leaves them in the cache
+  if (readPages(scan, CACHE_PAGES, SCAN_PAGES - CACHE_PAGES) != 0) return 1;
+  if (checkHot(hot) != 0) return 1;
+
+  // so does a sequential scan, which keeps to a ring of a few frames
+  CHECK(scan.advise(PageFile::ACCESS_SEQUENTIAL) == 0);
+  int misses = scan.getCacheMissCount();
+  if (readPages(scan, 0, SCAN_PAGES) != 0) return 1;
+  CHECK(scan.getCacheMissCount() - misses > SCAN_PAGES - CACHE_PAGES);
+  if (checkHot(hot) != 0) return 1;
+
+  CHECK(hot.close() == 0);
+  CHECK(scan.close() == 0);
+
+  printf("ReplacementTest: ok\n");
+  return 0;
+}
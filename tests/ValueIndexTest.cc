@@ -0,0 +1,141 @@
+/*
+ * Copyright (C) 2008 by The Regents of the University of California
+ * Redistribution of this file is permitted under the terms of the GNU
+ * Public License (GPL).
+ */
+
+/*
+ * The value index: a select with conditions on the value column returns
+ * the same records through the value index as a full scan of a copy of the
+ * table without indexes, including values longer than the index key.
+ */
+
+#include "SqlEngine.h"
+#include "Check.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+
+using std::string;
+using std::vector;
+
+static const int RECORDS = 3000;
+
+// the value of the i-th record. many values share a prefix longer than
+// the key of the value index
+static string valueOf(int i)
+{
+  char value[64];
+
+  switch (i % 4) {
+  case 0:  snprintf(value, sizeof(value), "v%03d", i % 500); break;
+  case 1:  snprintf(value, sizeof(value), "a-long-common-prefix-%d", i % 700); break;
+  case 2:  snprintf(value, sizeof(value), "m%d", i); break;
+  default: value[0] = 0; break;
+  }
+  return value;
+}
+
+// run a select, and return what it prints, one line per record, sorted
+static int runSelect(int attr, const string& table, const vector<SelCond>& cond, vector<string>& lines)
+{
+  char name[] = "select.out";
+  int saved = dup(1);
+
+  fflush(stdout);
+  int fd = open(name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  CHECK(saved >= 0 && fd >= 0 && dup2(fd, 1) >= 0);
+  close(fd);
+  SqlEngine::select(attr, table, cond);
+  fflush(stdout);
+  CHECK(dup2(saved, 1) >= 0);
+  close(saved);
+
+  std::ifstream in(name);
+  string line;
+  lines.clear();
+  while (getline(in, line)) lines.push_back(line);
+  std::sort(lines.begin(), lines.end());
+  return 0;
+}
+
+struct Query {
+  int attr;
+  const char* conds;  // "<attr> <comparator> <value>", separated by ';'
+};
+
+static SelCond::Comparator comparatorOf(const string& s)
+{
+  if (s == "=") return SelCond::EQ;
+  if (s == "<>") return SelCond::NE;
+  if (s == "<") return SelCond::LT;
+  if (s == ">") return SelCond::GT;
+  if (s == "<=") return SelCond::LE;
+  return SelCond::GE;
+}
+
+int main()
+{
+  static const Query queries[] = {
+    { 3, "2 = v042" },
+    { 3, "2 = a-long-common-prefix-17" },
+    { 4, "2 > a-long-common-prefix-5" },
+    { 3, "2 >= m100;2 < m2" },
+    { 3, "2 > v1;2 <= v2;2 <> v150" },
+    { 2, "2 < a-long-common-prefix-1" },
+    { 3, "2 = v007;1 > 1000" },
+    { 1, "2 >= v3;1 < 2000;1 >= 100" },
+    { 3, "1 = 1234;2 > a" },
+    { 4, "2 = " },
+    { 4, "2 > zzz" },
+  };
+  int nonEmpty = 0;
+
+  if (enterScratchDir() != 0) return 1;
+
+  std::ofstream out("table.del");
+  for (int i = 0; i < RECORDS; i++) out << i << ",'" << valueOf(i) << "'\n";
+  out.close();
+
+  CHECK(SqlEngine::load("indexed", "table.del", true, true) == 0);
+  CHECK(access("indexed.vdx", F_OK) == 0);
+  CHECK(SqlEngine::load("plain", "table.del", false) == 0);
+  CHECK(access("plain.idx", F_OK) != 0 && access("plain.vdx", F_OK) != 0);
+
+  for (unsigned q = 0; q < sizeof(queries) / sizeof(queries[0]); q++) {
+    vector<SelCond> cond;
+    vector<string> values;
+    std::stringstream conds(queries[q].conds);
+    string part;
+
+    while (getline(conds, part, ';')) {
+      std::stringstream fields(part);
+      string attr, comp, value;
+      fields >> attr >> comp;
+      getline(fields >> std::ws, value);
+      values.push_back(value);
+      SelCond c;
+      c.attr = atoi(attr.c_str());
+      c.comp = comparatorOf(comp);
+      cond.push_back(c);
+    }
+    for (unsigned i = 0; i < cond.size(); i++) cond[i].value = (char*) values[i].c_str();
+
+    vector<string> byIndex, byScan;
+    if (runSelect(queries[q].attr, "indexed", cond, byIndex) != 0) return 1;
+    if (runSelect(queries[q].attr, "plain", cond, byScan) != 0) return 1;
+    if (byIndex != byScan) {
+      fprintf(stderr, "query %u: %zu lines through the index, %zu by a scan\n", q, byIndex.size(), byScan.size());
+      return 1;
+    }
+    if (!byScan.empty() && byScan[0] != "0") nonEmpty++;
+  }
+  CHECK(nonEmpty >= 8);
+
+  printf("ValueIndexTest: ok\n");
+  return 0;
+}
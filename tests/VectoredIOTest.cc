@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2008 by The Regents of the University of California
+ * Redistribution of this file is permitted under the terms of the GNU
+ * Public License (GPL).
+ */
+
+/*
+ * Vectored page i/o: writev() writes runs of pages and scattered pages as
+ * write() would, with the last buffer of a page listed twice winning, in
+ * write-through, write-back and mapped files alike; readv() reads them
+ * back, cached or not, in any order.
+ */
+
+#include "PageFile.h"
+#include "Check.h"
+#include <cstring>
+#include <vector>
+
+static const int PAGES = 48;
+
+// fill a page with a pattern of the page and the round that wrote it
+static void fill(char* page, int size, PageId pid, int round)
+{
+  for (int i = 0; i < size; i++) page[i] = (char) (pid * 7 + round * 13 + i);
+}
+
+// write every page, in runs and out of order, then rewrite a page in the
+// same call
+static int writePages(PageFile& pf, int round)
+{
+  int size = pf.getPageSize();
+  std::vector<char> buffers((size_t) (PAGES + 1) * size);
+  std::vector<PageIO> pages(PAGES + 1);
+
+  for (int i = 0; i < PAGES; i++) {
+    // two runs, the second one written first
+    PageId pid = (i < PAGES / 2) ? i + PAGES / 2 : i - PAGES / 2;
+    pages[i].pid = pid;
+    pages[i].buffer = &buffers[(size_t) i * size];
+    fill((char*) pages[i].buffer, size, pid, round);
+  }
+  pages[PAGES].pid = 3;
+  pages[PAGES].buffer = &buffers[(size_t) PAGES * size];
+  fill((char*) pages[PAGES].buffer, size, 3, round + 1);
+  CHECK(pf.writev(&pages[0], PAGES + 1) == 0);
+  CHECK(pf.endPid() == PAGES);
+  return 0;
+}
+
+// read every page back, a page listed twice, cached pages among them
+static int readPages(PageFile& pf, int round)
+{
+  int size = pf.getPageSize();
+  std::vector<char> buffers((size_t) (PAGES + 1) * size);
+  std::vector<PageIO> pages(PAGES + 1);
+  char expected[PageFile::MAX_PAGE_SIZE];
+  char page[PageFile::MAX_PAGE_SIZE];
+
+  for (PageId pid = 0; pid < PAGES; pid += 5) CHECK(pf.read(pid, page) == 0);
+  for (int i = 0; i <= PAGES; i++) {
+    pages[i].pid = (i == PAGES) ? 3 : PAGES - 1 - i;
+    pages[i].buffer = &buffers[(size_t) i * size];
+  }
+  CHECK(pf.readv(&pages[0], PAGES + 1) == 0);
+  for (int i = 0; i <= PAGES; i++) {
+    PageId pid = pages[i].pid;
+    fill(expected, size, pid, (pid == 3) ? round + 1 : round);
+    CHECK(memcmp(pages[i].buffer, expected, size) == 0);
+  }
+  return 0;
+}
+
+static int checkMode(char mode, bool writeBack)
+{
+  PageFile pf;
+
+  // a write-back file is given room for every page it writes
+  CHECK(PageFile::setCacheSize(writeBack ? 2 * PAGES : PAGES / 2) == 0);
+  unlink("vec.pf");
+  CHECK(pf.open("vec.pf", mode) == 0);
+  if (writeBack) CHECK(pf.setWriteBack(true) == 0);
+  long long writes = PageFile::getPageWriteCount();
+  if (writePages(pf, 1) != 0) return 1;
+  // a write-back file keeps the pages in the cache until the flush
+  if (writeBack) CHECK(PageFile::getPageWriteCount() == writes);
+  if (readPages(pf, 1) != 0) return 1;
+  CHECK(pf.flush() == 0);
+  // each page is written once, the one listed twice too; a mapped file
+  // does not count its writes
+  if (mode != 'm') CHECK(PageFile::getPageWriteCount() == writes + PAGES);
+  if (writePages(pf, 2) != 0) return 1;
+  CHECK(pf.close() == 0);
+
+  CHECK(pf.open("vec.pf", 'r') == 0);
+  if (readPages(pf, 2) != 0) return 1;
+  CHECK(pf.close() == 0);
+  return 0;
+}
+
+int main()
+{
+  if (enterScratchDir() != 0) return 1;
+
+  if (checkMode('w', false) != 0) return 1;
+  if (checkMode('w', true) != 0) return 1;
+  if (checkMode('m', false) != 0) return 1;
+
+  printf("VectoredIOTest: ok\n");
+  return 0;
+}
@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2008 by The Regents of the University of California
+ * Redistribution of this file is permitted under the terms of the GNU
+ * Public License (GPL).
+ */
+
+/*
+ * Write-back mode: writes stay in the cache until a flush, a reader of
+ * the file sees them only then, dirty pages evicted from a small cache
+ * reach the disk, and a file is written through unless it asks for
+ * write-back.
+ */
+
+#include "PageFile.h"
+#include "Check.h"
+#include <cstring>
+
+static const int PAGES = 100;
+
+// fill a page with a pattern of the page and the round that wrote it
+static void fill(char* page, int size, PageId pid, int round)
+{
+  for (int i = 0; i < size; i++) page[i] = (char) (pid * 7 + round * 13 + i);
+}
+
+static int checkPages(PageFile& pf, int round)
+{
+  char page[PageFile::MAX_PAGE_SIZE];
+  char expected[PageFile::MAX_PAGE_SIZE];
+
+  for (PageId pid = 0; pid < PAGES; pid++) {
+    fill(expected, pf.getPageSize(), pid, round);
+    CHECK(pf.read(pid, page) == 0);
+    CHECK(memcmp(page, expected, pf.getPageSize()) == 0);
+  }
+  return 0;
+}
+
+static int writePages(PageFile& pf, int round)
+{
+  char page[PageFile::MAX_PAGE_SIZE];
+
+  for (PageId pid = 0; pid < PAGES; pid++) {
+    fill(page, pf.getPageSize(), pid, round);
+    CHECK(pf.write(pid, page) == 0);
+  }
+  return 0;
+}
+
+int main()
+{
+  PageFile pf, reader;
+
+  if (enterScratchDir() != 0) return 1;
+  CHECK(PageFile::setCacheSize(4 * PAGES) == 0);
+
+  // a file is written through by default
+  CHECK(pf.open("wb.pf", 'w') == 0);
+  long long writes = PageFile::getPageWriteCount();
+  if (writePages(pf, 1) != 0) return 1;
+  CHECK(PageFile::getPageWriteCount() == writes + PAGES);
+
+  // in write-back mode the pages stay in the cache, and are read from it
+  CHECK(pf.setWriteBack(true) == 0);
+  writes = PageFile::getPageWriteCount();
+  if (writePages(pf, 2) != 0) return 1;
+  CHECK(PageFile::getPageWriteCount() == writes);
+  if (checkPages(pf, 2) != 0) return 1;
+
+  // another open file of the same name reads the disk: the old pages
+  // until the flush
+  CHECK(reader.open("wb.pf", 'r') == 0);
+  if (checkPages(reader, 1) != 0) return 1;
+  CHECK(reader.close() == 0);
+  CHECK(pf.flush() == 0);
+  CHECK(PageFile::getPageWriteCount() == writes + PAGES);
+  CHECK(reader.open("wb.pf", 'r') == 0);
+  if (checkPages(reader, 2) != 0) return 1;
+  CHECK(reader.close() == 0);
+
+  // turning write-back off flushes the file
+  if (writePages(pf, 3) != 0) return 1;
+  CHECK(pf.setWriteBack(false) == 0);
+  CHECK(reader.open("wb.pf", 'r') == 0);
+  if (checkPages(reader, 3) != 0) return 1;
+  CHECK(reader.close() == 0);
+  CHECK(pf.close() == 0);
+
+  // a cache smaller than the dirty pages writes them back as it evicts
+  CHECK(PageFile::setCacheSize(PAGES / 10) == 0);
+  CHECK(pf.open("wb.pf", 'w') == 0);
+  CHECK(pf.setWriteBack(true) == 0);
+  if (writePages(pf, 4) != 0) return 1;
+  if (checkPages(pf, 4) != 0) return 1;
+  CHECK(pf.close() == 0);
+  CHECK(pf.open("wb.pf", 'r') == 0);
+  if (checkPages(pf, 4) != 0) return 1;
+  CHECK(pf.close() == 0);
+
+  printf("WriteBackTest: ok\n");
+  return 0;
+}
@@ -0,0 +1,128 @@
+/*
+ * Copyright (C) 2008 by The Regents of the University of California
+ * Redistribution of this file is permitted under the terms of the GNU
+ * Public License (GPL).
+ */
+
+/*
+ * Zone maps: skipPages() skips the pages whose keys all lie outside the
+ * range a scan looks for, and never a page with a key in it; the map is
+ * kept in <table>.zmap across a close; a map that is missing or older
+ * than the file skips nothing for a reader, and is built again by a
+ * writer.
+ */
+
+#include "RecordFile.h"
+#include "Check.h"
+#include <cstdlib>
+#include <set>
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+static const int RECORDS = 5000;
+
+static string valueOf(int i)
+{
+  int length = (i % 211 == 0) ? 2000 : 10 + i % 30;
+  return string(length, 'a' + i % 26);
+}
+
+// scan the file for the keys in [low, high], skipping pages as the zone
+// map allows, and compare with the keys the file holds
+static int scan(const RecordFile& rf, const vector<int>& keys, int low, int high, int& pages)
+{
+  std::multiset<int> found, expected;
+  RecordId rid = { 0, 0 };
+  PageId last = -1;
+  int key;
+
+  pages = 0;
+  while (true) {
+    rf.skipPages(rid, low, high);
+    if (!(rid < rf.endRid())) break;
+    CHECK(rf.readKey(rid, key) == 0);
+    if (rid.pid != last) pages++;
+    last = rid.pid;
+    if (key >= low && key <= high) found.insert(key);
+    rf.next(rid);
+  }
+  for (unsigned i = 0; i < keys.size(); i++) {
+    if (keys[i] >= low && keys[i] <= high) expected.insert(keys[i]);
+  }
+  CHECK(found == expected);
+  return 0;
+}
+
+static int append(const char* filename, vector<int>& keys, int count, bool sorted)
+{
+  RecordFile rf;
+  RecordId rid;
+
+  CHECK(rf.open(filename, 'w') == 0);
+  for (int i = 0; i < count; i++) {
+    int key = sorted ? (int) keys.size() : rand() % RECORDS;
+    CHECK(rf.append(key, valueOf(i), rid) == 0);
+    keys.push_back(key);
+  }
+  CHECK(rf.close() == 0);
+  return 0;
+}
+
+int main()
+{
+  RecordFile rf;
+  vector<int> keys, shuffled;
+  int pages, all;
+
+  if (enterScratchDir() != 0) return 1;
+  srand(7);
+
+  // keys in order: a narrow range touches a page or two
+  if (append("zone.tbl", keys, RECORDS, true) != 0) return 1;
+  CHECK(access("zone.tbl.zmap", F_OK) == 0);
+  CHECK(rf.open("zone.tbl", 'r') == 0);
+  if (scan(rf, keys, 0, RECORDS, all) != 0) return 1;
+  CHECK(all > 20);
+  if (scan(rf, keys, 2500, 2510, pages) != 0) return 1;
+  CHECK(pages <= 2);
+  if (scan(rf, keys, RECORDS + 1, RECORDS + 100, pages) != 0) return 1;
+  CHECK(pages == 0);
+  if (scan(rf, keys, -100, 0, pages) != 0) return 1;
+  CHECK(pages == 1);
+  CHECK(rf.close() == 0);
+
+  // a map older than the file is not used by a reader
+  CHECK(rename("zone.tbl.zmap", "old.zmap") == 0);
+  if (append("zone.tbl", keys, 100, true) != 0) return 1;
+  CHECK(rename("old.zmap", "zone.tbl.zmap") == 0);
+  CHECK(rf.open("zone.tbl", 'r') == 0);
+  if (scan(rf, keys, 2500, 2510, pages) != 0) return 1;
+  CHECK(pages > all);
+  CHECK(rf.close() == 0);
+
+  // nor is a missing one; a writer builds it again
+  CHECK(unlink("zone.tbl.zmap") == 0);
+  CHECK(rf.open("zone.tbl", 'r') == 0);
+  if (scan(rf, keys, 2500, 2510, pages) != 0) return 1;
+  CHECK(pages > all);
+  CHECK(rf.close() == 0);
+  if (append("zone.tbl", keys, 1, true) != 0) return 1;
+  CHECK(rf.open("zone.tbl", 'r') == 0);
+  if (scan(rf, keys, 2500, 2510, pages) != 0) return 1;
+  CHECK(pages <= 2);
+  CHECK(rf.close() == 0);
+
+  // keys in no order: every range still finds every key in it
+  if (append("random.tbl", shuffled, RECORDS, false) != 0) return 1;
+  CHECK(rf.open("random.tbl", 'r') == 0);
+  for (int low = -10; low < RECORDS; low += 377) {
+    if (scan(rf, shuffled, low, low + 50, pages) != 0) return 1;
+  }
+  CHECK(rf.close() == 0);
+
+  printf("ZoneMapTest: ok\n");
+  return 0;
+}